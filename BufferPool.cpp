@@ -0,0 +1,110 @@
+#include "stdafx.h"
+
+#include "BufferPool.h"
+
+#include <stdlib.h>
+
+
+size_t BufferPool::pooledBytes = 0;
+size_t BufferPool::maxPooledBytes = 64 << 20;
+
+std::map<size_t, std::vector<void *> > BufferPool::freeLists;
+
+SRWLOCK BufferPool::lock = SRWLOCK_INIT;
+
+
+// 256, 320, 384, 448, 512, 640, 768, 896, 1024, 1280 ...
+// so no more than a quarter of a block is ever wasted
+
+size_t BufferPool::classSize(size_t size) {
+	if(size <= 256) return 256;
+
+	size_t base = 256;
+	while(base * 2 < size) {
+		base *= 2;
+	}
+
+	size_t step = base / 4;
+	return base + ((size - base + step - 1) / step) * step;
+}
+
+
+void *BufferPool::alloc(size_t size, size_t &capacity) {
+	capacity = classSize(size);
+
+	AcquireSRWLockExclusive(&lock);
+	std::map<size_t, std::vector<void *> >::iterator i = freeLists.find(capacity);
+	if(i != freeLists.end() && !i->second.empty()) {
+		void *ptr = i->second.back();
+		i->second.pop_back();
+		pooledBytes -= capacity;
+		ReleaseSRWLockExclusive(&lock);
+		return ptr;
+	}
+	ReleaseSRWLockExclusive(&lock);
+
+	void *ptr = systemAlloc(capacity);
+	if(!ptr) {
+		capacity = 0;
+	}
+	return ptr;
+}
+
+void BufferPool::release(void *ptr, size_t capacity) {
+	if(!ptr) return;
+
+	AcquireSRWLockExclusive(&lock);
+	bool keep = pooledBytes + capacity <= maxPooledBytes;
+	if(keep) {
+		pooledBytes += capacity;
+	}
+	ReleaseSRWLockExclusive(&lock);
+
+	if(!keep) {
+		systemFree(ptr, capacity);
+		return;
+	}
+
+	if(capacity >= largeClass) {
+		// keep the address range, but let the OS drop the pages
+		VirtualAlloc(ptr, capacity, MEM_RESET, PAGE_READWRITE);
+	}
+
+	AcquireSRWLockExclusive(&lock);
+	freeLists[capacity].push_back(ptr);
+	ReleaseSRWLockExclusive(&lock);
+}
+
+void BufferPool::trim() {
+	AcquireSRWLockExclusive(&lock);
+
+	std::map<size_t, std::vector<void *> >::iterator i;
+
+	for(i = freeLists.begin(); i != freeLists.end(); i++) {
+		for(int j = 0; j < i->second.size(); j++) {
+			systemFree(i->second[j], i->first);
+		}
+	}
+
+	freeLists.clear();
+	pooledBytes = 0;
+
+	ReleaseSRWLockExclusive(&lock);
+}
+
+
+void *BufferPool::systemAlloc(size_t capacity) {
+	if(capacity >= largeClass) {
+		return VirtualAlloc(NULL, capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+	return malloc(capacity);
+}
+
+void BufferPool::systemFree(void *ptr, size_t capacity) {
+	if(capacity >= largeClass) {
+		VirtualFree(ptr, 0, MEM_RELEASE);
+	}
+	else {
+		free(ptr);
+	}
+}
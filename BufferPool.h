@@ -0,0 +1,52 @@
+#ifndef __BUFFERPOOL_H_
+#define __BUFFERPOOL_H_
+
+#include <windows.h>
+
+#include <map>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////
+// BufferPool -- recycles the memory behind buffer shadows.
+//
+// Requests are rounded up to a size class (four classes per power of
+// two) and freed blocks go back on that class's free list, so a buffer
+// that is re-specified every frame keeps getting the same memory back
+// instead of going through malloc and free.  Large classes come
+// straight from VirtualAlloc, and are MEM_RESET while they sit in the
+// pool so the OS can reclaim the pages without us giving up the range.
+// Contexts on different threads share the pool, so the lists are
+// locked; the system calls are made outside the lock.
+//////////////////////////////////////////////////////////////////////
+
+class BufferPool {
+
+  public:
+
+	static void *alloc(size_t size, size_t &capacity);
+	static void release(void *ptr, size_t capacity);
+
+	static size_t classSize(size_t size);
+
+	// give all pooled memory back to the system
+	static void trim();
+
+	// bytes sitting unused in the free lists
+	static size_t pooledBytes;
+
+	// most bytes the free lists may hold before blocks are really freed
+	static size_t maxPooledBytes;
+
+	// classes at least this big are page allocations
+	static const size_t largeClass = 256 * 1024;
+
+  private:
+
+	static void *systemAlloc(size_t capacity);
+	static void systemFree(void *ptr, size_t capacity);
+
+	static std::map<size_t, std::vector<void *> > freeLists;
+	static SRWLOCK lock;
+};
+
+#endif // __BUFFERPOOL_H_
@@ -0,0 +1,234 @@
+#include "stdafx.h"
+
+#include "ogle.h"
+
+#include "Ptr/Ptr.in"
+
+#include <algorithm>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// OGLE::BufferStore functions
+//////////////////////////////////////////////////////////////////////////////////
+
+OGLE::BufferStore::BufferStore() :
+	budget(OGLE::config.bufferBudget),
+	bytes(0),
+	nEvicted(0),
+	epoch(0),
+	generations(0)
+{}
+
+OGLE::BufferStore::~BufferStore() {
+	lru.clear();
+	buffers.clear();
+}
+
+
+OGLE::BufferPtr OGLE::BufferStore::find(GLuint name) {
+	if(!name) return 0;
+
+	std::unordered_map<GLuint, BufferPtr>::iterator i = buffers.find(name);
+	return i == buffers.end() ? BufferPtr(0) : i->second;
+}
+
+OGLE::BufferPtr OGLE::BufferStore::create(GLuint name, const GLvoid *data, GLsizei size, GLenum usage, bool shadow) {
+	BufferPtr buff = find(name);
+
+	if(buff && !buff->map) {
+		// re-specifying (or orphaning) a buffer we already know
+		if(buff->ptr) bytes -= buff->capacity;
+		buff->generation = ++generations;
+		buff->respecify(data, size, usage, shadow);
+	}
+	else {
+		remove(name);
+
+		buff = new Buffer(0, size, name, usage, false);
+		buffers[name] = buff;
+		epoch++;
+
+		// generations are unique across the store, so (name, generation)
+		// identifies these exact contents even after the name is reused
+		buff->generation = ++generations;
+		buff->respecify(data, size, usage, shadow);
+	}
+
+	if(buff->ptr) {
+		bytes += buff->capacity;
+		touch(buff.rawPtr());
+	}
+	else {
+		unlink(buff.rawPtr());
+	}
+
+	return buff;
+}
+
+// glDeleteBuffers -- the name may be reused for a completely different
+// buffer later, so forget everything about it.
+
+void OGLE::BufferStore::remove(GLuint name) {
+	std::unordered_map<GLuint, BufferPtr>::iterator i = buffers.find(name);
+	if(i == buffers.end()) return;
+
+	Buffer *buff = i->second.rawPtr();
+	unlink(buff);
+	if(buff->ptr) {
+		bytes -= buff->capacity;
+	}
+
+	buffers.erase(i);
+	epoch++;
+}
+
+
+bool OGLE::BufferStore::restore(Buffer *buff) {
+	if(!buff->ptr) {
+		if(!buff->allocate()) {
+			return false;
+		}
+		bytes += buff->capacity;
+	}
+
+	touch(buff);
+	return true;
+}
+
+void OGLE::BufferStore::touch(Buffer *buff) {
+	unlink(buff);
+	lru.push_front(buff);
+	buff->lruPos = lru.begin();
+	buff->inLru = 1;
+}
+
+
+// Drop clean shadows, least recently used first, until the total is
+// under budget.  keep1/keep2 are the buffers the current draw reads
+// from, which must survive even if they are the oldest.
+
+void OGLE::BufferStore::enforceBudget(bool canReadBack, GLuint keep1, GLuint keep2) {
+	if(!budget || bytes <= budget) return;
+
+	std::list<Buffer *>::iterator i = lru.end();
+	while(bytes > budget && i != lru.begin()) {
+		--i;
+		Buffer *buff = *i;
+
+		if(!buff->ptr || !buff->isClean(canReadBack)
+			|| buff->name == keep1 || buff->name == keep2) {
+			continue;
+		}
+
+		// step off the entry before release() unlinks it
+		std::list<Buffer *>::iterator next = i;
+		++next;
+		release(buff);
+		i = next;
+
+		nEvicted++;
+	}
+}
+
+
+void OGLE::BufferStore::unlink(Buffer *buff) {
+	if(buff->inLru) {
+		lru.erase(buff->lruPos);
+		buff->inLru = 0;
+	}
+}
+
+void OGLE::BufferStore::release(Buffer *buff) {
+	unlink(buff);
+
+	bytes -= buff->capacity;
+	buff->deallocate();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// OGLE::Buffer mapped range tracking
+//////////////////////////////////////////////////////////////////////////////////
+
+static bool rangeBefore(const OGLE::Range &a, const OGLE::Range &b) {
+	return a.offset < b.offset;
+}
+
+// Remember that [offset, offset+length) of the buffer was written
+// through the mapping.  Ring buffers write and flush consecutive
+// slices, so extending the last range covers the common case; if the
+// list still grows large, overlapping and touching ranges are merged.
+// The gaps between them are kept: with GL_MAP_FLUSH_EXPLICIT_BIT they
+// are bytes that were never flushed.
+
+void OGLE::Buffer::addDirty(GLintptr offset, GLsizeiptr length) {
+	if(length <= 0) return;
+
+	if(!dirty.empty()) {
+		Range &last = dirty.back();
+		if(offset <= last.offset + last.length && offset + length >= last.offset) {
+			GLintptr end = std::max(last.offset + last.length, offset + length);
+			last.offset = std::min(last.offset, offset);
+			last.length = end - last.offset;
+			return;
+		}
+	}
+
+	Range r = { offset, length };
+	dirty.push_back(r);
+
+	// at each power of two from 64, so the merging stays cheap however
+	// many disjoint ranges there are
+	size_t n = dirty.size();
+	if(n >= 64 && !(n & (n - 1))) {
+		std::sort(dirty.begin(), dirty.end(), rangeBefore);
+
+		size_t last = 0;
+		for(size_t i = 1; i < n; i++) {
+			Range &m = dirty[last];
+			if(dirty[i].offset <= m.offset + m.length) {
+				m.length = std::max(m.offset + m.length, dirty[i].offset + dirty[i].length) - m.offset;
+			}
+			else {
+				dirty[++last] = dirty[i];
+			}
+		}
+		dirty.resize(last + 1);
+	}
+}
+
+// Whether the written ranges take in every byte of [offset,
+// offset+length).
+
+bool OGLE::Buffer::dirtyCovers(GLintptr offset, GLsizeiptr length) const {
+	std::vector<Range> sorted(dirty);
+	std::sort(sorted.begin(), sorted.end(), rangeBefore);
+
+	GLintptr end = offset + length;
+	for(size_t i = 0; i < sorted.size() && offset < end; i++) {
+		if(sorted[i].offset > offset) break;
+		offset = std::max(offset, sorted[i].offset + sorted[i].length);
+	}
+	return offset >= end;
+}
+
+// Copy the written ranges from the mapping into the shadow.  Only
+// worth doing if the shadow was current to begin with; otherwise it
+// has to be read back whole anyway.
+
+void OGLE::Buffer::copyDirty() {
+	if(map && ptr && mapCurrent) {
+		for(int i = 0; i < dirty.size(); i++) {
+			GLintptr lo = std::max(dirty[i].offset, mapOffset);
+			GLintptr hi = std::min(dirty[i].offset + dirty[i].length, mapOffset + mapLength);
+			hi = std::min(hi, (GLintptr)size);
+
+			if(hi > lo) {
+				memcpy((GLbyte *)ptr + lo, (GLbyte *)map + (lo - mapOffset), hi - lo);
+			}
+		}
+		fetchedGeneration = generation;
+	}
+
+	dirty.clear();
+}
@@ -0,0 +1,437 @@
+#include "stdafx.h"
+
+#include "ogle.h"
+
+#include "CallLog.h"
+
+#include "Ptr/Ptr.in"
+
+#include <algorithm>
+
+
+// Each thread's ring; a thread that falls this far behind the drainer
+// starts dropping records.
+static const unsigned int ringSize = 1 << 20;
+
+// How often the drainer wakes, in ms
+static const DWORD drainInterval = 10;
+
+// The most a record's payload can be; the longest signature is
+// well under it.
+static const unsigned int maxPayload = 256;
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// The registered functions' arguments, in the codes of CallLogFormat.h
+//////////////////////////////////////////////////////////////////////////////////
+
+static const CallLog::Signature signatureTable[] = {
+	{ "glBegin", "e", 'v' },
+	{ "glEnd", "", 'v' },
+	{ "glArrayElement", "i", 'v' },
+	{ "glVertex3fv", "p", 'v' },
+	{ "glVertex3f", "fff", 'v' },
+	{ "glVertex3dv", "p", 'v' },
+	{ "glVertex3d", "ddd", 'v' },
+	{ "glNormal3fv", "p", 'v' },
+	{ "glNormal3f", "fff", 'v' },
+	{ "glColor3fv", "p", 'v' },
+	{ "glColor3f", "fff", 'v' },
+	{ "glColor4fv", "p", 'v' },
+	{ "glColor4f", "ffff", 'v' },
+	{ "glColor3ubv", "p", 'v' },
+	{ "glColor3ub", "BBB", 'v' },
+	{ "glColor4ubv", "p", 'v' },
+	{ "glColor4ub", "BBBB", 'v' },
+	{ "glTexCoord2fv", "p", 'v' },
+	{ "glTexCoord3fv", "p", 'v' },
+	{ "glTexCoord2f", "ff", 'v' },
+	{ "glTexCoord3f", "fff", 'v' },
+	{ "glClientActiveTexture", "e", 'v' },
+	{ "glClientActiveTextureARB", "e", 'v' },
+
+	{ "glEnableClientState", "e", 'v' },
+	{ "glDisableClientState", "e", 'v' },
+	{ "glVertexPointer", "ieip", 'v' },
+	{ "glNormalPointer", "eip", 'v' },
+	{ "glColorPointer", "ieip", 'v' },
+	{ "glTexCoordPointer", "ieip", 'v' },
+	{ "glDrawArrays", "eii", 'v' },
+	{ "glDrawElements", "eiep", 'v' },
+	{ "glInterleavedArrays", "eip", 'v' },
+
+	{ "glDrawRangeElements", "euuiep", 'v' },
+	{ "glDrawRangeElementsEXT", "euuiep", 'v' },
+	{ "glDrawElementsBaseVertex", "eiepi", 'v' },
+	{ "glDrawRangeElementsBaseVertex", "euuiepi", 'v' },
+	{ "glMultiDrawArrays", "eppi", 'v' },
+	{ "glMultiDrawArraysEXT", "eppi", 'v' },
+	{ "glMultiDrawElements", "epepi", 'v' },
+	{ "glMultiDrawElementsEXT", "epepi", 'v' },
+	{ "glMultiDrawElementsBaseVertex", "epepip", 'v' },
+	{ "glDrawArraysIndirect", "ep", 'v' },
+	{ "glDrawElementsIndirect", "eep", 'v' },
+	{ "glMultiDrawArraysIndirect", "epii", 'v' },
+	{ "glMultiDrawElementsIndirect", "eepii", 'v' },
+	{ "glDrawArraysInstanced", "eiii", 'v' },
+	{ "glDrawArraysInstancedARB", "eiii", 'v' },
+	{ "glDrawArraysInstancedEXT", "eiii", 'v' },
+	{ "glDrawElementsInstanced", "eiepi", 'v' },
+	{ "glDrawElementsInstancedARB", "eiepi", 'v' },
+	{ "glDrawElementsInstancedEXT", "eiepi", 'v' },
+
+	{ "glVertexAttribPointer", "uiebip", 'v' },
+	{ "glVertexAttribPointerARB", "uiebip", 'v' },
+	{ "glVertexAttribIPointer", "uieip", 'v' },
+	{ "glVertexAttribIPointerEXT", "uieip", 'v' },
+	{ "glEnableVertexAttribArray", "u", 'v' },
+	{ "glEnableVertexAttribArrayARB", "u", 'v' },
+	{ "glDisableVertexAttribArray", "u", 'v' },
+	{ "glDisableVertexAttribArrayARB", "u", 'v' },
+	{ "glVertexAttribDivisor", "uu", 'v' },
+	{ "glVertexAttribDivisorARB", "uu", 'v' },
+	{ "glBindVertexArray", "u", 'v' },
+	{ "glDeleteVertexArrays", "ip", 'v' },
+
+	{ "glLockArraysEXT", "ii", 'v' },
+	{ "glUnlockArraysEXT", "", 'v' },
+
+	{ "glBindBuffer", "eu", 'v' },
+	{ "glBindBufferARB", "eu", 'v' },
+	{ "glBufferData", "ezpe", 'v' },
+	{ "glBufferDataARB", "ezpe", 'v' },
+	{ "glDeleteBuffers", "ip", 'v' },
+	{ "glDeleteBuffersARB", "ip", 'v' },
+	{ "glBufferSubData", "ezzp", 'v' },
+	{ "glBufferSubDataARB", "ezzp", 'v' },
+	{ "glMapBuffer", "ee", 'p' },
+	{ "glMapBufferARB", "ee", 'p' },
+	{ "glUnmapBuffer", "e", 'b' },
+	{ "glUnmapBufferARB", "e", 'b' },
+	{ "glMapBufferRange", "ezzu", 'p' },
+	{ "glFlushMappedBufferRange", "ezz", 'v' },
+	{ "glBufferStorage", "ezpu", 'v' },
+	{ "glBindBufferBase", "euu", 'v' },
+	{ "glBindBufferRange", "euuzz", 'v' },
+
+	{ "glUseProgram", "u", 'v' },
+	{ "glUseProgramObjectARB", "u", 'v' },
+	{ "glLinkProgram", "u", 'v' },
+	{ "glLinkProgramARB", "u", 'v' },
+	{ "glDeleteProgram", "u", 'v' },
+	{ "glGetUniformLocation", "up", 'i' },
+	{ "glGetUniformLocationARB", "up", 'i' },
+	{ "glUniformMatrix4fv", "iibp", 'v' },
+	{ "glUniformMatrix4fvARB", "iibp", 'v' },
+	{ "glProgramUniformMatrix4fv", "uiibp", 'v' },
+	{ "glProgramUniformMatrix4fvEXT", "uiibp", 'v' },
+
+	{ "glNewList", "ue", 'v' },
+	{ "glEndList", "", 'v' },
+	{ "glCallList", "u", 'v' },
+	{ "glCallLists", "iep", 'v' },
+	{ "glListBase", "u", 'v' },
+	{ "glDeleteLists", "ui", 'v' },
+};
+
+// what a function that is not in the table is logged as
+static const CallLog::Signature unknownSignature = { 0, "", 'v' };
+
+
+// Copy one value of the given code out of args into out, and return
+// how many bytes it took.
+
+template <class Args>
+static unsigned int getValue(Args &args, char code, char *out) {
+	switch(code) {
+		case 'e': { GLenum v; args.Get(v); memcpy(out, &v, sizeof(v)); return sizeof(v); }
+		case 'u': { GLuint v; args.Get(v); memcpy(out, &v, sizeof(v)); return sizeof(v); }
+		case 'i': { GLint v; args.Get(v); memcpy(out, &v, sizeof(v)); return sizeof(v); }
+		case 'f': { GLfloat v; args.Get(v); memcpy(out, &v, sizeof(v)); return sizeof(v); }
+		case 'd': { GLdouble v; args.Get(v); memcpy(out, &v, sizeof(v)); return sizeof(v); }
+		case 'b': { GLboolean v; args.Get(v); memcpy(out, &v, sizeof(v)); return sizeof(v); }
+		case 'B': { GLubyte v; args.Get(v); memcpy(out, &v, sizeof(v)); return sizeof(v); }
+		case 'p': {
+			GLvoid *v; args.Get(v);
+			long long w = (long long)(size_t)v;
+			memcpy(out, &w, sizeof(w));
+			return sizeof(w);
+		}
+		case 'z': {
+			GLintptr v; args.Get(v);
+			long long w = (long long)v;
+			memcpy(out, &w, sizeof(w));
+			return sizeof(w);
+		}
+	}
+	return 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// CallLog::Ring functions
+//////////////////////////////////////////////////////////////////////////////////
+
+CallLog::Ring::Ring(unsigned short _thread) :
+	data(ringSize),
+	head(0),
+	tail(0),
+	nDropped(0),
+	nReported(0),
+	thread(_thread)
+{}
+
+// Producer only.  The record is copied in before head moves past it,
+// so the drainer never sees half of one.
+
+bool CallLog::Ring::push(const void *record, unsigned int size) {
+	unsigned int h = (unsigned int)head;
+	unsigned int t = (unsigned int)InterlockedCompareExchange(&tail, 0, 0);
+
+	if(ringSize - (h - t) < size) {
+		InterlockedIncrement(&nDropped);
+		return false;
+	}
+
+	unsigned int at = h & (ringSize - 1);
+	unsigned int first = std::min(size, ringSize - at);
+	memcpy(&data[at], record, first);
+	memcpy(&data[0], (const char *)record + first, size - first);
+
+	InterlockedExchange(&head, (LONG)(h + size));
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// CallLog functions
+//////////////////////////////////////////////////////////////////////////////////
+
+CallLog::CallLog(std::string fileName) :
+	drainer(0),
+	stopping(0)
+{
+	memset(signatures, 0, sizeof(signatures));
+	memset((void *)named, 0, sizeof(named));
+
+	ringSlot = TlsAlloc();
+	InitializeCriticalSection(&lock);
+	InitializeConditionVariable(&wake);
+
+	file = fopen(fileName.c_str(), "wb");
+	if(!file) {
+		fprintf(OGLE::LOG, "CallLog: unable to open %s\n", fileName.c_str());
+		return;
+	}
+
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+
+	CallLogHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CALL_LOG_MAGIC, sizeof(header.magic));
+	header.version = CALL_LOG_VERSION;
+	header.ticksPerSecond = freq.QuadPart;
+	fwrite(&header, sizeof(header), 1, file);
+
+	drainer = CreateThread(NULL, 0, drainerMain, this, 0, NULL);
+}
+
+CallLog::~CallLog() {
+	if(drainer) {
+		EnterCriticalSection(&lock);
+		stopping = 1;
+		WakeConditionVariable(&wake);
+		LeaveCriticalSection(&lock);
+
+		WaitForSingleObject(drainer, INFINITE);
+		CloseHandle(drainer);
+	}
+
+	if(file) {
+		fclose(file);
+	}
+
+	for(int i = 0; i < rings.size(); i++) {
+		delete rings[i];
+	}
+
+	TlsFree(ringSlot);
+	DeleteCriticalSection(&lock);
+}
+
+
+// Looked up by name the first time an index is seen.  The first thread
+// to see it also logs its name, so the decoder can put a name to the
+// index.
+
+const CallLog::Signature *CallLog::signature(uint funcIndex, const char *funcName) {
+	const Signature *sig = funcIndex < MAX_FUNCTIONS ? signatures[funcIndex] : 0;
+
+	if(!sig) {
+		sig = &unknownSignature;
+		for(int i = 0; i < sizeof(signatureTable) / sizeof(signatureTable[0]); i++) {
+			if(strcmp(funcName, signatureTable[i].name) == 0) {
+				sig = &signatureTable[i];
+				break;
+			}
+		}
+		if(funcIndex < MAX_FUNCTIONS) {
+			signatures[funcIndex] = sig;
+		}
+	}
+
+	if(funcIndex < MAX_FUNCTIONS && !named[funcIndex]
+			&& !InterlockedCompareExchange(&named[funcIndex], 1, 0)) {
+		char payload[maxPayload];
+		size_t nName = std::min(strlen(funcName), (size_t)maxPayload - 64);
+		size_t nArgs = strlen(sig->args);
+
+		memcpy(payload, funcName, nName);
+		payload[nName] = 0;
+		memcpy(payload + nName + 1, sig->args, nArgs + 1);
+		payload[nName + nArgs + 2] = sig->ret;
+		payload[nName + nArgs + 3] = 0;
+
+		CallLogRecord r;
+		r.size = (unsigned int)(sizeof(r) + nName + nArgs + 4);
+		r.type = CALL_NAME;
+		r.funcIndex = funcIndex;
+		push(r, payload);
+	}
+
+	return sig;
+}
+
+void CallLog::logPre(uint funcIndex, const char *funcName, const FunctionArgs &args) {
+	if(!file) return;
+
+	const Signature *sig = signature(funcIndex, funcName);
+
+	char payload[maxPayload];
+	unsigned int size = 0;
+
+	FunctionArgs _args(args);
+	for(const char *c = sig->args; *c && size + 8 <= maxPayload; c++) {
+		size += getValue(_args, *c, payload + size);
+	}
+
+	CallLogRecord r;
+	r.size = sizeof(r) + size;
+	r.type = CALL_PRE;
+	r.funcIndex = funcIndex;
+	push(r, payload);
+}
+
+void CallLog::logPost(uint funcIndex, const char *funcName, const FunctionRetValue &retVal) {
+	if(!file) return;
+
+	const Signature *sig = signature(funcIndex, funcName);
+	if(sig->ret == 'v') return;
+
+	char payload[8];
+	FunctionRetValue _retVal(retVal);
+
+	CallLogRecord r;
+	r.size = sizeof(r) + getValue(_retVal, sig->ret, payload);
+	r.type = CALL_POST;
+	r.funcIndex = funcIndex;
+	push(r, payload);
+}
+
+
+// Stamp the record and put it, with its payload, in this thread's ring.
+
+void CallLog::push(CallLogRecord &r, const void *payload) {
+	Ring *ring = threadRing();
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	r.time = now.QuadPart;
+	r.thread = ring->thread;
+
+	char record[sizeof(CallLogRecord) + maxPayload];
+	memcpy(record, &r, sizeof(r));
+	memcpy(record + sizeof(r), payload, r.size - sizeof(r));
+
+	ring->push(record, r.size);
+}
+
+CallLog::Ring *CallLog::threadRing() {
+	Ring *ring = (Ring *)TlsGetValue(ringSlot);
+	if(ring) return ring;
+
+	EnterCriticalSection(&lock);
+	ring = new Ring((unsigned short)rings.size());
+	rings.push_back(ring);
+	LeaveCriticalSection(&lock);
+
+	TlsSetValue(ringSlot, ring);
+	return ring;
+}
+
+
+DWORD WINAPI CallLog::drainerMain(LPVOID param) {
+	((CallLog *)param)->runDrainer();
+	return 0;
+}
+
+void CallLog::runDrainer() {
+	for(;;) {
+		EnterCriticalSection(&lock);
+		if(!stopping) {
+			SleepConditionVariableCS(&wake, &lock, drainInterval);
+		}
+		bool stop = stopping;
+		LeaveCriticalSection(&lock);
+
+		drain();
+
+		if(stop) break;
+	}
+	fflush(file);
+}
+
+// Write out what each ring holds, and how many records it dropped
+// since the last time.  Rings are never removed, so once the list is
+// copied they can be drained without the lock.
+
+void CallLog::drain() {
+	EnterCriticalSection(&lock);
+	std::vector<Ring *> current(rings);
+	LeaveCriticalSection(&lock);
+
+	for(size_t i = 0; i < current.size(); i++) {
+		Ring *ring = current[i];
+
+		unsigned int t = (unsigned int)ring->tail;
+		unsigned int h = (unsigned int)InterlockedCompareExchange(&ring->head, 0, 0);
+
+		if(h != t) {
+			unsigned int at = t & (ringSize - 1);
+			unsigned int size = h - t;
+			unsigned int first = std::min(size, ringSize - at);
+
+			fwrite(&ring->data[at], 1, first, file);
+			fwrite(&ring->data[0], 1, size - first, file);
+
+			InterlockedExchange(&ring->tail, (LONG)h);
+		}
+
+		LONG dropped = ring->nDropped;
+		if(dropped != ring->nReported) {
+			LARGE_INTEGER now;
+			QueryPerformanceCounter(&now);
+
+			CallLogRecord r;
+			r.size = sizeof(r);
+			r.type = CALL_DROPPED;
+			r.thread = ring->thread;
+			r.funcIndex = (unsigned int)(dropped - ring->nReported);
+			r.time = now.QuadPart;
+			fwrite(&r, sizeof(r), 1, file);
+
+			ring->nReported = dropped;
+		}
+	}
+}
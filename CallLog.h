@@ -0,0 +1,88 @@
+#ifndef __CALLLOG_H_
+#define __CALLLOG_H_
+
+#include "../../MainLib/InterceptPluginInterface.h"
+
+#include <windows.h>
+
+#include <string>
+#include <vector>
+
+#include "Ptr/Interface.h"
+#include "Ptr/Ptr.h"
+
+#include "CallLogFormat.h"
+
+//////////////////////////////////////////////////////////////////////
+// CallLog -- the binary form of LogFunctions.
+//
+// Each call is appended, raw, to a ring belonging to the thread that
+// made it; a background thread drains the rings to the file.  A thread
+// never waits: when its ring is full the record is dropped and
+// counted.  tools/CallLogDump turns the file into text.
+//////////////////////////////////////////////////////////////////////
+
+class CallLog : public Interface {
+
+  public:
+
+	CallLog(std::string fileName);
+	~CallLog();
+
+	bool isOpen() const { return file != 0; }
+
+	// from any thread
+	void logPre(uint funcIndex, const char *funcName, const FunctionArgs &args);
+	void logPost(uint funcIndex, const char *funcName, const FunctionRetValue &retVal);
+
+	// a function's argument and return codes
+	struct Signature {
+		const char *name;
+		const char *args;
+		char ret;
+	};
+
+  private:
+
+	// one thread's records.  Only that thread moves head, and only the
+	// drainer moves tail; both count bytes ever written, and wrap.
+	class Ring {
+		public:
+			Ring(unsigned short _thread);
+
+			bool push(const void *record, unsigned int size);
+
+			std::vector<char> data;
+			volatile LONG head, tail;
+			volatile LONG nDropped;
+			LONG nReported;
+			unsigned short thread;
+	};
+
+	enum { MAX_FUNCTIONS = 4096 };
+
+	const Signature *signature(uint funcIndex, const char *funcName);
+	void push(CallLogRecord &r, const void *payload);
+	Ring *threadRing();
+
+	static DWORD WINAPI drainerMain(LPVOID param);
+	void runDrainer();
+	void drain();
+
+	FILE *file;
+
+	DWORD ringSlot;
+	std::vector<Ring *> rings;
+
+	const Signature *signatures[MAX_FUNCTIONS];
+	volatile LONG named[MAX_FUNCTIONS];
+
+	HANDLE drainer;
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE wake;
+	bool stopping;
+};
+
+typedef Ptr<CallLog> CallLogPtr;
+
+#endif // __CALLLOG_H_
@@ -0,0 +1,58 @@
+#ifndef __CALLLOGFORMAT_H_
+#define __CALLLOGFORMAT_H_
+
+//////////////////////////////////////////////////////////////////////
+// The binary function call log's file format, shared by CallLog and
+// the tools/CallLogDump decoder.  Everything is little endian.
+//
+// The file is a CallLogHeader and then records, each a CallLogRecord
+// followed by its payload:
+//
+//   CALL_NAME     the function's name, argument codes and return code,
+//                 each nul terminated
+//   CALL_PRE      the arguments, packed, each sized by its code
+//   CALL_POST     the return value
+//   CALL_DROPPED  funcIndex is how many records the thread's ring had
+//                 no room for since the last one
+//
+// Each thread's records are in the order it made them, but threads
+// are written a chunk at a time, so readers sort by time.  A
+// function's CALL_NAME is written once, by the first thread to call
+// it, and may come after other threads' calls to it.
+//
+// Argument codes: e GLenum, u GLuint or GLbitfield, i GLint or
+// GLsizei, f GLfloat, B GLubyte, b GLboolean, d GLdouble, each its own
+// size; p a pointer and z a GLintptr or GLsizeiptr, always 8 bytes so
+// 32 and 64 bit logs read the same; v for no value.
+//////////////////////////////////////////////////////////////////////
+
+#define CALL_LOG_MAGIC "OGLECALL"
+#define CALL_LOG_VERSION 1
+
+enum CallLogRecordType {
+	CALL_NAME = 1,
+	CALL_PRE,
+	CALL_POST,
+	CALL_DROPPED
+};
+
+#pragma pack(push, 1)
+
+struct CallLogHeader {
+	char magic[8];
+	unsigned int version;
+	unsigned int reserved;
+	long long ticksPerSecond;
+};
+
+struct CallLogRecord {
+	unsigned int size;		// of the record, payload included
+	unsigned short type;
+	unsigned short thread;
+	unsigned int funcIndex;
+	long long time;			// in ticks
+};
+
+#pragma pack(pop)
+
+#endif // __CALLLOGFORMAT_H_
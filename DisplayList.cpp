@@ -0,0 +1,105 @@
+#include "stdafx.h"
+
+#include "ogle.h"
+
+#include "Ptr/Ptr.in"
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// OGLE::DisplayList functions
+//////////////////////////////////////////////////////////////////////////////////
+
+static void appendVertex(std::vector<GLfloat> &a, const OGLE::Vertex *v) {
+	if(v) {
+		a.push_back(v->x);
+		a.push_back(v->y);
+		a.push_back(v->z);
+		a.push_back(v->w);
+	}
+	else {
+		a.insert(a.end(), 4, 0.0f);
+	}
+}
+
+void OGLE::DisplayList::addSet(const ElementSet &set) {
+	if(set.elements.empty()) return;
+
+	Prim prim;
+	prim.mode = set.mode;
+	prim.first = flags.size();
+	prim.count = set.elements.size();
+	prims.push_back(prim);
+
+	for(int i = 0; i < set.elements.size(); i++) {
+		const Element &e = *set.elements[i].rawPtr();
+
+		appendVertex(v, e.v.rawPtr());
+		appendVertex(n, e.n.rawPtr());
+		appendVertex(t, e.t.rawPtr());
+		appendVertex(c, e.c.rawPtr());
+
+		flags.push_back((e.n.rawPtr() ? HAS_NORMAL : 0) | (e.t.rawPtr() ? HAS_TEXCOORD : 0)
+			| (e.c.rawPtr() ? HAS_COLOR : 0));
+	}
+}
+
+// Append nPrims of src's prims from firstPrim.  src may have been
+// compacted, and be missing the arrays none of its elements use.
+
+static void appendArray(std::vector<GLfloat> &a, const std::vector<GLfloat> &src, size_t first, size_t count) {
+	if(src.empty()) a.insert(a.end(), 4 * count, 0.0f);
+	else a.insert(a.end(), src.begin() + 4 * first, src.begin() + 4 * (first + count));
+}
+
+void OGLE::DisplayList::addPrims(const DisplayList &src, size_t firstPrim, size_t nPrims) {
+	if(!nPrims) return;
+
+	const Prim &last = src.prims[firstPrim + nPrims - 1];
+	size_t first = src.prims[firstPrim].first;
+	size_t count = last.first + last.count - first;
+
+	for(size_t i = firstPrim; i < firstPrim + nPrims; i++) {
+		Prim prim = src.prims[i];
+		prim.first = prim.first - first + flags.size();
+		prims.push_back(prim);
+	}
+
+	appendArray(v, src.v, first, count);
+	appendArray(n, src.n, first, count);
+	appendArray(t, src.t, first, count);
+	appendArray(c, src.c, first, count);
+	flags.insert(flags.end(), src.flags.begin() + first, src.flags.begin() + first + count);
+}
+
+// The list is complete; give back what the vectors over-allocated
+// while it was growing.
+
+void OGLE::DisplayList::compact() {
+	std::vector<Prim>(prims).swap(prims);
+	std::vector<GLfloat>(v).swap(v);
+	std::vector<GLubyte>(flags).swap(flags);
+	std::vector<GLuint>(calls).swap(calls);
+
+	// most lists carry no normals, texcoords or colours at all
+	bool anyNormal = false, anyTexCoord = false, anyColor = false;
+	for(int i = 0; i < flags.size(); i++) {
+		if(flags[i] & HAS_NORMAL) anyNormal = true;
+		if(flags[i] & HAS_TEXCOORD) anyTexCoord = true;
+		if(flags[i] & HAS_COLOR) anyColor = true;
+	}
+
+	if(anyNormal) std::vector<GLfloat>(n).swap(n);
+	else std::vector<GLfloat>().swap(n);
+
+	if(anyTexCoord) std::vector<GLfloat>(t).swap(t);
+	else std::vector<GLfloat>().swap(t);
+
+	if(anyColor) std::vector<GLfloat>(c).swap(c);
+	else std::vector<GLfloat>().swap(c);
+}
+
+size_t OGLE::DisplayList::bytes() const {
+	return prims.size() * sizeof(Prim)
+		+ (v.size() + n.size() + t.size() + c.size()) * sizeof(GLfloat)
+		+ flags.size() + calls.size() * sizeof(GLuint);
+}
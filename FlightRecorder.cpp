@@ -0,0 +1,177 @@
+#include "stdafx.h"
+
+#include "ogle.h"
+
+#include "Ptr/Ptr.in"
+
+#include <algorithm>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// OGLE::FlightRecorder functions
+//////////////////////////////////////////////////////////////////////////////////
+
+// What one element costs in a frame's geometry: four floats each of
+// position, normal, texcoord and colour, and its flags.
+
+static const size_t elementBytes = 16 * sizeof(GLfloat) + 1;
+
+
+// The arenas are allocated up front, at their full size, so capturing
+// never allocates once the frames have been round the ring.
+
+OGLE::FlightRecorder::FlightRecorder(int nFrames, size_t _arenaBytes) :
+	frames(std::max(nFrames, 1)),
+	curr(0),
+	nHeld(1),
+	arenaBytes(_arenaBytes)
+{
+	InitializeCriticalSection(&lock);
+
+	size_t nElements = arenaBytes / elementBytes;
+
+	for(int i = 0; i < frames.size(); i++) {
+		DisplayList *dl = new DisplayList(GL_COMPILE);
+		dl->v.reserve(4 * nElements);
+		dl->n.reserve(4 * nElements);
+		dl->t.reserve(4 * nElements);
+		dl->c.reserve(4 * nElements);
+		dl->flags.reserve(nElements);
+
+		frames[i].geometry = dl;
+	}
+}
+
+OGLE::FlightRecorder::~FlightRecorder() {
+	DeleteCriticalSection(&lock);
+}
+
+
+// Start the next frame in the oldest arena.  clear() keeps the
+// vectors' memory.
+
+void OGLE::FlightRecorder::beginFrame(unsigned int number) {
+	EnterCriticalSection(&lock);
+
+	curr = (curr + 1) % frames.size();
+	nHeld = std::min(nHeld + 1, (int)frames.size());
+
+	Frame &f = frames[curr];
+	f.number = number;
+	f.nDropped = 0;
+	f.ticks = 0;
+	f.draws.clear();
+
+	DisplayList &dl = *f.geometry.rawPtr();
+	dl.prims.clear();
+	dl.v.clear();
+	dl.n.clear();
+	dl.t.clear();
+	dl.c.clear();
+	dl.flags.clear();
+
+	LeaveCriticalSection(&lock);
+}
+
+
+// Consecutive prims under the same matrices share one Draw, so a batch
+// of sub-draws costs its geometry and nothing more.
+
+void OGLE::FlightRecorder::addDraw(Frame &f, size_t prim, size_t nPrims, const GLfloat *M, const GLfloat *TM) {
+	Draw *last = f.draws.empty() ? 0 : &f.draws.back();
+	if(last && last->firstPrim + last->nPrims == prim
+			&& !memcmp(last->M, M, sizeof(last->M)) && !memcmp(last->TM, TM, sizeof(last->TM))) {
+		last->nPrims += nPrims;
+	}
+	else {
+		f.draws.push_back(Draw());
+		Draw &d = f.draws.back();
+		d.firstPrim = prim;
+		d.nPrims = nPrims;
+		memcpy(d.M, M, sizeof(d.M));
+		memcpy(d.TM, TM, sizeof(d.TM));
+	}
+}
+
+// set is untransformed.
+
+void OGLE::FlightRecorder::addSet(const ElementSet &set, const GLfloat *M, const GLfloat *TM) {
+	if(set.elements.empty()) return;
+
+	EnterCriticalSection(&lock);
+
+	Frame &f = frames[curr];
+	DisplayList &dl = *f.geometry.rawPtr();
+
+	size_t need = set.elements.size() * elementBytes + sizeof(DisplayList::Prim) + sizeof(Draw);
+	if(f.bytes() + need > arenaBytes) {
+		f.nDropped++;
+		LeaveCriticalSection(&lock);
+		return;
+	}
+
+	size_t prim = dl.prims.size();
+	dl.addSet(set);
+	addDraw(f, prim, 1, M, TM);
+
+	LeaveCriticalSection(&lock);
+}
+
+// A display list or instanced mesh is copied in rather than referenced:
+// the list is the application's to replace or delete, and a mesh is
+// made for the one draw, and either way what the frame holds has to be
+// what the arena says it does.
+
+void OGLE::FlightRecorder::addList(const DisplayList &list, size_t firstPrim, size_t nPrims,
+		const GLfloat *M, const GLfloat *TM) {
+	if(!nPrims) return;
+
+	const DisplayList::Prim &lastPrim = list.prims[firstPrim + nPrims - 1];
+	size_t nElements = lastPrim.first + lastPrim.count - list.prims[firstPrim].first;
+
+	EnterCriticalSection(&lock);
+
+	Frame &f = frames[curr];
+	DisplayList &dl = *f.geometry.rawPtr();
+
+	size_t need = nElements * elementBytes + nPrims * sizeof(DisplayList::Prim) + sizeof(Draw);
+	if(f.bytes() + need > arenaBytes) {
+		f.nDropped++;
+		LeaveCriticalSection(&lock);
+		return;
+	}
+
+	size_t prim = dl.prims.size();
+	dl.addPrims(list, firstPrim, nPrims);
+	addDraw(f, prim, nPrims, M, TM);
+
+	LeaveCriticalSection(&lock);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Writing out a recorded frame
+//////////////////////////////////////////////////////////////////////////////////
+
+// The draws go through emitGeometry like called lists do, with the
+// recorder taken away so the sets reach the file, and the governor, so
+// what was captured is written in full.
+
+void OGLE::writeFlightFrame(const FlightRecorder::Frame &frame, string fileName) {
+	FlightRecorderPtr rec = flight;
+	GovernorPtr gov = governor;
+	flight = 0;
+	governor = 0;
+
+	startRecording(fileName);
+
+	for(int i = 0; i < frame.draws.size(); i++) {
+		const FlightRecorder::Draw &d = frame.draws[i];
+		emitGeometry(*frame.geometry.rawPtr(), d.M, d.TM, d.firstPrim, d.nPrims);
+	}
+
+	stopRecording();
+
+	flight = rec;
+	governor = gov;
+}
@@ -0,0 +1,116 @@
+#include "stdafx.h"
+
+#include "ogle.h"
+
+#include "Ptr/Ptr.in"
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// OGLE::Governor functions
+//////////////////////////////////////////////////////////////////////////////////
+
+// Frames that come in this far under the budget, this many in a row,
+// let the level back down a step.  Coming down slower than going up
+// keeps it from see-sawing on a scene that sits near the budget.
+
+static const int underFraction = 2;
+static const int underFrames = 4;
+
+static const char *levelNames[] = {
+	"everything",
+	"no normals or texcoords",
+	"no normals or texcoords, transforms deferred",
+};
+
+
+OGLE::Governor::Governor(float budgetMs) :
+	currLevel(FULL),
+	ticks(0),
+	nDraws(0),
+	nSkipped(0),
+	nUnder(0)
+{
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+
+	ticksPerMs = freq.QuadPart / 1000.0;
+	budget = (LONGLONG)(budgetMs * ticksPerMs);
+}
+
+
+// At SAMPLED the first draw of each two is kept, and each level past it
+// doubles the stride.  Draws on different threads share the count, so
+// what is kept is a fair sample of the frame either way.
+
+bool OGLE::Governor::sampleDraw() {
+	int l = currLevel;
+	if(l < SAMPLED) return true;
+
+	LONG stride = 2 << (l - SAMPLED);
+	LONG n = InterlockedIncrement(&nDraws);
+
+	if((n - 1) % stride) {
+		InterlockedIncrement(&nSkipped);
+		return false;
+	}
+	return true;
+}
+
+
+void OGLE::Governor::endFrame(unsigned int number, bool recorded) {
+	LONGLONG t = InterlockedExchange64(&ticks, 0);
+	LONG draws = InterlockedExchange(&nDraws, 0);
+	LONG skipped = InterlockedExchange(&nSkipped, 0);
+
+	int was = currLevel;
+
+	// the recording is over; the next one is a different scene, and
+	// what it costs is not known until it has been measured
+	if(!recorded) {
+		nUnder = 0;
+		if(was != FULL) {
+			fprintf(OGLE::LOG, "Capture governor: not recording, level %d -> %d\n", was, (int)FULL);
+			fflush(OGLE::LOG);
+			InterlockedExchange(&currLevel, FULL);
+		}
+		return;
+	}
+
+	int next = was;
+
+	if(t > budget) {
+		if(next < MAX_LEVEL) next++;
+		nUnder = 0;
+	}
+	else if(t < budget / underFraction && next > FULL) {
+		if(++nUnder >= underFrames) {
+			next--;
+			nUnder = 0;
+		}
+	}
+	else {
+		nUnder = 0;
+	}
+
+	if(was == FULL && next == FULL) return;
+
+	fprintf(OGLE::LOG, "Capture governor: frame %u, %.2f ms capturing of %.2f ms budget",
+			number, t / ticksPerMs, budget / ticksPerMs);
+
+	if(was != FULL) {
+		if(was < SAMPLED) {
+			fprintf(OGLE::LOG, ", captured %s", levelNames[was]);
+		}
+		else {
+			fprintf(OGLE::LOG, ", captured %s, kept 1 draw in %d, %d of %d skipped",
+					levelNames[DEFERRED], 2 << (was - SAMPLED), (int)skipped, (int)draws);
+		}
+	}
+	fprintf(OGLE::LOG, "\n");
+
+	if(next != was) {
+		fprintf(OGLE::LOG, "Capture governor: level %d -> %d\n", was, next);
+		InterlockedExchange(&currLevel, next);
+	}
+	fflush(OGLE::LOG);
+}
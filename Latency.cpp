@@ -0,0 +1,154 @@
+#include "stdafx.h"
+
+#include "Latency.h"
+#include "ogle.h"
+
+#include "Ptr/Ptr.in"
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Latency functions
+//////////////////////////////////////////////////////////////////////////////////
+
+static const char *stateNames[] = {
+	"idle",
+	"recording",
+};
+
+
+Latency::Histogram::Histogram() :
+	n(0),
+	max(0)
+{
+	memset((void *)counts, 0, sizeof(counts));
+}
+
+Latency::Latency() {
+	memset((void *)histograms, 0, sizeof(histograms));
+	memset((void *)names, 0, sizeof(names));
+
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	usPerTick = 1000000.0 / freq.QuadPart;
+}
+
+Latency::~Latency() {
+	for(int i = 0; i < MAX_FUNCTIONS; i++) {
+		for(int s = 0; s < N_STATES; s++) {
+			delete histograms[i][s];
+		}
+	}
+}
+
+
+// Below N_LINEAR ticks each value has its own bucket; above it, the
+// power of two is split into 2^SUB_BITS even steps.  Anything past 32
+// bits of ticks, minutes at any QPC rate, goes in the last.
+
+int Latency::bucket(unsigned long ticks) {
+	if(ticks < N_LINEAR) return ticks;
+
+	unsigned long e;
+	BitScanReverse(&e, ticks);
+
+	return N_LINEAR + (e - SUB_BITS - 1) * (1 << SUB_BITS) + ((ticks >> (e - SUB_BITS)) & ((1 << SUB_BITS) - 1));
+}
+
+// The largest value that goes in bucket b.
+
+unsigned long Latency::bucketTop(int b) {
+	if(b < N_LINEAR) return b;
+
+	int k = b - N_LINEAR;
+	int shift = k >> SUB_BITS;
+	unsigned long first = ((1UL << SUB_BITS) + (k & ((1 << SUB_BITS) - 1))) << (shift + 1);
+
+	return first + (1UL << (shift + 1)) - 1;
+}
+
+// The top of the bucket the p'th call falls in, but no more than the
+// worst call seen.
+
+unsigned long Latency::percentile(const LONG *counts, LONG n, unsigned long max, double p) {
+	LONG rank = (LONG)(p * n + 0.5);
+	if(rank < 1) rank = 1;
+
+	LONG seen = 0;
+	int b;
+	for(b = 0; b < N_BUCKETS; b++) {
+		seen += counts[b];
+		if(seen >= rank) break;
+	}
+
+	unsigned long top = bucketTop(b < N_BUCKETS ? b : N_BUCKETS - 1);
+	return top < max ? top : max;
+}
+
+
+void Latency::add(uint funcIndex, const char *funcName, int state, LONGLONG ticks) {
+	if(funcIndex >= MAX_FUNCTIONS) return;
+
+	Histogram *h = histograms[funcIndex][state];
+	if(!h) {
+		// the first call of a function on two threads at once makes
+		// two; the one that loses is thrown away
+		names[funcIndex] = funcName;
+
+		Histogram *made = new Histogram();
+		h = (Histogram *)InterlockedCompareExchangePointer((void * volatile *)&histograms[funcIndex][state], made, 0);
+		if(h) {
+			delete made;
+		}
+		else {
+			h = made;
+		}
+	}
+
+	unsigned long t = ticks > 0xffffffff ? 0xffffffff : (unsigned long)ticks;
+
+	InterlockedIncrement(&h->counts[bucket(t)]);
+	InterlockedIncrement(&h->n);
+
+	LONG m = h->max;
+	while((unsigned long)m < t) {
+		LONG was = InterlockedCompareExchange(&h->max, (LONG)t, m);
+		if(was == m) break;
+		m = was;
+	}
+}
+
+// Each bucket is taken and zeroed in one exchange, so a call that lands
+// while this runs is counted in this frame or the next, never lost.
+
+void Latency::endFrame(unsigned int number) {
+	bool any = false;
+	LONG counts[N_BUCKETS];
+
+	for(int i = 0; i < MAX_FUNCTIONS; i++) {
+		for(int s = 0; s < N_STATES; s++) {
+			Histogram *h = histograms[i][s];
+			if(!h || !h->n) continue;
+
+			LONG n = 0;
+			for(int b = 0; b < N_BUCKETS; b++) {
+				counts[b] = InterlockedExchange(&h->counts[b], 0);
+				n += counts[b];
+			}
+			InterlockedExchangeAdd(&h->n, -n);
+			unsigned long max = (unsigned long)InterlockedExchange(&h->max, 0);
+
+			if(!n) continue;
+
+			if(!any) {
+				fprintf(OGLE::LOG, "Latency, frame %u (us, p50 / p99 / max):\n", number);
+				any = true;
+			}
+
+			fprintf(OGLE::LOG, "  %-32s %-9s %8d calls  %9.2f %9.2f %9.2f\n",
+				names[i] ? names[i] : "?", stateNames[s], n,
+				percentile(counts, n, max, 0.5) * usPerTick,
+				percentile(counts, n, max, 0.99) * usPerTick,
+				max * usPerTick);
+		}
+	}
+}
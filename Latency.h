@@ -0,0 +1,72 @@
+#ifndef __LATENCY_H_
+#define __LATENCY_H_
+
+#include "../../MainLib/InterceptPluginInterface.h"
+
+#include <windows.h>
+
+#include "Ptr/Interface.h"
+#include "Ptr/Ptr.h"
+
+//////////////////////////////////////////////////////////////////////
+// Latency -- how long the plugin holds up each GL call.
+//
+// The time spent in GLFunctionPre and GLFunctionPost goes into a
+// histogram per function, one for calls made while a frame is being
+// recorded and one for the rest.  The buckets are log-linear, eight to
+// each power of two, so a percentile read off them is within 1/8 of
+// the true value at any scale.  At each frame end the median, 99th
+// percentile and worst call of every function that was called are
+// logged, and the histograms start over.
+//////////////////////////////////////////////////////////////////////
+
+class Latency : public Interface {
+
+  public:
+
+	enum State {
+		IDLE,
+		RECORDING,
+		N_STATES
+	};
+
+	Latency();
+	~Latency();
+
+	// from any thread
+	void add(uint funcIndex, const char *funcName, int state, LONGLONG ticks);
+
+	// log the frame's summaries and start the next
+	void endFrame(unsigned int number);
+
+  private:
+
+	enum {
+		MAX_FUNCTIONS = 4096,
+		SUB_BITS = 3,
+		N_LINEAR = 2 << SUB_BITS,
+		N_BUCKETS = N_LINEAR + (32 - SUB_BITS - 1) * (1 << SUB_BITS)
+	};
+
+	class Histogram {
+		public:
+			Histogram();
+
+			volatile LONG counts[N_BUCKETS];
+			volatile LONG n;
+			volatile LONG max;
+	};
+
+	static int bucket(unsigned long ticks);
+	static unsigned long bucketTop(int b);
+	static unsigned long percentile(const LONG *counts, LONG n, unsigned long max, double p);
+
+	Histogram * volatile histograms[MAX_FUNCTIONS][N_STATES];
+	const char * volatile names[MAX_FUNCTIONS];
+
+	double usPerTick;
+};
+
+typedef Ptr<Latency> LatencyPtr;
+
+#endif // __LATENCY_H_
@@ -0,0 +1,99 @@
+#ifndef __MPSCQUEUE_H_
+#define __MPSCQUEUE_H_
+
+#include <windows.h>
+
+//////////////////////////////////////////////////////////////////////
+// MpscQueue -- a lock free queue with any number of producers and a
+// single consumer.
+//
+// A push is one interlocked exchange of the tail, so producers never
+// wait on each other or on the consumer; items come out in the order
+// those exchanges happened.  A producer that has swapped the tail but
+// not yet linked its node makes pop() see the queue as empty for a
+// moment, so the consumer must not take an empty pop() as final while
+// producers may still be running.
+//////////////////////////////////////////////////////////////////////
+
+template <class T>
+class MpscQueue {
+
+  public:
+
+	MpscQueue() : head(&stub), tail(&stub) {
+		stub.next = 0;
+	}
+
+	~MpscQueue() {
+		T item;
+		while(pop(item)) {}
+	}
+
+	void push(const T &item) {
+		Node *node = new Node(item);
+
+		Node *prev = (Node *)InterlockedExchangePointer((void * volatile *)&tail, node);
+		prev->next = node;
+	}
+
+	// consumer only
+	bool pop(T &item) {
+		Node *first = head;
+		Node *next = first->next;
+
+		if(first == &stub) {
+			if(!next) return false;
+
+			// step over the stub
+			head = next;
+			first = next;
+			next = next->next;
+		}
+
+		if(!next) {
+			if(first != tail) {
+				// a push is half done
+				return false;
+			}
+
+			// first is the last node; put the stub back behind it
+			// so it can be taken without emptying the list
+			stub.next = 0;
+			Node *prev = (Node *)InterlockedExchangePointer((void * volatile *)&tail, &stub);
+			prev->next = &stub;
+
+			next = first->next;
+			if(!next) return false;
+		}
+
+		head = next;
+		item = first->item;
+		delete first;
+		return true;
+	}
+
+	bool empty() const {
+		return head == &stub && !stub.next;
+	}
+
+  private:
+
+	class Node {
+		public:
+			Node() : next(0) {}
+			Node(const T &_item) : item(_item), next(0) {}
+
+			T item;
+			Node * volatile next;
+	};
+
+	Node *head;
+	Node * volatile tail;
+	Node stub;
+
+	// not copyable
+	MpscQueue(const MpscQueue &);
+	MpscQueue &operator=(const MpscQueue &);
+};
+
+#endif // __MPSCQUEUE_H_
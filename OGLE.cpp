@@ -1,820 +1,2844 @@
-#include "stdafx.h"
-
-#include "ogle.h"
-
-#include "ObjFile.h"
-
-#include "Ptr/Ptr.in"
-
-#ifndef GL_ARRAY_BUFFER
-#define GL_ARRAY_BUFFER 34962
-#endif
-
-#ifndef GL_ELEMENT_ARRAY_BUFFER
-#define GL_ELEMENT_ARRAY_BUFFER 34963
-#endif
-
-#ifndef GL_READ_ONLY
-#define GL_READ_ONLY 35000
-#endif
-
-#ifndef GL_WRITE_ONLY
-#define GL_WRITE_ONLY 35001
-#endif
-
-#ifndef GL_TEXTURE0
-#define GL_TEXTURE0  33984
-#endif
-
-
-/////////////////////////////////////////////
-// Static OGLE Variables
-/////////////////////////////////////////////
-
-char *OGLE::Config::polyTypes[] = {
-	"TRIANGLES",
-	"TRIANGLE_STRIP",
-	"TRIANGLE_FAN",
-	"QUADS",
-	"QUAD_STRIP",
-	"POLYGON"
-};
-int OGLE::Config::nPolyTypes = 6;
-
-OGLE::Config OGLE::config;
-
-FILE *OGLE::LOG = fopen("ogle.log", "w");
-
-
-/////////////////////////////////////////////
-// OGLE Initialization
-/////////////////////////////////////////////
-
-OGLE::OGLE(InterceptPluginCallbacks *_callBacks, const GLCoreDriver *_GLV) :
-	currSet(0),
-	currNormal(0),
-	currTexCoord(0),
-	activeClientTex(0),
-	callBacks(_callBacks),
-	GLV(_GLV),
-	buffers(OGLE_N_BUFFERS),
-	tArray(0),
-	tArrayActive(0),
-	tArrays(64)
-{
-	currSet = 0;
-	currNormal = 0;
-	currTexCoord = 0;
-
-	glClientActiveTexture(GL_TEXTURE0);
-}
-
-void OGLE::startRecording(string _objFileName) {
-	objFileName = _objFileName;
-	objFile = new ObjFile(objFileName);
-}
-
-void OGLE::stopRecording() {
-	objFile = 0;
-	objFileName = "";
-}
-
-
-
-/////////////////////////////////////////////////////////////////////////////////
-// OGLE's OpenGLFunctions
-/////////////////////////////////////////////////////////////////////////////////
-
-void  OGLE::glVertexfv(GLfloat *V, GLsizei n) {
-
-	if(currSet) {
-		currSet->addElement(new OGLE::Element(new OGLE::Vertex(V, n), 
-								(OGLE::config.captureTexCoords ? currTexCoord : 0),
-								(OGLE::config.captureNormals ? currNormal : 0)
-								)
-							);
-	}
-}
-
-void  OGLE::glNormalfv(GLfloat *V, GLsizei n) {
-	if(OGLE::config.captureNormals) {
-		currNormal = new OGLE::Vertex(V, n);
-		currNormal->w = 0;
-	}
-}
-
-void  OGLE::glTexCoordfv(GLfloat *V, GLsizei n) {
-	if(OGLE::config.captureTexCoords) {
-		currTexCoord = new OGLE::Vertex(V, n);
-		currTexCoord->w = 0;
-	}
-}
-
-
-void OGLE::glDrawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, 
-							GLenum type, const GLvoid *indices) {
-
-  checkBuffers();
-
-  indices = getBufferedIndices(indices);
-
-  if(!indices) {
-	  fprintf(OGLE::LOG, "\tOGLE::glDrawRangeElements: indices is null\n");	
-
-	  return;
-  }
-
-  newSet(mode);
-
-  for(int i = 0; i < count; i++) {
-	GLint index = derefIndexArray(type, indices, i);
-
-	if(index >= start && index <= end) {
-		glArrayElement(index);
-	}
-  }
-
-  addSet(currSet);
-  currSet = 0;
-
-}
-
-
-void OGLE::glDrawElements (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
-{
-    checkBuffers();
-
-	indices = getBufferedIndices(indices);
-
-	if(!indices) {
-		fprintf(OGLE::LOG, "\tOGLE::glDrawElements: indices is null\n");	
-		return;
-	}
-
-	newSet(mode);
-
-	int index;
-	for(int i = 0; i < count; i ++) {
-		index = derefIndexArray(type, indices, i);
-		glArrayElement(index);
-	}
-
-	addSet(currSet);
-	currSet = 0;
-}
-
-
-void  OGLE::glDrawArrays (GLenum mode, GLint first, GLsizei count) {
-
-  checkBuffers();
-
-  newSet(mode);
-
-  for(int i = 0; i < count; i ++) {
-	GLint index = i + first;
-	glArrayElement(index);
-  }
-
-  addSet(currSet);
-  currSet = 0;
-}
-
-void OGLE::glBegin(GLenum mode) {
-    checkBuffers();
-
-	newSet(mode);
-}
-
-void OGLE::glEnd() {
-  addSet(currSet);
-  currSet = 0;
-}
-
-
-void OGLE::glArrayElement(GLint i) {
-
-	if(isElementLocked(i)) {
-	  return;
-	}
-
-	if(!vArray.enabled) return;
-
-
-	GLfloat V[4];
-
-	if(OGLE::config.captureNormals && nArray.enabled) {
-		if(derefClientArray(&nArray, V, i)) {
-			glNormalfv(V, nArray.size);
-		}
-	}
-
-
-	if(OGLE::config.captureTexCoords && tArray && tArray->enabled) {
-		if(derefClientArray(tArray.rawPtr(), V, i)) {
-			glTexCoordfv(V, tArray->size);
-		}
-	}
-
-	if(derefClientArray(&vArray, V, i)) {
-		if(currSet) {
-			glVertexfv(V, vArray.size);
-		}
-	}
-	else {
-		fprintf(OGLE::LOG, "O::gAE Unable to DeRef Vertex Array\n");
-		return;
-	}
-
-}
-
-
-void OGLE::glEnableClientState (GLenum array)
-{
-  switch(array) {
-	  case GL_VERTEX_ARRAY: vArray.enabled = true; break;
-	  case GL_NORMAL_ARRAY: nArray.enabled = true; break;
-	  case GL_TEXTURE_COORD_ARRAY: 
-		  if(tArrayActive) tArrayActive->enabled = true; 		  
-		  break;
-  }
-}
-
-void OGLE::glDisableClientState (GLenum array)
-{
-  switch(array) {
-	  case GL_VERTEX_ARRAY:
-		  vArray.enabled = false;
-		  nArray.enabled = false;
-		  if(tArray) tArray->enabled = false;
-		  break;
-	  case GL_NORMAL_ARRAY: 
-		  nArray.enabled = true;
-		  break;
-	  case GL_TEXTURE_COORD_ARRAY: 
-		  if(tArrayActive) tArrayActive->enabled = false; break;
-		  break;
-  }
-}
-
-
-void OGLE::glClientActiveTexture(GLenum texture) {
-	activeClientTex = texture;
-
-	GLint ti = texture - GL_TEXTURE0;
-	CArrayPtr ta = tArrays[ti];
-	if(!ta) {
-		ta = new CArray();
-		tArrays[ti] = ta;
-	}
-	tArrayActive = ta;
-}
-
-void  OGLE::glLockArraysEXT(GLint first, GLsizei count) {	
-  glState["GL_LOCK_ARRAYS_FIRST"] = new OGLE::Blob(first);  
-  glState["GL_LOCK_ARRAYS_COUNT"] = new OGLE::Blob(count);  
-
-}
-
-void  OGLE::glUnlockArraysEXT() {
-  glState["GL_LOCK_ARRAYS_FIRST"] = 0;
-  glState["GL_LOCK_ARRAYS_COUNT"] = 0;
-}
-
-void OGLE::glVertexPointer (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
-{
-  vArray.size = size;
-  vArray.type = type;
-  vArray.stride = stride;
-  vArray.data = (const GLbyte *)pointer;
-
-  this->glEnableClientState(GL_VERTEX_ARRAY);
-}
-
-void OGLE::glNormalPointer (GLenum type, GLsizei stride, const GLvoid *pointer)
-{	
-  nArray.size = 3;
-  nArray.type = type;
-  nArray.stride = stride;
-  nArray.data = (const GLbyte *)pointer;
-
-  this->glEnableClientState(GL_NORMAL_ARRAY);
-}
-
-void OGLE::glTexCoordPointer (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
-{	
-	
-	if(tArrayActive) {
-	  tArrayActive->size = 3;
-	  tArrayActive->type = type;
-	  tArrayActive->stride = stride;
-	  tArrayActive->data = (const GLbyte *)pointer;
-
-	  tArray = tArrayActive;
-	}
-
-    this->glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-}
-
-
-void OGLE::glInterleavedArrays(GLenum format, GLsizei stride, const GLvoid *pointer) {
-
-	int str;
-
-	int f = sizeof(GL_FLOAT),
-		c = 4 * sizeof(GL_UNSIGNED_BYTE);
-
-	bool et = 0, ec = 0, en = 0;
-	GLenum tc;
-	int st = 0, sc = 0, sv = 0, pc = 0, pn = 0, pv = 0, s = 0;
-
-	switch(format) {
-
-		case GL_V2F:
-			sv = 2; s = 2*f;
-			break;
-
-		case GL_V3F:
-			sv = 3; s = 3*f;
-			break;
-
-		case GL_C4UB_V2F:
-			ec = 1; sc = 4; sv = 2; tc = GL_UNSIGNED_BYTE; pv = c; s = c+2*f;
-			break;
-
-		case GL_C4UB_V3F:
-			ec = 1; sc = 4; sv = 3; tc = GL_UNSIGNED_BYTE; pv = c; s = c+3*f;
-			break;
-
-		case GL_C3F_V3F:
-			ec = 1; sc = 3; sv = 3; tc = GL_FLOAT; pv = 3*f; s = 6*f;
-			break;
-
-		case GL_N3F_V3F:
-			en = 1; sv = 3; pv = 3*f; s = 6*f;
-			break;
-
-		case GL_C4F_N3F_V3F:
-			ec = 1; en = 1; sc = 4; sv = 3; tc = GL_FLOAT; pn = 4*f; pv = 7*f; s = 10*f;
-			break;
-
-		case GL_T2F_V3F:
-			et = 1; st = 2; sv = 3;pv = 2*f; s = 5*f;
-			break;
-
-		case GL_T4F_V4F:
-			et = 1; st = 4; sv = 4; pv = 4*f; s = 8*f;
-			break;
-
-		case GL_T2F_C4UB_V3F:
-			et = 1; ec = 1; st = 2; sc = 4; sv = 3; tc = GL_UNSIGNED_BYTE; pc = 2*f; pv = c+2*f; s = c+5*f;
-			break;
-
-		case GL_T2F_C3F_V3F:
-			et = 1; ec = 1; st = 2; sc = 3; sv = 3; tc = GL_FLOAT; pc = 2*f; pv = 5*f; s = 8*f;
-			break;
-
-		case GL_T2F_N3F_V3F:
-			et = 1; en = 1; st = 2; sv = 3; pn = 2*f; pv = 5*f; s = 8*f;
-			break;
-	
-		case GL_T2F_C4F_N3F_V3F:
-			et = 1; ec = 1; en = 1; st = 2; sc = 4; sv = 3; tc = GL_FLOAT; pc = 2*f; pn = 6*f; pv = 9*f; s = 12*f;
-			break;
-	
-		case GL_T4F_C4F_N3F_V4F:
-			et = 1; ec = 1; en = 1; st = 4; sc = 4; sv = 4; tc = GL_FLOAT; pc = 4*f; pn = 8*f; pv = 11*f; s = 15*f;
-			break;
-
-	
-		default:
-			return;
-
-
-	}
-
-
-	str = stride;
-
-	if (str == 0) {
-		str = s;
-	}
-
-	this->glDisableClientState(GL_EDGE_FLAG_ARRAY);
-	this->glDisableClientState(GL_INDEX_ARRAY);
-
-	if (et) {
-		this->glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-		this->glTexCoordPointer(st, GL_FLOAT, str, pointer);
-	}
-	else
-		this->glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-
-	if (ec) {
-//		this->glEnableClientState(GL_COLOR_ARRAY);
-//		this->glColorPointer(sc, tc, str, pointer+pc);
-	}
-	else
-//		this->glDisableClientState(GL_COLOR_ARRAY);
-
-	if (en) {
-		this->glEnableClientState(GL_NORMAL_ARRAY);
-		this->glNormalPointer(GL_FLOAT, str, ((GLbyte *)pointer) + pn);
-	}
-	else
-		this->glDisableClientState(GL_NORMAL_ARRAY);
-
-	this->glEnableClientState(GL_VERTEX_ARRAY);
-	this->glVertexPointer(sv, GL_FLOAT, str, ((GLbyte *)pointer)+pv);
-}
-
-
-
-void OGLE::glBindBuffer(GLenum target, GLuint buffer) {
-
-	switch(target) {
-		case GL_ARRAY_BUFFER: 
-			glState["GL_ARRAY_BUFFER_INDEX"] = new Blob(buffer); break;
-		case GL_ELEMENT_ARRAY_BUFFER: 
-			glState["GL_ELEMENT_ARRAY_BUFFER_INDEX"] = new Blob(buffer); break;
-	}
-}
-
-void OGLE::glBufferData(GLenum target, GLsizei size, const GLvoid *data, GLenum usage) {
-	GLuint index = getBufferIndex(target);
-
-	if(index) {
-		BufferPtr buff = new Buffer(data, size);
-		buffers[index] = buff;
-	}
-}
-
-void OGLE::glBufferSubData(GLenum target, GLint offset, GLsizei size, const GLvoid *data) {
-	GLuint index = getBufferIndex(target);
-
-	if(index) {
-		BufferPtr buff = buffers[index];
-		if(buff && offset < buff->size) {
-			GLbyte *p = (GLbyte *) buff->ptr;
-			if(offset + size > buff->size) {
-				size -= offset + size - buff->size;
-			}
-			if(data) {
-				memcpy(p + offset, data, size);
-			}
-		}
-	}
-}
-
-void OGLE::glMapBuffer(GLenum target, GLenum access) {
-	glState["GL_MAPPED_BUFFER_TARGET"] = new Blob(target);
-
-	if(GLuint index = getBufferIndex(target)) {
-		BufferPtr buff = buffers[index];
-
-		if(buff) {
-			buff->mapAccess = access;
-		}
-	}
-}
-
-void OGLE::glMapBufferPost(GLvoid *retValue) {
-	BlobPtr target = glState["GL_MAPPED_BUFFER_TARGET"];
-
-	if(target) {
-		if(GLuint index = getBufferIndex(target->toEnum())) {
-			BufferPtr buff = buffers[index];
-
-			if(buff) {
-				buff->map = retValue;
-			}
-		}
-	}
-
-	glState["GL_MAPPED_BUFFER_TARGET"] = 0;
-}
-
-void OGLE::glUnmapBuffer(GLenum target) {
-
-	if(GLuint index = getBufferIndex(target)) {
-		BufferPtr buff = buffers[index];
-
-		if(buff) {
-			if(buff->map && buff->mapAccess != 0*GL_WRITE_ONLY) {
-				memcpy(buff->ptr, buff->map, buff->size);
-			}
-			buff->map = 0;
-			buff->mapAccess = 0;
-		}
-	}
-}
-
-
-////////////////////////////////////////////////////////////////////////////////////
-// OGLE utility functions
-////////////////////////////////////////////////////////////////////////////////////
-
-/////////////////////////////////////////////////////////////////////////////////
-// OGLE's Helper Functions
-/////////////////////////////////////////////////////////////////////////////////
-
-
-void OGLE::initFunctions() {
-
-	extensionVBOSupported = false;
-
-	float oglVersion = callBacks->GetGLVersion();
-	if(oglVersion >= 1.5f ||
-		callBacks->IsGLExtensionSupported("GL_ARB_vertex_buffer_object")) {
-		extensionVBOSupported = true;
-
-	    //Attempty to get the core version
-		iglGetBufferSubData = (GLvoid (GLAPIENTRY *) (GLenum, GLint, GLsizei, GLvoid *))callBacks->GetGLFunction("glGetBufferSubData");
-
-		if(iglGetBufferSubData == NULL) {
-		  //Attempt to get the ARB version instead
-		  iglGetBufferSubData = (GLvoid (GLAPIENTRY *) (GLenum, GLint, GLsizei, GLvoid *))callBacks->GetGLFunction("glGetBufferSubDataARB");
-
-		  if(iglGetBufferSubData == NULL) {
-			 //Unable to get the entry point, don't check for VBOs
-			 extensionVBOSupported = false;
-		  }
-		}
-	}
-
-}
-
-
-
-
-void OGLE::addSet(ElementSetPtr set) {
-	
-  if(! set) return;
-
-  if(
-	  (set->mode == GL_TRIANGLES && OGLE::config.polyTypesEnabled["TRIANGLES"]) 
-	  || (set->mode == GL_TRIANGLE_STRIP && OGLE::config.polyTypesEnabled["TRIANGLE_STRIP"]) 
-	  || (set->mode == GL_TRIANGLE_FAN && OGLE::config.polyTypesEnabled["TRIANGLE_FAN"])
-	  || (set->mode == GL_QUADS && OGLE::config.polyTypesEnabled["QUADS"])
-	  || (set->mode == GL_QUAD_STRIP && OGLE::config.polyTypesEnabled["QUAD_STRIP"])
-	  || (set->mode == GL_POLYGON && OGLE::config.polyTypesEnabled["POLYGON"]) 
-	  ) {
-
-	  objFile->addSet(set);
-	  // no need to store the ElementSets
-	  //  sets.push_back(set);
-
-  }
-
-
-}
-
-void OGLE::newSet(GLenum mode)
-{
-	Transform _transform = this->getCurrTransform();
-	Transform _texCoordTransform = this->getCurrTransform(GL_TEXTURE_MATRIX);
-	currSet = new OGLE::ElementSet(mode, _transform, _texCoordTransform);
-}
-
-
-GLint OGLE::derefClientArray(CArray *arr, GLfloat *v, GLint i) {
-	if(!arr) return 0;
-
-	const GLbyte *p = arr->data;
-	p = getBufferedArray(p);
-
-	if(!p) return 0;
-
-	int j;
-	for(j = 0; j < arr->size; j++) {
-		v[j] = derefVertexArray(p, arr->size, arr->type, arr->stride, i, j);
-	}
-	return j;
-}
-
-GLfloat OGLE::derefVertexArray(const GLbyte *array, GLint dim, GLenum type, GLsizei stride, GLint vindex, GLint index) {
-	GLsizei size = glTypeSize(type);
-
-	const GLbyte *p = array + vindex * (stride ? stride : (dim * size) ) + (index * size);
-
-	GLfloat c;
-
-	switch (type) {
-		case GL_SHORT: c = *((GLshort *) p); break;
-		case GL_INT: c = *((GLint *) p); break;
-		case GL_FLOAT: c = *((GLfloat *) p); break;
-		case GL_DOUBLE: c = *((GLdouble *) p); break;
-	}
-		
-	return c;
-}
-
-
-#define GLVoidPDeRef(TYPE, ARRAY, INDEX) (  *((TYPE *)(((char *)ARRAY) + INDEX * sizeof(TYPE)))  )
-
-GLint OGLE::derefIndexArray(GLenum type, const GLvoid *indices, int i) {
-	GLint index = 0;
-
-	switch (type) {
-		case GL_UNSIGNED_BYTE: index = GLVoidPDeRef(GLubyte, indices, i); break;
-		case GL_UNSIGNED_SHORT:  index = GLVoidPDeRef(GLushort, indices, i); break;
-		case GL_UNSIGNED_INT:  index = GLVoidPDeRef(GLuint, indices, i);break;
-    }
-
-	return index; 
-
-}
-
-bool OGLE::isElementLocked(int i) {
-  GLint lock_first;
-  GLsizei lock_count;
-  BlobPtr lfP, lcP;
-
-  lfP =	glState["GL_LOCK_ARRAYS_FIRST"];
-  lock_first = lfP ? lfP->toInt() : -1;
-
-  lcP =	glState["GL_LOCK_ARRAYS_COUNT"];
-  lock_count = lcP ? lcP->toSizeI() : 0;
-
-  return (lock_first > -1 && lock_count > 0) && (i < lock_first || i > lock_first + lock_count);
-}
-
-
-GLuint OGLE::getBufferIndex(GLenum target) {
-	BlobPtr index;
-
-	switch(target) {
-		case GL_ARRAY_BUFFER: 
-			index = glState["GL_ARRAY_BUFFER_INDEX"]; break;
-		case GL_ELEMENT_ARRAY_BUFFER: 
-			index = glState["GL_ELEMENT_ARRAY_BUFFER_INDEX"]; break;
-	}
-
-	return index ? index->toUInt() : 0;
-}
-
-
-const GLbyte *OGLE::getBufferedArray(const GLbyte *array) {
-	GLuint buffIndex = 0;
-	GLuint offset = 0;
-	BufferPtr buff;
-
-
-	if(buffIndex = getBufferIndex(GL_ARRAY_BUFFER)) {
-		BufferPtr buff = buffers[buffIndex];
-		if(buff && buff->ptr) {
-			offset = (GLuint)array;
-			array = ((GLbyte *)buff->ptr) + offset;
-		}
-	}
-	return array;
-}
-
-const GLvoid *OGLE::getBufferedIndices(const GLvoid *indices) {
-
-	const GLbyte *ptr = (GLbyte *)indices;
-
-	if(GLuint buffIndex = getBufferIndex(GL_ELEMENT_ARRAY_BUFFER)) {
-		BufferPtr buff = buffers[buffIndex];
-		if(!buff || buff->ptr == 0) {
-			return 0;
-		}
-		if(buff && buff->ptr) {
-			GLuint offset = (GLuint)ptr;
-			ptr = ((GLbyte *)buff->ptr) + offset;
-		}
-	}
-
-
-	return ptr;
-}
-
-
-// Look to see if the program has set up Vertex or Element buffers
-// Copy them into buffers we will read from.
-
-void OGLE::checkBuffers() {
-	GLenum targets[2] = {GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER};
-
-	if(!(extensionVBOSupported && iglGetBufferSubData)) {
-		return;
-	}
-
-	for(int i = 0; i < 2; i++) {
-		int index = getBufferIndex(targets[i]);
-
-		BufferPtr bp = buffers[index];
-		if(bp) {
-		  iglGetBufferSubData(targets[i], 0, bp->size, bp->ptr);
-		}
-	}
-}
-
-
-GLsizei OGLE::glTypeSize(GLenum type) {
-	GLsizei size;
-	switch (type) {
-		case GL_SHORT: size = sizeof(GLshort); break;
-		case GL_INT: size = sizeof(GLint); break;
-		case GL_FLOAT: size = sizeof(GLfloat); break;
-		case GL_DOUBLE: size = sizeof(GLdouble); break;
-	}	
-	return size;
-}
-
-
-OGLE::VertexPtr OGLE::doTransform(VertexPtr vp, Transform T) {
-	
-	  OGLE::Vector V = vp->toVector();
-
-	  OGLE::Vector R(4);
-
-	  mtl::mult(T,V,R);
-
-	  return new OGLE::Vertex(R);
-}
-	
-OGLE::Transform OGLE::getCurrTransform(GLenum type) {
-		int i, j;
-
-		GLfloat mat[16];
-		GLV->glGetFloatv(type, mat);
-
-		Transform T(4,4);
-		for( i = 0; i < 4; i++) {
-			for( j = 0; j < 4; j++) {
-				T(j,i) = (float) mat[4*i + j];
-			}
-		}
-		return T;
-}
-
-bool OGLE::isIdentityTransform(Transform T) {
-	OGLE::Vector V(4,1);
-	OGLE::Vector R(4);
-
-	mtl::mult(T,V,R);
-
-	float prod = 1.0;
-	for(int t = 0; t < 4; t++) {
-		prod *= R[t];
-	}
-
-	return prod == 1.0;
-}
-
-
-
-
-
-
-
-//////////////////////////////////////////////////////////////////////////////////
-// OGLE::ElementSet functions
-//////////////////////////////////////////////////////////////////////////////////
-
-OGLE::ElementSet::ElementSet(GLenum _mode, Transform _transform, Transform _texCoordTransform) :
-	mode(_mode),
-	transform(_transform),
-	texCoordTransform(_texCoordTransform),
-	hasTransform(1)
-{}
-
-OGLE::ElementSet::ElementSet(GLenum _mode) :
-	mode(_mode),
-	hasTransform(0)
-{}
-
-void OGLE::ElementSet::addElement(const GLfloat V[], GLsizei dim) {
-	addElement(new Vertex(V, dim));
-}
-
-void OGLE::ElementSet::addElement(VertexPtr V) {	
-	addElement(new OGLE::Element(V));
-}
-
-void OGLE::ElementSet::addElement(ElementPtr E) {
-	if(hasTransform) {
-		if(E->v) E->v = OGLE::doTransform(E->v, transform);
-		if(E->n) E->n = OGLE::doTransform(E->n, transform);
-		if(E->t) E->t = OGLE::doTransform(E->t, texCoordTransform);
-	}
-
-
-	float scale = OGLE::config.scale;
-	if(scale) {
-		if(E->v) {
-			E->v->x *= scale;
-			E->v->y *= scale;
-			E->v->z *= scale;
-		}
-
-		if(E->n) {
-			E->n->x *= scale;
-			E->n->y *= scale;
-			E->n->z *= scale;
-		}
-	}
-
-	elements.push_back(E);
-}
-
+#include "stdafx.h"
+
+#include "ogle.h"
+
+#include "ObjFile.h"
+#include "Trace.h"
+
+#include "Ptr/Ptr.in"
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include <limits.h>
+#include <algorithm>
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 34962
+#endif
+
+#ifndef GL_ELEMENT_ARRAY_BUFFER
+#define GL_ELEMENT_ARRAY_BUFFER 34963
+#endif
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER 0x8A11
+#endif
+
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 35000
+#endif
+
+#ifndef GL_WRITE_ONLY
+#define GL_WRITE_ONLY 35001
+#endif
+
+#ifndef GL_TEXTURE0
+#define GL_TEXTURE0  33984
+#endif
+
+#ifndef GL_READ_WRITE
+#define GL_READ_WRITE 35002
+#endif
+
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT 0x0001
+#define GL_MAP_WRITE_BIT 0x0002
+#define GL_MAP_INVALIDATE_RANGE_BIT 0x0004
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#define GL_MAP_FLUSH_EXPLICIT_BIT 0x0010
+#define GL_MAP_UNSYNCHRONIZED_BIT 0x0020
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+#ifndef GL_COPY_READ_BUFFER
+#define GL_COPY_READ_BUFFER 0x8F36
+#define GL_COPY_WRITE_BUFFER 0x8F37
+#endif
+
+#ifndef GL_TRANSFORM_FEEDBACK_BUFFER
+#define GL_TRANSFORM_FEEDBACK_BUFFER 0x8C8E
+#endif
+
+#ifndef GL_TEXTURE_BUFFER
+#define GL_TEXTURE_BUFFER 0x8C2A
+#endif
+
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+
+#ifndef GL_ATOMIC_COUNTER_BUFFER
+#define GL_ATOMIC_COUNTER_BUFFER 0x92C0
+#endif
+
+
+/////////////////////////////////////////////
+// Static OGLE Variables
+/////////////////////////////////////////////
+
+char *OGLE::Config::polyTypes[] = {
+	"TRIANGLES",
+	"TRIANGLE_STRIP",
+	"TRIANGLE_FAN",
+	"QUADS",
+	"QUAD_STRIP",
+	"POLYGON"
+};
+int OGLE::Config::nPolyTypes = 6;
+
+OGLE::Config OGLE::config;
+
+FILE *OGLE::LOG = fopen("ogle.log", "w");
+
+
+/////////////////////////////////////////////
+// OGLE Initialization
+/////////////////////////////////////////////
+
+OGLE::OGLE(InterceptPluginCallbacks *_callBacks, const GLCoreDriver *_GLV) :
+	currSet(0),
+	currNormal(0),
+	currColor(0),
+	currTexCoord(0),
+	activeClientTex(0),
+	callBacks(_callBacks),
+	GLV(_GLV),
+	shared(new ShareGroup()),
+	tArray(0),
+	tArrayActive(0),
+	tArrays(64),
+	vao(new VertexArray()),
+	functionsInit(false),
+	extensionVBOSupported(false),
+	iglGetBufferSubData(0),
+	iglBindBuffer(0),
+	compilingListName(0),
+	listBase(0),
+	lockCacheChecked(0),
+	currProgram(0),
+	pendingUniformProgram(0),
+	pendingUniform(-1),
+	matrixBlockBuffer(0),
+	matrixBlockOffset(0),
+	nDuplicates(0),
+	nCollapsedDraws(0),
+	nCollapsedInstances(0),
+	fileSerial(0)
+{
+	currSet = 0;
+	currNormal = 0;
+	currColor = 0;
+	currTexCoord = 0;
+
+	glClientActiveTexture(GL_TEXTURE0);
+
+	vertexArrays[0] = vao;
+}
+
+void OGLE::startRecording(string _objFileName) {
+	flushCoalesced();
+	endDuplicateFrame();
+	endInstanceFrame();
+	objFileName = _objFileName;
+	objFile = new ObjFile(objFileName);
+}
+
+// The other contexts of the application write to the file the current
+// one opened, so a frame drawn across several still ends up in one.
+
+void OGLE::startRecording(Ptr<ObjFile> file) {
+	flushCoalesced();
+	endDuplicateFrame();
+	endInstanceFrame();
+	objFile = file;
+}
+
+void OGLE::stopRecording() {
+	flushCoalesced();
+	endDuplicateFrame();
+	endInstanceFrame();
+	objFile = 0;
+	objFileName = "";
+}
+
+
+// wglShareLists: from now on this context sees src's buffers, lists
+// and programs.  GL only allows it before the context has made any of
+// its own, so there is nothing here worth keeping.
+
+void OGLE::shareLists(OGLE *src) {
+	shared = src->shared;
+	currProgram = 0;
+}
+
+
+// Feedback capture: GL transforms and clips the frame itself, and hands
+// back window space polygons instead of drawing them.  That costs one
+// copy of the frame's geometry at the end instead of any work per draw.
+
+void OGLE::beginFeedback() {
+	size_t n = OGLE::config.feedbackBufferSize / sizeof(GLfloat);
+	if(feedback.size() < n) {
+		feedback.resize(n);
+	}
+
+	// texture coordinates only come with the colour as well
+	GLenum type = OGLE::config.captureTexCoords ? GL_3D_COLOR_TEXTURE
+		: OGLE::config.captureColors ? GL_3D_COLOR : GL_3D;
+
+	GLV->glFeedbackBuffer(feedback.size(), type, &feedback[0]);
+	GLV->glRenderMode(GL_FEEDBACK);
+}
+
+// False if the frame overflowed the buffer.  The buffer is then doubled,
+// and kept at that size from then on, for the caller to try again.
+
+bool OGLE::endFeedback() {
+	GLint n = GLV->glRenderMode(GL_RENDER);
+
+	if(n < 0) {
+		size_t grown = feedback.size() * 2;
+		if(grown > 0x7fffffff) {
+			fprintf(OGLE::LOG, "OGLE::endFeedback: feedback buffer of %d MB overflowed, giving up\n",
+				(int)(feedback.size() * sizeof(GLfloat) >> 20));
+			return true;
+		}
+
+		fprintf(OGLE::LOG, "OGLE::endFeedback: feedback buffer overflowed, growing to %d MB\n",
+			(int)(grown * sizeof(GLfloat) >> 20));
+		OGLE::config.feedbackBufferSize = grown * sizeof(GLfloat);
+		feedback.clear();
+		return false;
+	}
+
+	if(objFile && n > 0) {
+		// x y z, then r g b a, then s t r q
+		bool tex = OGLE::config.captureTexCoords;
+		bool color = tex || OGLE::config.captureColors;
+
+		objFile->addFeedback(&feedback[0], n, tex ? 11 : color ? 7 : 3,
+			OGLE::config.captureColors ? 3 : -1, tex ? 7 : -1);
+	}
+	return true;
+}
+
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// OGLE's OpenGLFunctions
+/////////////////////////////////////////////////////////////////////////////////
+
+void  OGLE::glVertexfv(GLfloat *V, GLsizei n) {
+
+	if(currSet) {
+		bool attribs = keepAttribs();
+		addCurrElement(new OGLE::Element(new OGLE::Vertex(V, n), 
+								(OGLE::config.captureTexCoords && attribs ? currTexCoord : 0),
+								(OGLE::config.captureNormals && attribs ? currNormal : 0),
+								(OGLE::config.captureColors ? currColor : 0)
+								)
+							);
+	}
+}
+
+// Geometry going into a display list stays untransformed and unscaled;
+// that happens when the list is called.
+
+void OGLE::addCurrElement(ElementPtr E) {
+	if(compilingList || flight) {
+		currSet->addTransformedElement(E);
+	}
+	else {
+		currSet->addElement(E);
+	}
+}
+
+void  OGLE::glNormalfv(GLfloat *V, GLsizei n) {
+	if(OGLE::config.captureNormals) {
+		currNormal = new OGLE::Vertex(V, n);
+		currNormal->w = 0;
+	}
+}
+
+void  OGLE::glTexCoordfv(GLfloat *V, GLsizei n) {
+	if(OGLE::config.captureTexCoords) {
+		currTexCoord = new OGLE::Vertex(V, n);
+		currTexCoord->w = 0;
+	}
+}
+
+// glColor3* leaves alpha at 1, which Vertex's default w already is
+
+void  OGLE::glColorfv(GLfloat *V, GLsizei n) {
+	if(OGLE::config.captureColors) {
+		currColor = new OGLE::Vertex(V, n);
+	}
+}
+
+
+void OGLE::glDrawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, 
+							GLenum type, const GLvoid *indices) {
+	glDrawRangeElementsBaseVertex(mode, start, end, count, type, indices, 0);
+}
+
+void OGLE::glDrawRangeElementsBaseVertex(GLenum mode, GLuint start, GLuint end, GLsizei count, 
+							GLenum type, const GLvoid *indices, GLint basevertex) {
+
+  checkBuffers();
+
+  indices = getBufferedIndices(indices, count, type);
+
+  if(!indices) {
+	  fprintf(OGLE::LOG, "\tOGLE::glDrawRangeElements: indices is null\n");	
+
+	  return;
+  }
+
+  SubDraw d = { count, 0, indices, basevertex, start, end };
+  drawBatch(mode, type, &d, 1);
+}
+
+
+void OGLE::glDrawElements (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
+{
+	glDrawElementsBaseVertex(mode, count, type, indices, 0);
+}
+
+void OGLE::glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLint basevertex)
+{
+    checkBuffers();
+
+	indices = getBufferedIndices(indices, count, type);
+
+	if(!indices) {
+		fprintf(OGLE::LOG, "\tOGLE::glDrawElements: indices is null\n");	
+		return;
+	}
+
+	SubDraw d = { count, 0, indices, basevertex, 0, (GLuint)-1 };
+	drawBatch(mode, type, &d, 1);
+}
+
+
+void  OGLE::glDrawArrays (GLenum mode, GLint first, GLsizei count) {
+
+  checkBuffers();
+
+  SubDraw d = { count, first, 0, 0, 0, (GLuint)-1 };
+  drawBatch(mode, 0, &d, 1);
+}
+
+
+void OGLE::glMultiDrawArrays(GLenum mode, const GLint *first, const GLsizei *count, GLsizei drawcount) {
+	if(!first || !count || drawcount <= 0) return;
+
+	checkBuffers();
+
+	std::vector<SubDraw> draws(drawcount);
+	for(int i = 0; i < drawcount; i++) {
+		SubDraw d = { count[i], first[i], 0, 0, 0, (GLuint)-1 };
+		draws[i] = d;
+	}
+
+	drawBatch(mode, 0, &draws[0], drawcount);
+}
+
+void OGLE::glMultiDrawElements(GLenum mode, const GLsizei *count, GLenum type, const GLvoid *const *indices, GLsizei drawcount) {
+	glMultiDrawElementsBaseVertex(mode, count, type, indices, drawcount, 0);
+}
+
+void OGLE::glMultiDrawElementsBaseVertex(GLenum mode, const GLsizei *count, GLenum type, 
+							const GLvoid *const *indices, GLsizei drawcount, const GLint *basevertex) {
+	if(!count || !indices || drawcount <= 0) return;
+
+	checkBuffers();
+
+	std::vector<SubDraw> draws;
+	draws.reserve(drawcount);
+
+	for(int i = 0; i < drawcount; i++) {
+		SubDraw d = { count[i], 0, getBufferedIndices(indices[i], count[i], type), basevertex ? basevertex[i] : 0, 0, (GLuint)-1 };
+		if(d.indices) {
+			draws.push_back(d);
+		}
+	}
+
+	if(draws.size() < drawcount) {
+		fprintf(OGLE::LOG, "\tOGLE::glMultiDrawElements: %d of %d draws have null indices\n", 
+			drawcount - (int)draws.size(), drawcount);	
+	}
+
+	if(!draws.empty()) {
+		drawBatch(mode, type, &draws[0], draws.size());
+	}
+}
+
+
+// The indirect draws read their parameters from the buffer bound to
+// GL_DRAW_INDIRECT_BUFFER, which is shadowed like any other.  With no
+// instance transform a command with any instances is captured once,
+// and counted as collapsed if it had more than one.
+
+void OGLE::glDrawArraysIndirect(GLenum mode, const GLvoid *indirect) {
+	glMultiDrawArraysIndirect(mode, indirect, 1, 0);
+}
+
+void OGLE::glDrawElementsIndirect(GLenum mode, GLenum type, const GLvoid *indirect) {
+	glMultiDrawElementsIndirect(mode, type, indirect, 1, 0);
+}
+
+void OGLE::glMultiDrawArraysIndirect(GLenum mode, const GLvoid *indirect, GLsizei drawcount, GLsizei stride) {
+	// count, instanceCount, first, baseInstance
+	const GLsizei cmdSize = 4 * sizeof(GLuint);
+	if(drawcount <= 0) return;
+	if(!stride) stride = cmdSize;
+
+	checkBuffers();
+
+	const GLbyte *cmds = getIndirect(indirect, (GLsizeiptr)(drawcount - 1) * stride + cmdSize);
+	if(!cmds) {
+		fprintf(OGLE::LOG, "\tOGLE::glMultiDrawArraysIndirect: no indirect data\n");	
+		return;
+	}
+
+	std::vector<SubDraw> draws;
+	draws.reserve(drawcount);
+
+	bool instanced = hasInstanceTransform();
+
+	for(int i = 0; i < drawcount; i++) {
+		const GLuint *cmd = (const GLuint *)(cmds + i * stride);
+		if(!cmd[1]) continue;
+
+		SubDraw d = { (GLsizei)cmd[0], (GLint)cmd[2], 0, 0, 0, (GLuint)-1 };
+
+		if(instanced) {
+			drawInstanced(mode, 0, d, cmd[1], cmd[3]);
+		}
+		else {
+			collapsedInstances(cmd[1]);
+			draws.push_back(d);
+		}
+	}
+
+	if(!draws.empty()) {
+		drawBatch(mode, 0, &draws[0], draws.size());
+	}
+}
+
+void OGLE::glMultiDrawElementsIndirect(GLenum mode, GLenum type, const GLvoid *indirect, GLsizei drawcount, GLsizei stride) {
+	// count, instanceCount, firstIndex, baseVertex, baseInstance
+	const GLsizei cmdSize = 5 * sizeof(GLuint);
+	if(drawcount <= 0) return;
+	if(!stride) stride = cmdSize;
+
+	// the indices always come from the element array buffer
+	if(!getBufferIndex(GL_ELEMENT_ARRAY_BUFFER)) return;
+
+	checkBuffers();
+
+	const GLbyte *cmds = getIndirect(indirect, (GLsizeiptr)(drawcount - 1) * stride + cmdSize);
+	if(!cmds) {
+		fprintf(OGLE::LOG, "\tOGLE::glMultiDrawElementsIndirect: no indirect data\n");	
+		return;
+	}
+
+	std::vector<SubDraw> draws;
+	draws.reserve(drawcount);
+
+	bool instanced = hasInstanceTransform();
+
+	for(int i = 0; i < drawcount; i++) {
+		const GLuint *cmd = (const GLuint *)(cmds + i * stride);
+		if(!cmd[1]) continue;
+
+		const GLvoid *offset = (const GLvoid *)((size_t)cmd[2] * indexTypeSize(type));
+		SubDraw d = { (GLsizei)cmd[0], 0, getBufferedIndices(offset, (GLsizei)cmd[0], type), (GLint)cmd[3], 0, (GLuint)-1 };
+		if(!d.indices) continue;
+
+		if(instanced) {
+			drawInstanced(mode, type, d, cmd[1], cmd[4]);
+		}
+		else {
+			collapsedInstances(cmd[1]);
+			draws.push_back(d);
+		}
+	}
+
+	if(!draws.empty()) {
+		drawBatch(mode, type, &draws[0], draws.size());
+	}
+}
+
+
+// Capture a batch of draws that share the current vertex format and
+// transforms.  type is the index type of element draws, 0 for arrays.
+
+void OGLE::drawBatch(GLenum mode, GLenum type, const SubDraw *draws, GLsizei n) {
+	TRACE_ZONE("draw");
+	// draws the governor sheds are never fetched
+	std::vector<SubDraw> kept;
+	if(governor && governor->level() >= Governor::SAMPLED && !compilingList) {
+		for(int i = 0; i < n; i++) {
+			if(sampleDraw()) kept.push_back(draws[i]);
+		}
+		if(kept.empty()) return;
+
+		draws = &kept[0];
+		n = kept.size();
+	}
+
+	FetchPlan plan;
+	resolveFetchPlan(plan);
+
+	if(!plan.v.data) {
+		if(vArray.enabled) {
+			fprintf(OGLE::LOG, "O::dB Unable to DeRef Vertex Array\n");
+		}
+		return;
+	}
+
+	// a draw that repeats one from earlier in the frame exactly, like a
+	// depth prepass drawn again in the main pass, is captured once
+	std::vector<SubDraw> unique;
+	std::string sig;
+	const GLbyte *indexBase = 0;
+	if(OGLE::config.skipDuplicateDraws && objFile && !flight && !compilingList
+			&& batchSignature(sig, mode, type, plan, indexBase)) {
+		size_t batchSize = sig.size();
+
+		for(int i = 0; i < n; i++) {
+			const SubDraw &d = draws[i];
+			sig.resize(batchSize);
+			if(type) {
+				size_t offset = (const GLbyte *)d.indices - indexBase;
+				sig.append((const char *)&offset, sizeof(offset));
+				sig.append((const char *)&d.baseVertex, sizeof(d.baseVertex));
+				sig.append((const char *)&d.start, sizeof(d.start));
+				sig.append((const char *)&d.end, sizeof(d.end));
+			}
+			else {
+				sig.append((const char *)&d.first, sizeof(d.first));
+			}
+			sig.append((const char *)&d.count, sizeof(d.count));
+
+			if(drawSignatures.insert(sig).second) {
+				unique.push_back(d);
+			}
+			else {
+				nDuplicates++;
+			}
+		}
+		if(unique.empty()) return;
+
+		draws = &unique[0];
+		n = unique.size();
+	}
+
+	if(!compilingList) {
+		skinDraws(plan, type, draws, n);
+	}
+	convertColors(plan, type, draws, n);
+
+	newSet(mode);
+	ElementSetPtr firstSet = currSet;
+
+	for(int i = 0; i < n; i++) {
+		if(i > 0) {
+			currSet = (compilingList || flight) ? new ElementSet(mode)
+				: new ElementSet(mode, firstSet->transform, firstSet->texCoordTransform, firstSet->deferred);
+			currSet->coalesce = firstSet->coalesce;
+		}
+
+		fetchDraw(plan, type, draws[i], false);
+
+		addSet(currSet);
+	}
+
+	currSet = 0;
+}
+
+// Add the elements of one draw to currSet.  raw elements skip the set's
+// transform and scale, for geometry that is placed later.
+
+void OGLE::fetchDraw(const FetchPlan &plan, GLenum type, const SubDraw &d, bool raw) {
+	TRACE_ZONE("index decode and fetch");
+	// locked draws go element by element through the lock cache
+	bool locked = lockCache && !raw;
+
+	for(GLsizei k = 0; k < d.count; k++) {
+		GLint index;
+
+		if(type) {
+			index = derefIndexArray(type, d.indices, k);
+			if(index < d.start || index > d.end) continue;
+			index += d.baseVertex;
+		}
+		else {
+			index = d.first + k;
+		}
+
+		if(locked) {
+			glArrayElement(index);
+			continue;
+		}
+
+		ElementPtr E = fetchElement(plan, index);
+		if(!E) continue;
+
+		if(raw) {
+			currSet->addTransformedElement(E);
+		}
+		else {
+			addCurrElement(E);
+		}
+	}
+}
+
+
+// Instanced draws are fetched once, untransformed, and then placed
+// once per instance with the modelview times the instance's transform
+// from the InstanceTransformAttrib stream.  Nothing says which of a
+// shader's attributes places the instances, so without that stream the
+// instances can only be taken to be the same and the mesh is captured
+// once; how many were collapsed that way is logged with the frame.
+
+void OGLE::glDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount) {
+	if(instancecount <= 0) return;
+
+	checkBuffers();
+
+	SubDraw d = { count, first, 0, 0, 0, (GLuint)-1 };
+	drawInstanced(mode, 0, d, instancecount, 0);
+}
+
+void OGLE::glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei instancecount) {
+	if(instancecount <= 0) return;
+
+	checkBuffers();
+
+	indices = getBufferedIndices(indices, count, type);
+
+	if(!indices) {
+		fprintf(OGLE::LOG, "\tOGLE::glDrawElementsInstanced: indices is null\n");	
+		return;
+	}
+
+	SubDraw d = { count, 0, indices, 0, 0, (GLuint)-1 };
+	drawInstanced(mode, type, d, instancecount, 0);
+}
+
+bool OGLE::hasInstanceTransform() {
+	int loc = OGLE::config.instanceTransformAttrib;
+	if(loc < 0 || loc >= vao->attribs.size()) return false;
+
+	CArray *a = vao->attribs[loc].rawPtr();
+	return a && a->enabled && a->divisor;
+}
+
+void OGLE::drawInstanced(GLenum mode, GLenum type, const SubDraw &d, GLsizei instances, GLuint baseInstance) {
+	TRACE_ZONE("instanced draw");
+	if(!hasInstanceTransform() || compilingList) {
+		collapsedInstances(instances);
+		drawBatch(mode, type, &d, 1);
+		return;
+	}
+
+	// the instance transform is either a mat4 in four consecutive
+	// locations, one column each, or a translation in just the one
+	std::vector<CArrayPtr> &attribs = vao->attribs;
+	int loc = OGLE::config.instanceTransformAttrib;
+	FetchPlan::Stream cols[4];
+	int nCols = 0;
+
+	for(int c = 0; c < 4 && loc + c < attribs.size(); c++) {
+		CArray *a = attribs[loc + c].rawPtr();
+		if(!a || !a->enabled || a->divisor != attribs[loc]->divisor) {
+			break;
+		}
+		if(a->buffer) {
+			currentBuffer(GL_ARRAY_BUFFER, a->buffer);
+		}
+		if(!resolveStream(cols[c], a, a->buffer)) {
+			break;
+		}
+		nCols++;
+	}
+
+	if(!nCols) {
+		collapsedInstances(instances);
+		drawBatch(mode, type, &d, 1);
+		return;
+	}
+
+	if(!sampleDraw()) {
+		return;
+	}
+
+	FetchPlan plan;
+	resolveFetchPlan(plan);
+
+	if(!plan.v.data) {
+		return;
+	}
+
+	skinDraws(plan, type, &d, 1);
+	convertColors(plan, type, &d, 1);
+
+	// the mesh, in object space
+	currSet = new ElementSet(mode);
+	fetchDraw(plan, type, d, true);
+
+	DisplayListPtr mesh = new DisplayList(GL_COMPILE);
+	mesh->addSet(*currSet.rawPtr());
+	mesh->compact();
+	currSet = 0;
+
+	GLfloat MV[16], TM[16];
+	getCurrMatrix(GL_MODELVIEW_MATRIX, MV);
+	getCurrMatrix(GL_TEXTURE_MATRIX, TM);
+
+	GLuint divisor = attribs[loc]->divisor;
+
+	for(GLsizei i = 0; i < instances; i++) {
+		GLint element = baseInstance + i / divisor;
+		GLfloat I[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+
+		if(nCols == 1) {
+			GLfloat V[4] = { 0, 0, 0, 1 };
+			if(!cols[0].read(element, V)) break;
+			I[12] = V[0]; I[13] = V[1]; I[14] = V[2];
+		}
+		else {
+			bool ok = true;
+			for(int c = 0; c < nCols; c++) {
+				ok = ok && cols[c].read(element, &I[4*c]);
+			}
+			if(!ok) break;
+		}
+
+		GLfloat M[16];
+		multMatrix(MV, I, M);
+		emitGeometry(*mesh.rawPtr(), M, TM);
+	}
+}
+
+void OGLE::glBegin(GLenum mode) {
+    checkBuffers();
+
+	// a shed glBegin/glEnd leaves no set for its vertices to go into
+	if(!sampleDraw()) {
+		currSet = 0;
+		return;
+	}
+
+	newSet(mode);
+}
+
+void OGLE::glEnd() {
+  addSet(currSet);
+  currSet = 0;
+}
+
+
+void OGLE::glArrayElement(GLint i) {
+
+	if(isElementLocked(i)) {
+	  return;
+	}
+
+	if(currSet && currSet->hasTransform && !currSet->deferred && lockCache && lockCache->covers(i)) {
+		// once per draw, make sure the cache holds this draw's transforms
+		if(!lockCacheChecked) {
+			buildLockCache();
+			lockCacheChecked = 1;
+		}
+
+		ElementPtr E = lockCache->elements[i - lockCache->first];
+		if(E) {
+			currSet->addTransformedElement(E);
+			lockCache->nHits++;
+		}
+		return;
+	}
+
+	ElementPtr E = fetchElement(i);
+	if(E && currSet) {
+		addCurrElement(E);
+	}
+}
+
+// Read element i out of the enabled client arrays.  The normal and
+// texture coordinate also become the current ones, as in GL.
+
+OGLE::ElementPtr OGLE::fetchElement(GLint i) {
+	FetchPlan plan;
+	resolveFetchPlan(plan);
+
+	if(!plan.v.data) {
+		if(vArray.enabled) {
+			fprintf(OGLE::LOG, "O::gAE Unable to DeRef Vertex Array\n");
+		}
+		return 0;
+	}
+
+	return fetchElement(plan, i);
+}
+
+// Colour arrays are nearly always four unsigned bytes.  Rather than
+// convert those a vertex at a time in Stream::read, the range the
+// draws use is converted in one go with SSE2, and the plan pointed at
+// the floats.  The division is the same one read() does, so the
+// results are too.
+
+bool OGLE::convertColors(FetchPlan &plan, GLenum type, const SubDraw *draws, GLsizei n) {
+	TRACE_ZONE("convert colors");
+	FetchPlan::Stream &c = plan.c;
+	if(!c.data || c.type != GL_UNSIGNED_BYTE || c.size != 4 || !c.normalized) {
+		return false;
+	}
+
+	GLint lo, hi;
+	if(!drawRange(type, draws, n, lo, hi)) {
+		return false;
+	}
+
+	const GLbyte *src = c.data + (size_t)lo * c.stride;
+	if(c.end && c.data + (size_t)hi * c.stride + 4 > c.end) {
+		// leave the short stream to read(), which drops what is missing
+		return false;
+	}
+
+	size_t nVerts = hi - lo + 1;
+	colors.resize(4 * nVerts);
+	GLfloat *out = &colors[0];
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 div = _mm_set1_ps(255.0f);
+	size_t k = 0;
+
+	if(c.stride == 4) {
+		// packed: four colours per load
+		for(; k + 4 <= nVerts; k += 4) {
+			__m128i b = _mm_loadu_si128((const __m128i *)(src + 4*k));
+			__m128i lo16 = _mm_unpacklo_epi8(b, zero);
+			__m128i hi16 = _mm_unpackhi_epi8(b, zero);
+
+			_mm_storeu_ps(out + 4*k, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo16, zero)), div));
+			_mm_storeu_ps(out + 4*k + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo16, zero)), div));
+			_mm_storeu_ps(out + 4*k + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi16, zero)), div));
+			_mm_storeu_ps(out + 4*k + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi16, zero)), div));
+		}
+	}
+
+	for(; k < nVerts; k++) {
+		GLint rgba;
+		memcpy(&rgba, src + k * c.stride, sizeof(rgba));
+
+		__m128i b = _mm_unpacklo_epi8(_mm_cvtsi32_si128(rgba), zero);
+		_mm_storeu_ps(out + 4*k, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(b, zero)), div));
+	}
+
+	c.type = GL_FLOAT;
+	c.stride = 4 * sizeof(GLfloat);
+	c.bytes = 4 * sizeof(GLfloat);
+	c.normalized = false;
+	c.data = (const GLbyte *)out - (size_t)lo * c.stride;
+	c.end = (const GLbyte *)(out + colors.size());
+	return true;
+}
+
+OGLE::ElementPtr OGLE::fetchElement(const FetchPlan &plan, GLint i) {
+	GLfloat V[4];
+
+	if(plan.n.data && plan.n.read(i, V)) {
+		glNormalfv(V, plan.n.size);
+	}
+
+	if(plan.t.data && plan.t.read(i, V)) {
+		glTexCoordfv(V, plan.t.size);
+	}
+
+	if(plan.c.data && plan.c.read(i, V)) {
+		glColorfv(V, plan.c.size);
+	}
+
+	if(!plan.v.read(i, V)) {
+		return 0;
+	}
+
+	bool attribs = keepAttribs();
+	return new OGLE::Element(new OGLE::Vertex(V, plan.v.size), 
+							(OGLE::config.captureTexCoords && attribs ? currTexCoord : 0),
+							(OGLE::config.captureNormals && attribs ? currNormal : 0),
+							(OGLE::config.captureColors ? currColor : 0)
+							);
+}
+
+
+void OGLE::glEnableClientState (GLenum array)
+{
+  // the cached elements carry the attributes of the arrays that were on
+  invalidateLockCache();
+
+  switch(array) {
+	  case GL_VERTEX_ARRAY: vArray.enabled = true; break;
+	  case GL_NORMAL_ARRAY: nArray.enabled = true; break;
+	  case GL_COLOR_ARRAY: cArray.enabled = true; break;
+	  case GL_TEXTURE_COORD_ARRAY: 
+		  if(tArrayActive) tArrayActive->enabled = true; 		  
+		  break;
+  }
+}
+
+void OGLE::glDisableClientState (GLenum array)
+{
+  invalidateLockCache();
+
+  switch(array) {
+	  case GL_VERTEX_ARRAY:
+		  vArray.enabled = false;
+		  nArray.enabled = false;
+		  cArray.enabled = false;
+		  if(tArray) tArray->enabled = false;
+		  break;
+	  case GL_NORMAL_ARRAY: 
+		  nArray.enabled = true;
+		  break;
+	  case GL_COLOR_ARRAY: 
+		  cArray.enabled = false;
+		  break;
+	  case GL_TEXTURE_COORD_ARRAY: 
+		  if(tArrayActive) tArrayActive->enabled = false; break;
+		  break;
+  }
+}
+
+
+void OGLE::glClientActiveTexture(GLenum texture) {
+	invalidateLockCache();
+	activeClientTex = texture;
+
+	GLint ti = texture - GL_TEXTURE0;
+	CArrayPtr ta = tArrays[ti];
+	if(!ta) {
+		ta = new CArray();
+		tArrays[ti] = ta;
+	}
+	tArrayActive = ta;
+}
+
+void  OGLE::glLockArraysEXT(GLint first, GLsizei count) {	
+  glState["GL_LOCK_ARRAYS_FIRST"] = new OGLE::Blob(first);  
+  glState["GL_LOCK_ARRAYS_COUNT"] = new OGLE::Blob(count);  
+
+  // filled in by the first draw that reads from the range
+  lockCache = (first >= 0 && count > 0) ? new LockCache(first, count) : 0;
+  lockCacheChecked = 0;
+}
+
+void  OGLE::glUnlockArraysEXT() {
+  glState["GL_LOCK_ARRAYS_FIRST"] = 0;
+  glState["GL_LOCK_ARRAYS_COUNT"] = 0;
+
+  if(lockCache && OGLE::config.logFunctions) {
+	  fprintf(OGLE::LOG, "\tOGLE::glUnlockArraysEXT: %d elements, built %d times, %d cached reads\n",
+		  lockCache->count, lockCache->nBuilt, lockCache->nHits);
+  }
+  lockCache = 0;
+}
+
+void OGLE::glVertexPointer (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
+{
+  invalidateLockCache();
+
+  vArray.size = size;
+  vArray.type = type;
+  vArray.stride = stride;
+  vArray.data = (const GLbyte *)pointer;
+
+  this->glEnableClientState(GL_VERTEX_ARRAY);
+}
+
+void OGLE::glNormalPointer (GLenum type, GLsizei stride, const GLvoid *pointer)
+{	
+  invalidateLockCache();
+
+  nArray.size = 3;
+  nArray.type = type;
+  nArray.stride = stride;
+  nArray.data = (const GLbyte *)pointer;
+  // integer normals are scaled to [-1,1]
+  nArray.normalized = true;
+
+  this->glEnableClientState(GL_NORMAL_ARRAY);
+}
+
+void OGLE::glColorPointer (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
+{	
+  invalidateLockCache();
+
+  cArray.size = size;
+  cArray.type = type;
+  cArray.stride = stride;
+  cArray.data = (const GLbyte *)pointer;
+  // integer colours are scaled to [0,1]
+  cArray.normalized = true;
+}
+
+void OGLE::glTexCoordPointer (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
+{	
+	invalidateLockCache();
+	
+	if(tArrayActive) {
+	  tArrayActive->size = 3;
+	  tArrayActive->type = type;
+	  tArrayActive->stride = stride;
+	  tArrayActive->data = (const GLbyte *)pointer;
+
+	  tArray = tArrayActive;
+	}
+
+    this->glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+}
+
+
+// The attribute at index in the bound vertex array object, for changing:
+// the object's fetch plan has to be worked out again.
+
+OGLE::CArray *OGLE::getAttrib(GLuint index) {
+	std::vector<CArrayPtr> &attribs = vao->attribs;
+
+	if(index >= attribs.size()) {
+		attribs.resize(index + 1);
+	}
+
+	CArrayPtr a = attribs[index];
+	if(!a) {
+		a = new CArray();
+		attribs[index] = a;
+	}
+
+	vao->planValid = 0;
+	return a.rawPtr();
+}
+
+// Generic attributes take their buffer from the binding at the time
+// the pointer is set, not at the draw.
+
+void OGLE::glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer) {
+	CArray *a = getAttrib(index);
+
+	a->size = size;
+	a->type = type;
+	a->stride = stride;
+	a->data = (const GLbyte *)pointer;
+	a->normalized = normalized;
+	a->buffer = getBufferIndex(GL_ARRAY_BUFFER);
+}
+
+void OGLE::glEnableVertexAttribArray(GLuint index) {
+	getAttrib(index)->enabled = true;
+}
+
+void OGLE::glDisableVertexAttribArray(GLuint index) {
+	getAttrib(index)->enabled = false;
+}
+
+void OGLE::glVertexAttribDivisor(GLuint index, GLuint divisor) {
+	getAttrib(index)->divisor = divisor;
+}
+
+// Switching vertex array objects also switches the element array
+// buffer binding, which is part of the object.
+
+void OGLE::glBindVertexArray(GLuint array) {
+	VertexArrayPtr va = vertexArrays[array];
+	if(!va) {
+		va = new VertexArray();
+		vertexArrays[array] = va;
+	}
+
+	vao = va;
+	glState["GL_ELEMENT_ARRAY_BUFFER_INDEX"] = new Blob(vao->elementBuffer);
+}
+
+void OGLE::glDeleteVertexArrays(GLsizei n, const GLuint *arrays) {
+	if(!arrays) return;
+
+	for(int i = 0; i < n; i++) {
+		if(!arrays[i]) continue;
+
+		std::unordered_map<GLuint, VertexArrayPtr>::iterator va = vertexArrays.find(arrays[i]);
+		if(va == vertexArrays.end()) continue;
+
+		// deleting the bound object reverts to the default one
+		if(va->second == vao) {
+			glBindVertexArray(0);
+		}
+		vertexArrays.erase(va);
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// GLSL program uniforms
+/////////////////////////////////////////////////////////////////////////////////
+
+// With a program in use the fixed function modelview means nothing;
+// the transform is in whichever uniforms the config names.  Their
+// values are kept as the application sets them, since reading them
+// back with glGetUniformfv at every draw would stall.
+
+OGLE::Program *OGLE::getProgram(GLuint program) {
+	ProgramPtr &prog = shared->programs[program];
+	if(!prog) {
+		prog = new Program();
+	}
+	return prog.rawPtr();
+}
+
+void OGLE::glUseProgram(GLuint program) {
+	currProgram = program ? getProgram(program) : 0;
+}
+
+void OGLE::glLinkProgram(GLuint program) {
+	std::unordered_map<GLuint, ProgramPtr>::iterator prog = shared->programs.find(program);
+	if(prog != shared->programs.end()) {
+		prog->second->reset();
+	}
+}
+
+void OGLE::glDeleteProgram(GLuint program) {
+	// a program in use lives on until it is replaced
+	shared->programs.erase(program);
+}
+
+// The location is only known once the call returns, so remember which
+// of the configured uniforms was asked for until the post hook.
+
+void OGLE::glGetUniformLocation(GLuint program, const char *name) {
+	pendingUniform = -1;
+	if(!name) return;
+
+	if(!OGLE::config.bonePaletteUniform.empty() && OGLE::config.bonePaletteUniform == name) {
+		pendingUniform = Program::N_MATRICES;
+		pendingUniformProgram = program;
+		return;
+	}
+
+	for(int k = 0; k < Program::N_MATRICES; k++) {
+		if(!OGLE::config.matrixUniforms[k].empty() && OGLE::config.matrixUniforms[k] == name) {
+			pendingUniform = k;
+			pendingUniformProgram = program;
+			return;
+		}
+	}
+}
+
+void OGLE::glGetUniformLocationPost(GLint location) {
+	if(pendingUniform == Program::N_MATRICES && location >= 0) {
+		getProgram(pendingUniformProgram)->paletteLocation = location;
+	}
+	else if(pendingUniform >= 0 && location >= 0) {
+		getProgram(pendingUniformProgram)->locations[pendingUniform] = location;
+	}
+	pendingUniform = -1;
+}
+
+void OGLE::glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
+	if(currProgram) {
+		glProgramUniformMatrix4fv(0, location, count, transpose, value);
+	}
+}
+
+// program 0 means the one in use
+
+void OGLE::glProgramUniformMatrix4fv(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
+	if(!value || location < 0) return;
+
+	Program *prog = program ? getProgram(program) : currProgram.rawPtr();
+	if(!prog) return;
+
+	for(int k = 0; k < Program::N_MATRICES; k++) {
+		// the uniform may be one element of an array set all at once
+		GLint i = prog->locations[k] - location;
+		if(prog->locations[k] < 0 || i < 0 || i >= count) continue;
+
+		copyMatrices(prog->matrices[k], value + 16 * i, 1, transpose);
+		prog->set[k] = 1;
+	}
+
+	// Array elements have consecutive locations.  The palette's length
+	// is never declared, so it grows as far as it is written from its
+	// start without a gap.
+	GLint first = location - prog->paletteLocation;
+	if(prog->paletteLocation >= 0 && first >= 0 && 16 * first <= prog->palette.size()) {
+		size_t need = 16 * (size_t)(first + count);
+		if(prog->palette.size() < need) {
+			prog->palette.resize(need);
+		}
+		copyMatrices(&prog->palette[16 * first], value, count, transpose);
+	}
+}
+
+void OGLE::copyMatrices(GLfloat *out, const GLfloat *value, GLsizei count, bool transpose) {
+	if(!transpose) {
+		memcpy(out, value, 16 * count * sizeof(GLfloat));
+		return;
+	}
+
+	for(int i = 0; i < count; i++, out += 16, value += 16) {
+		for(int r = 0; r < 4; r++) {
+			for(int c = 0; c < 4; c++) {
+				out[4*c + r] = value[4*r + c];
+			}
+		}
+	}
+}
+
+// Uniform blocks: only the binding point the config names matters.
+// Its matrices are read from the buffer's shadow, which follows
+// glBufferSubData and mapped writes like any other buffer.
+
+void OGLE::glBindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+	glBindBufferRange(target, index, buffer, 0, -1);
+}
+
+void OGLE::glBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+	// the generic binding point changes too
+	glBindBuffer(target, buffer);
+
+	switch(target) {
+		case GL_TRANSFORM_FEEDBACK_BUFFER:
+		case GL_SHADER_STORAGE_BUFFER:
+		case GL_ATOMIC_COUNTER_BUFFER:
+			gpuWrites(buffer);
+			return;
+		case GL_UNIFORM_BUFFER:
+			break;
+		default:
+			return;
+	}
+
+	if(index == OGLE::config.matrixBlockBinding) {
+		matrixBlockBuffer = buffer;
+		matrixBlockOffset = offset;
+	}
+}
+
+// The world transform of a shader draw: the model matrix, or failing
+// that the modelview with the view taken back out of it.  False when
+// fixed function is in use or no configured matrix has been seen.
+
+bool OGLE::getShaderModelView(GLfloat *M) {
+	if(!currProgram) return false;
+
+	const GLfloat *m[Program::N_MATRICES];
+	Buffer *block = matrixBlockBuffer ? currentBuffer(GL_UNIFORM_BUFFER, matrixBlockBuffer) : 0;
+
+	for(int k = 0; k < Program::N_MATRICES; k++) {
+		GLintptr at = matrixBlockOffset + OGLE::config.matrixBlockOffsets[k];
+
+		if(currProgram->set[k]) {
+			m[k] = currProgram->matrices[k];
+		}
+		else if(block && OGLE::config.matrixBlockOffsets[k] >= 0
+				&& at + 16 * sizeof(GLfloat) <= (size_t)block->size) {
+			m[k] = (const GLfloat *)((const GLbyte *)block->ptr + at);
+		}
+		else {
+			m[k] = 0;
+		}
+	}
+
+	if(m[Program::MODEL]) {
+		memcpy(M, m[Program::MODEL], 16 * sizeof(GLfloat));
+		return true;
+	}
+
+	if(m[Program::MODELVIEW]) {
+		GLfloat V[16];
+		if(m[Program::VIEW] && invertMatrix(m[Program::VIEW], V)) {
+			multMatrix(V, m[Program::MODELVIEW], M);
+		}
+		else {
+			memcpy(M, m[Program::MODELVIEW], 16 * sizeof(GLfloat));
+		}
+		return true;
+	}
+
+	return false;
+}
+
+
+void OGLE::glInterleavedArrays(GLenum format, GLsizei stride, const GLvoid *pointer) {
+
+	int str;
+
+	int f = sizeof(GL_FLOAT),
+		c = 4 * sizeof(GLubyte);
+
+	bool et = 0, ec = 0, en = 0;
+	GLenum tc;
+	int st = 0, sc = 0, sv = 0, pc = 0, pn = 0, pv = 0, s = 0;
+
+	switch(format) {
+
+		case GL_V2F:
+			sv = 2; s = 2*f;
+			break;
+
+		case GL_V3F:
+			sv = 3; s = 3*f;
+			break;
+
+		case GL_C4UB_V2F:
+			ec = 1; sc = 4; sv = 2; tc = GL_UNSIGNED_BYTE; pv = c; s = c+2*f;
+			break;
+
+		case GL_C4UB_V3F:
+			ec = 1; sc = 4; sv = 3; tc = GL_UNSIGNED_BYTE; pv = c; s = c+3*f;
+			break;
+
+		case GL_C3F_V3F:
+			ec = 1; sc = 3; sv = 3; tc = GL_FLOAT; pv = 3*f; s = 6*f;
+			break;
+
+		case GL_N3F_V3F:
+			en = 1; sv = 3; pv = 3*f; s = 6*f;
+			break;
+
+		case GL_C4F_N3F_V3F:
+			ec = 1; en = 1; sc = 4; sv = 3; tc = GL_FLOAT; pn = 4*f; pv = 7*f; s = 10*f;
+			break;
+
+		case GL_T2F_V3F:
+			et = 1; st = 2; sv = 3;pv = 2*f; s = 5*f;
+			break;
+
+		case GL_T4F_V4F:
+			et = 1; st = 4; sv = 4; pv = 4*f; s = 8*f;
+			break;
+
+		case GL_T2F_C4UB_V3F:
+			et = 1; ec = 1; st = 2; sc = 4; sv = 3; tc = GL_UNSIGNED_BYTE; pc = 2*f; pv = c+2*f; s = c+5*f;
+			break;
+
+		case GL_T2F_C3F_V3F:
+			et = 1; ec = 1; st = 2; sc = 3; sv = 3; tc = GL_FLOAT; pc = 2*f; pv = 5*f; s = 8*f;
+			break;
+
+		case GL_T2F_N3F_V3F:
+			et = 1; en = 1; st = 2; sv = 3; pn = 2*f; pv = 5*f; s = 8*f;
+			break;
+	
+		case GL_T2F_C4F_N3F_V3F:
+			et = 1; ec = 1; en = 1; st = 2; sc = 4; sv = 3; tc = GL_FLOAT; pc = 2*f; pn = 6*f; pv = 9*f; s = 12*f;
+			break;
+	
+		case GL_T4F_C4F_N3F_V4F:
+			et = 1; ec = 1; en = 1; st = 4; sc = 4; sv = 4; tc = GL_FLOAT; pc = 4*f; pn = 8*f; pv = 11*f; s = 15*f;
+			break;
+
+	
+		default:
+			return;
+
+
+	}
+
+
+	str = stride;
+
+	if (str == 0) {
+		str = s;
+	}
+
+	this->glDisableClientState(GL_EDGE_FLAG_ARRAY);
+	this->glDisableClientState(GL_INDEX_ARRAY);
+
+	if (et) {
+		this->glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		this->glTexCoordPointer(st, GL_FLOAT, str, pointer);
+	}
+	else
+		this->glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+
+	if (ec) {
+		this->glEnableClientState(GL_COLOR_ARRAY);
+		this->glColorPointer(sc, tc, str, ((GLbyte *)pointer) + pc);
+	}
+	else
+		this->glDisableClientState(GL_COLOR_ARRAY);
+
+	if (en) {
+		this->glEnableClientState(GL_NORMAL_ARRAY);
+		this->glNormalPointer(GL_FLOAT, str, ((GLbyte *)pointer) + pn);
+	}
+	else
+		this->glDisableClientState(GL_NORMAL_ARRAY);
+
+	this->glEnableClientState(GL_VERTEX_ARRAY);
+	this->glVertexPointer(sv, GL_FLOAT, str, ((GLbyte *)pointer)+pv);
+}
+
+
+
+// The targets followed only so copies and GPU writes can be pinned on
+// the right buffer.
+
+static const struct {
+	GLenum target;
+	const char *state;
+} copyTargets[] = {
+	{ GL_COPY_READ_BUFFER, "GL_COPY_READ_BUFFER_INDEX" },
+	{ GL_COPY_WRITE_BUFFER, "GL_COPY_WRITE_BUFFER_INDEX" },
+	{ GL_TRANSFORM_FEEDBACK_BUFFER, "GL_TRANSFORM_FEEDBACK_BUFFER_INDEX" },
+	{ GL_SHADER_STORAGE_BUFFER, "GL_SHADER_STORAGE_BUFFER_INDEX" },
+	{ GL_ATOMIC_COUNTER_BUFFER, "GL_ATOMIC_COUNTER_BUFFER_INDEX" },
+	{ GL_TEXTURE_BUFFER, "GL_TEXTURE_BUFFER_INDEX" },
+};
+
+static const char *copyTargetState(GLenum target) {
+	for(int i = 0; i < sizeof(copyTargets) / sizeof(copyTargets[0]); i++) {
+		if(copyTargets[i].target == target) return copyTargets[i].state;
+	}
+	return 0;
+}
+
+void OGLE::glBindBuffer(GLenum target, GLuint buffer) {
+
+	switch(target) {
+		case GL_ARRAY_BUFFER: 
+			glState["GL_ARRAY_BUFFER_INDEX"] = new Blob(buffer); break;
+		case GL_ELEMENT_ARRAY_BUFFER: 
+			glState["GL_ELEMENT_ARRAY_BUFFER_INDEX"] = new Blob(buffer);
+			vao->elementBuffer = buffer;
+			break;
+		case GL_DRAW_INDIRECT_BUFFER: 
+			glState["GL_DRAW_INDIRECT_BUFFER_INDEX"] = new Blob(buffer); break;
+		case GL_UNIFORM_BUFFER: 
+			glState["GL_UNIFORM_BUFFER_INDEX"] = new Blob(buffer); break;
+		default:
+			if(const char *state = copyTargetState(target)) {
+				glState[state] = new Blob(buffer);
+			}
+			break;
+	}
+}
+
+void OGLE::glBufferData(GLenum target, GLsizei size, const GLvoid *data, GLenum usage) {
+	GLuint index = getBufferIndex(target);
+
+	if(index) {
+		// Outside a recording only the size and usage are kept; the
+		// contents are read back the first time a recorded draw needs
+		// them.  Without a way to read back, copy them now or never.
+		bool shadow = isRecording() || OGLE_CAPTURE_BUFFERS_ALL_FRAMES || !canReadBack();
+
+		shared->buffers->create(index, data, size, usage, shadow);
+		if(shadow) {
+			shared->buffers->enforceBudget(canReadBack(),
+				getBufferIndex(GL_ARRAY_BUFFER), getBufferIndex(GL_ELEMENT_ARRAY_BUFFER));
+		}
+	}
+}
+
+void OGLE::glBufferSubData(GLenum target, GLint offset, GLsizei size, const GLvoid *data) {
+	GLuint index = getBufferIndex(target);
+
+	if(index) {
+		BufferPtr buff = shared->buffers->find(index);
+		if(buff && offset < buff->size) {
+			bool current = buff->isCurrent();
+			shared->buffers->modified(buff.rawPtr());
+
+			// patching a stale shadow would not make it current, and
+			// outside a recording we only keep the metadata
+			if(!current || !isRecording()) return;
+
+			GLbyte *p = (GLbyte *) buff->ptr;
+			if(offset + size > buff->size) {
+				size -= offset + size - buff->size;
+			}
+			if(data) {
+				memcpy(p + offset, data, size);
+				buff->fetchedGeneration = buff->generation;
+			}
+		}
+	}
+}
+
+void OGLE::glMapBuffer(GLenum target, GLenum access) {
+	GLbitfield flags = 0;
+
+	switch(access) {
+		case GL_READ_ONLY: flags = GL_MAP_READ_BIT; break;
+		case GL_WRITE_ONLY: flags = GL_MAP_WRITE_BIT; break;
+		case GL_READ_WRITE: flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT; break;
+	}
+
+	glMapBufferRange(target, 0, -1, flags);
+}
+
+void OGLE::glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+	glState["GL_MAPPED_BUFFER_TARGET"] = new Blob(target);
+
+	if(GLuint index = getBufferIndex(target)) {
+		BufferPtr buff = shared->buffers->find(index);
+
+		if(buff) {
+			buff->mapAccess = access;
+			buff->mapOffset = offset;
+			buff->mapLength = (length < 0 ? buff->size - offset : length);
+			buff->mapCurrent = buff->isCurrent();
+			buff->dirty.clear();
+
+			if(access & GL_MAP_WRITE_BIT) {
+				shared->buffers->modified(buff.rawPtr());
+			}
+		}
+	}
+}
+
+void OGLE::glMapBufferPost(GLvoid *retValue) {
+	BlobPtr target = glState["GL_MAPPED_BUFFER_TARGET"];
+
+	if(target) {
+		if(GLuint index = getBufferIndex(target->toEnum())) {
+			BufferPtr buff = shared->buffers->find(index);
+
+			if(buff) {
+				buff->map = retValue;
+			}
+		}
+	}
+
+	glState["GL_MAPPED_BUFFER_TARGET"] = 0;
+}
+
+// With GL_MAP_FLUSH_EXPLICIT_BIT only the flushed ranges are defined,
+// so those are all that gets copied.
+
+void OGLE::glFlushMappedBufferRange(GLenum target, GLintptr offset, GLsizeiptr length) {
+	if(GLuint index = getBufferIndex(target)) {
+		BufferPtr buff = shared->buffers->find(index);
+
+		if(buff && buff->map) {
+			buff->addDirty(buff->mapOffset + offset, length);
+			shared->buffers->modified(buff.rawPtr());
+		}
+	}
+}
+
+void OGLE::glBufferStorage(GLenum target, GLsizeiptr size, const GLvoid *data, GLbitfield flags) {
+	// immutable storage has no usage hint; treat it like GL_STATIC_DRAW
+	glBufferData(target, size, data, 0);
+}
+
+void OGLE::glCopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) {
+	glCopyNamedBufferSubData(getBufferIndex(readTarget), getBufferIndex(writeTarget), readOffset, writeOffset, size);
+}
+
+// The GPU makes the copy.  Where both shadows are current the same copy
+// between them keeps the destination current; otherwise it is read
+// back when next drawn.
+
+void OGLE::glCopyNamedBufferSubData(GLuint readBuffer, GLuint writeBuffer, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) {
+	BufferPtr dst = shared->buffers->find(writeBuffer);
+	if(!dst) return;
+
+	BufferPtr src = shared->buffers->find(readBuffer);
+	bool current = isRecording() && dst->isCurrent() && src && src->isCurrent();
+	shared->buffers->modified(dst.rawPtr());
+
+	if(!current || size <= 0 || readOffset < 0 || writeOffset < 0
+		|| readOffset + size > src->size || writeOffset + size > dst->size) {
+		return;
+	}
+
+	memmove((GLbyte *)dst->ptr + writeOffset, (const GLbyte *)src->ptr + readOffset, size);
+	dst->fetchedGeneration = dst->generation;
+}
+
+// Cleared by the GPU to a value in a format of its own; read back when
+// next drawn.
+
+void OGLE::glClearBufferData(GLenum target, GLenum internalformat, GLenum format, GLenum type, const GLvoid *data) {
+	if(BufferPtr buff = shared->buffers->find(getBufferIndex(target))) {
+		shared->buffers->modified(buff.rawPtr());
+	}
+}
+
+void OGLE::glClearBufferSubData(GLenum target, GLenum internalformat, GLintptr offset, GLsizeiptr size, GLenum format, GLenum type, const GLvoid *data) {
+	glClearBufferData(target, internalformat, format, type, data);
+}
+
+// A buffer texture can be written by image stores.
+
+void OGLE::glTexBuffer(GLenum target, GLenum internalformat, GLuint buffer) {
+	gpuWrites(buffer);
+}
+
+// From now on the buffer may change at any draw or dispatch, with no
+// call we would see, so its shadow is never trusted again and is read
+// back for every draw that needs it.  A buffer bound before it has any
+// storage is still remembered.
+
+void OGLE::gpuWrites(GLuint buffer) {
+	if(!buffer) return;
+
+	BufferPtr buff = shared->buffers->find(buffer);
+	if(!buff) {
+		buff = shared->buffers->create(buffer, 0, 0, 0, false);
+	}
+	buff->gpuWritable = true;
+}
+
+void OGLE::glDeleteBuffers(GLsizei n, const GLuint *names) {
+	if(!names) return;
+
+	for(int i = 0; i < n; i++) {
+		shared->buffers->remove(names[i]);
+
+		// deleting a bound buffer reverts the binding to zero
+		if(getBufferIndex(GL_ARRAY_BUFFER) == names[i]) {
+			glState["GL_ARRAY_BUFFER_INDEX"] = 0;
+		}
+		if(getBufferIndex(GL_ELEMENT_ARRAY_BUFFER) == names[i]) {
+			glState["GL_ELEMENT_ARRAY_BUFFER_INDEX"] = 0;
+			vao->elementBuffer = 0;
+		}
+		if(getBufferIndex(GL_DRAW_INDIRECT_BUFFER) == names[i]) {
+			glState["GL_DRAW_INDIRECT_BUFFER_INDEX"] = 0;
+		}
+		if(getBufferIndex(GL_UNIFORM_BUFFER) == names[i]) {
+			glState["GL_UNIFORM_BUFFER_INDEX"] = 0;
+		}
+		for(int k = 0; k < sizeof(copyTargets) / sizeof(copyTargets[0]); k++) {
+			if(getBufferIndex(copyTargets[k].target) == names[i]) {
+				glState[copyTargets[k].state] = 0;
+			}
+		}
+		if(matrixBlockBuffer == names[i]) {
+			matrixBlockBuffer = 0;
+		}
+	}
+}
+
+void OGLE::glUnmapBuffer(GLenum target) {
+
+	if(GLuint index = getBufferIndex(target)) {
+		BufferPtr buff = shared->buffers->find(index);
+
+		if(buff) {
+			if(buff->map && isRecording()) {
+				syncMappedBuffer(target, buff.rawPtr());
+			}
+			buff->map = 0;
+			buff->mapAccess = 0;
+			buff->dirty.clear();
+		}
+	}
+}
+
+
+// Display lists are compiled once, usually well before the frame being
+// recorded, so their geometry is captured whenever they are built.  The
+// matrix calls compiled into a list are not tracked; a list's geometry
+// is placed with the matrices current at glCallList.
+
+void OGLE::glNewList(GLuint list, GLenum mode) {
+	if(compilingList) return;
+
+	compilingList = new DisplayList(mode);
+	compilingListName = list;
+}
+
+void OGLE::glEndList() {
+	if(!compilingList) return;
+
+	DisplayListPtr list = compilingList;
+	compilingList = 0;
+
+	// a set left open by a glBegin without glEnd never makes it in
+	currSet = 0;
+
+	list->compact();
+	shared->displayLists[compilingListName] = list;
+
+	if(OGLE::config.logFunctions) {
+		fprintf(OGLE::LOG, "\tOGLE::glEndList: list %d, %d sets, %d elements, %d bytes\n",
+			compilingListName, (int)list->prims.size(), (int)list->flags.size(), (int)list->bytes());
+	}
+
+	if(list->mode == GL_COMPILE_AND_EXECUTE && isRecording()) {
+		glCallList(compilingListName);
+	}
+}
+
+void OGLE::glCallList(GLuint list) {
+	if(compilingList) {
+		compilingList->addCall(list);
+		return;
+	}
+
+	if(!isRecording() || !sampleDraw()) return;
+
+	GLfloat M[16], TM[16];
+	getCurrMatrix(GL_MODELVIEW_MATRIX, M);
+	getCurrMatrix(GL_TEXTURE_MATRIX, TM);
+
+	emitList(list, M, TM);
+}
+
+void OGLE::glCallLists(GLsizei n, GLenum type, const GLvoid *lists) {
+	if(!lists) return;
+
+	const GLubyte *b = (const GLubyte *)lists;
+
+	for(int i = 0; i < n; i++) {
+		GLuint list;
+
+		switch(type) {
+			case GL_BYTE: list = ((const GLbyte *)lists)[i]; break;
+			case GL_UNSIGNED_BYTE: list = b[i]; break;
+			case GL_SHORT: list = ((const GLshort *)lists)[i]; break;
+			case GL_UNSIGNED_SHORT: list = ((const GLushort *)lists)[i]; break;
+			case GL_INT: list = ((const GLint *)lists)[i]; break;
+			case GL_UNSIGNED_INT: list = ((const GLuint *)lists)[i]; break;
+			case GL_FLOAT: list = (GLuint)((const GLfloat *)lists)[i]; break;
+			case GL_2_BYTES: list = (b[2*i] << 8) | b[2*i+1]; break;
+			case GL_3_BYTES: list = (b[3*i] << 16) | (b[3*i+1] << 8) | b[3*i+2]; break;
+			case GL_4_BYTES: list = (b[4*i] << 24) | (b[4*i+1] << 16) | (b[4*i+2] << 8) | b[4*i+3]; break;
+			default: return;
+		}
+
+		glCallList(listBase + list);
+	}
+}
+
+// Place the sets of dl (or nPrims of them from firstPrim) under the
+// given matrices.  The positions and normals are transformed as whole
+// arrays before any element is made.  The flight recorder copies the
+// prims and keeps the matrices, to do this if the frame is written.
+
+void OGLE::emitGeometry(const DisplayList &dl, const GLfloat *M, const GLfloat *TM,
+		size_t firstPrim, size_t nPrims) {
+	nPrims = std::min(nPrims, dl.prims.size() - std::min(firstPrim, dl.prims.size()));
+	if(!nPrims) return;
+
+	if(flight) {
+		flight->addList(dl, firstPrim, nPrims, M, TM);
+		return;
+	}
+
+	Transform T = toTransform(M);
+	Transform TT = toTransform(TM);
+	float scale = OGLE::config.scale;
+
+	// the elements of those prims, which are consecutive
+	const DisplayList::Prim &last = dl.prims[firstPrim + nPrims - 1];
+	size_t first = dl.prims[firstPrim].first;
+	size_t nElements = last.first + last.count - first;
+
+	bool attribs = keepAttribs();
+
+	std::vector<GLfloat> v(4 * nElements), n, t;
+	transformPoints(M, &dl.v[4*first], &v[0], nElements);
+	if(attribs && !dl.n.empty()) {
+		n.resize(4 * nElements);
+		transformPoints(M, &dl.n[4*first], &n[0], nElements);
+	}
+	if(attribs && !dl.t.empty()) {
+		t.resize(4 * nElements);
+		transformPoints(TM, &dl.t[4*first], &t[0], nElements);
+	}
+
+	for(size_t p = firstPrim; p < firstPrim + nPrims; p++) {
+		const DisplayList::Prim &prim = dl.prims[p];
+		ElementSetPtr set = new ElementSet(prim.mode, T, TT);
+
+		for(GLuint k = prim.first; k < prim.first + prim.count; k++) {
+			const GLfloat *R = &v[4*(k - first)];
+			ElementPtr E = new Element();
+
+			E->v = new Vertex();
+			E->v->init(R[0], R[1], R[2], R[3]);
+
+			if(attribs && (dl.flags[k] & DisplayList::HAS_NORMAL)) {
+				R = &n[4*(k - first)];
+				E->n = new Vertex();
+				E->n->init(R[0], R[1], R[2], R[3]);
+			}
+
+			if(attribs && (dl.flags[k] & DisplayList::HAS_TEXCOORD)) {
+				R = &t[4*(k - first)];
+				E->t = new Vertex();
+				E->t->init(R[0], R[1], R[2], R[3]);
+			}
+
+			if(dl.flags[k] & DisplayList::HAS_COLOR) {
+				R = &dl.c[4*k];
+				E->c = new Vertex();
+				E->c->init(R[0], R[1], R[2], R[3]);
+			}
+
+			if(scale) {
+				E->v->x *= scale; E->v->y *= scale; E->v->z *= scale;
+				if(E->n) { E->n->x *= scale; E->n->y *= scale; E->n->z *= scale; }
+			}
+
+			set->addTransformedElement(E);
+		}
+
+		addSet(set);
+	}
+}
+
+void OGLE::glListBase(GLuint base) {
+	listBase = base;
+}
+
+void OGLE::glDeleteLists(GLuint list, GLsizei range) {
+	for(GLsizei i = 0; i < range; i++) {
+		shared->displayLists.erase(list + i);
+	}
+}
+
+// Turn a compiled list into sets under the given modelview and texture
+// matrices.  The elements are transformed straight from the list's
+// arrays, so a list called thousands of times costs one pass over its
+// floats per call and nothing else.
+
+void OGLE::emitList(GLuint list, const GLfloat *M, const GLfloat *TM, int depth) {
+	TRACE_ZONE("display list playback");
+	// GL's own limit on display list nesting
+	if(depth >= 64) return;
+
+	std::unordered_map<GLuint, DisplayListPtr>::iterator l = shared->displayLists.find(list);
+	if(l == shared->displayLists.end()) return;
+
+	const DisplayList &dl = *l->second.rawPtr();
+
+	emitGeometry(dl, M, TM);
+
+	for(int c = 0; c < dl.calls.size(); c++) {
+		emitList(dl.calls[c], M, TM, depth + 1);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////
+// OGLE utility functions
+////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////
+// OGLE's Helper Functions
+/////////////////////////////////////////////////////////////////////////////////
+
+
+void OGLE::initFunctions() {
+
+	functionsInit = true;
+	extensionVBOSupported = false;
+
+	float oglVersion = callBacks->GetGLVersion();
+	if(oglVersion >= 1.5f ||
+		callBacks->IsGLExtensionSupported("GL_ARB_vertex_buffer_object")) {
+		extensionVBOSupported = true;
+
+	    //Attempty to get the core version
+		iglGetBufferSubData = (GLvoid (GLAPIENTRY *) (GLenum, GLint, GLsizei, GLvoid *))callBacks->GetGLFunction("glGetBufferSubData");
+
+		if(iglGetBufferSubData == NULL) {
+		  //Attempt to get the ARB version instead
+		  iglGetBufferSubData = (GLvoid (GLAPIENTRY *) (GLenum, GLint, GLsizei, GLvoid *))callBacks->GetGLFunction("glGetBufferSubDataARB");
+
+		  if(iglGetBufferSubData == NULL) {
+			 //Unable to get the entry point, don't check for VBOs
+			 extensionVBOSupported = false;
+		  }
+		}
+
+		// for reading back buffers that are not bound, e.g. those of
+		// vertex array objects
+		iglBindBuffer = (GLvoid (GLAPIENTRY *) (GLenum, GLuint))callBacks->GetGLFunction("glBindBuffer");
+		if(iglBindBuffer == NULL) {
+		  iglBindBuffer = (GLvoid (GLAPIENTRY *) (GLenum, GLuint))callBacks->GetGLFunction("glBindBufferARB");
+		}
+	}
+
+}
+
+
+
+
+void OGLE::addSet(ElementSetPtr set) {
+	
+  if(! set) return;
+
+  if(compilingList) {
+	  compilingList->addSet(*set.rawPtr());
+	  return;
+  }
+
+  if(
+	  (set->mode == GL_TRIANGLES && OGLE::config.polyTypesEnabled["TRIANGLES"]) 
+	  || (set->mode == GL_TRIANGLE_STRIP && OGLE::config.polyTypesEnabled["TRIANGLE_STRIP"]) 
+	  || (set->mode == GL_TRIANGLE_FAN && OGLE::config.polyTypesEnabled["TRIANGLE_FAN"])
+	  || (set->mode == GL_QUADS && OGLE::config.polyTypesEnabled["QUADS"])
+	  || (set->mode == GL_QUAD_STRIP && OGLE::config.polyTypesEnabled["QUAD_STRIP"])
+	  || (set->mode == GL_POLYGON && OGLE::config.polyTypesEnabled["POLYGON"]) 
+	  ) {
+
+	  if(flight) {
+		  flight->addSet(*set.rawPtr(), flightM, flightTM);
+	  }
+	  else if(set->coalesce && set->elements.size() <= OGLE::config.coalesceDrawElements) {
+		  // a small draw waits for the next, in case it can go with it.
+		  // Vertices past the last whole primitive are ignored by GL, and
+		  // would shift the faces of whatever is joined after them
+		  size_t per = set->mode == GL_QUADS ? 4 : 3;
+		  set->elements.resize(set->elements.size() - set->elements.size() % per);
+
+		  if(coalesced && (!matchesCoalesced(set->mode, set->deferred)
+				|| coalesced->elements.size() + set->elements.size() > OGLE::config.coalesceSetElements)) {
+			  flushCoalesced();
+		  }
+
+		  if(!coalesced) {
+			  coalesced = set;
+			  memcpy(coalescedM, setM, sizeof(setM));
+			  memcpy(coalescedTM, setTM, sizeof(setTM));
+		  }
+		  else {
+			  coalesced->elements.insert(coalesced->elements.end(), set->elements.begin(), set->elements.end());
+		  }
+	  }
+	  else {
+		  // anything else goes after what is held, to keep the order
+		  flushCoalesced();
+		  objFile->addSet(set);
+	  }
+	  // no need to store the ElementSets
+	  //  sets.push_back(set);
+
+  }
+
+
+}
+
+void OGLE::newSet(GLenum mode)
+{
+	if(compilingList) {
+		currSet = new OGLE::ElementSet(mode);
+		return;
+	}
+
+	if(flight) {
+		// the transform is left for when the frame is written
+		getCurrMatrix(GL_MODELVIEW_MATRIX, flightM);
+		getCurrMatrix(GL_TEXTURE_MATRIX, flightTM);
+		currSet = new OGLE::ElementSet(mode);
+		lockCacheChecked = 0;
+		return;
+	}
+
+	bool deferred = governor && governor->deferTransforms();
+
+	if(canCoalesce(mode)) {
+		// a draw that can join the held set shares its transforms,
+		// rather than building its own
+		getCurrMatrix(GL_MODELVIEW_MATRIX, setM);
+		getCurrMatrix(GL_TEXTURE_MATRIX, setTM);
+
+		if(coalesced && matchesCoalesced(mode, deferred)) {
+			currSet = new OGLE::ElementSet(mode, coalesced->transform, coalesced->texCoordTransform, deferred);
+		}
+		else {
+			currSet = new OGLE::ElementSet(mode, toTransform(setM), toTransform(setTM), deferred);
+		}
+		currSet->coalesce = 1;
+
+		lockCacheChecked = 0;
+		return;
+	}
+
+	Transform _transform = this->getCurrTransform();
+	Transform _texCoordTransform = this->getCurrTransform(GL_TEXTURE_MATRIX);
+	currSet = new OGLE::ElementSet(mode, _transform, _texCoordTransform, deferred);
+
+	lockCacheChecked = 0;
+}
+
+
+// Only separate triangles and quads can be joined, since the sets'
+// elements are simply put end to end.
+
+bool OGLE::canCoalesce(GLenum mode) {
+	return OGLE::config.coalesceDrawElements > 0 && objFile && !flight && !compilingList
+		&& (mode == GL_TRIANGLES || mode == GL_QUADS);
+}
+
+bool OGLE::matchesCoalesced(GLenum mode, bool deferred) {
+	return coalesced->mode == mode && coalesced->deferred == deferred
+		&& !memcmp(setM, coalescedM, sizeof(setM)) && !memcmp(setTM, coalescedTM, sizeof(setTM));
+}
+
+// Everything a batch's draws share that decides what they capture: the
+// mode, the buffers and generations and layouts of the streams, the
+// current attributes standing in for streams that are off, the index
+// buffer, and the matrices; the draws then add where they start in it,
+// as an offset from indexBase.  False for anything drawn from client
+// memory, which could have changed without our seeing it, and for
+// skinned draws.
+
+static void appendStream(std::string &sig, const OGLE::FetchPlan::Stream &s) {
+	if(!s.data) {
+		sig.append(1, '\0');
+		return;
+	}
+
+	size_t offset = s.data - (const GLbyte *)s.buffer->ptr;
+	sig.append(1, '\1');
+	sig.append((const char *)&s.buffer->name, sizeof(s.buffer->name));
+	sig.append((const char *)&s.buffer->generation, sizeof(s.buffer->generation));
+	sig.append((const char *)&offset, sizeof(offset));
+	sig.append((const char *)&s.size, sizeof(s.size));
+	sig.append((const char *)&s.type, sizeof(s.type));
+	sig.append((const char *)&s.stride, sizeof(s.stride));
+	sig.append(1, s.normalized ? '\1' : '\0');
+}
+
+static void appendCurrent(std::string &sig, const OGLE::VertexPtr &v) {
+	const OGLE::Vertex *p = v.rawPtr();
+	if(!p) {
+		sig.append(1, '\0');
+		return;
+	}
+
+	GLfloat V[4] = { p->x, p->y, p->z, p->w };
+	sig.append(1, '\1');
+	sig.append((const char *)V, sizeof(V));
+}
+
+bool OGLE::batchSignature(std::string &sig, GLenum mode, GLenum type, const FetchPlan &plan, const GLbyte *&indexBase) {
+	if(currProgram && !currProgram->palette.empty()) {
+		return false;
+	}
+
+	const FetchPlan::Stream *streams[] = { &plan.v, &plan.n, &plan.t, &plan.c };
+	for(int k = 0; k < 4; k++) {
+		if(streams[k]->data && !streams[k]->buffer) {
+			return false;
+		}
+	}
+
+	Buffer *indexBuffer = 0;
+	if(type) {
+		GLuint name = getBufferIndex(GL_ELEMENT_ARRAY_BUFFER);
+		indexBuffer = name ? shared->buffers->find(name).rawPtr() : 0;
+		if(!indexBuffer || !indexBuffer->ptr) {
+			return false;
+		}
+		indexBase = (const GLbyte *)indexBuffer->ptr;
+	}
+
+	GLfloat M[16], TM[16];
+	getCurrMatrix(GL_MODELVIEW_MATRIX, M);
+	getCurrMatrix(GL_TEXTURE_MATRIX, TM);
+
+	sig.reserve(512);
+	sig.append((const char *)&mode, sizeof(mode));
+	sig.append((const char *)&type, sizeof(type));
+
+	for(int k = 0; k < 4; k++) {
+		appendStream(sig, *streams[k]);
+	}
+
+	if(!plan.n.data) appendCurrent(sig, currNormal);
+	if(!plan.t.data) appendCurrent(sig, currTexCoord);
+	if(!plan.c.data) appendCurrent(sig, currColor);
+
+	if(indexBuffer) {
+		sig.append((const char *)&indexBuffer->name, sizeof(indexBuffer->name));
+		sig.append((const char *)&indexBuffer->generation, sizeof(indexBuffer->generation));
+	}
+
+	sig.append((const char *)M, sizeof(M));
+	sig.append((const char *)TM, sizeof(TM));
+	return true;
+}
+
+void OGLE::endDuplicateFrame() {
+	if(nDuplicates) {
+		fprintf(OGLE::LOG, "Skipped %d draws that repeated earlier ones exactly\n", nDuplicates);
+	}
+	drawSignatures.clear();
+	nDuplicates = 0;
+}
+
+void OGLE::collapsedInstances(GLsizei instances) {
+	if(instances > 1) {
+		nCollapsedDraws++;
+		nCollapsedInstances += instances;
+	}
+}
+
+void OGLE::endInstanceFrame() {
+	if(nCollapsedDraws) {
+		fprintf(OGLE::LOG, "Wrote %d instanced draws (%d instances) once each, with no InstanceTransformAttrib to place them\n",
+			nCollapsedDraws, nCollapsedInstances);
+	}
+	nCollapsedDraws = 0;
+	nCollapsedInstances = 0;
+}
+
+void OGLE::flushCoalesced() {
+	if(!coalesced) return;
+
+	if(objFile) {
+		objFile->addSet(coalesced);
+	}
+	coalesced = 0;
+}
+
+
+void OGLE::resolveFetchPlan(FetchPlan &plan) {
+	TRACE_ZONE("resolve arrays");
+	memset(&plan, 0, sizeof(plan));
+
+	if(!vArray.enabled) {
+		resolveAttribPlan(plan);
+		return;
+	}
+
+	// the fixed function arrays read from whatever is bound at the draw
+	GLuint buffIndex = getBufferIndex(GL_ARRAY_BUFFER);
+
+	if(!resolveStream(plan.v, &vArray, buffIndex)) {
+		return;
+	}
+
+	bool attribs = keepAttribs();
+
+	if(OGLE::config.captureNormals && attribs && nArray.enabled) {
+		resolveStream(plan.n, &nArray, buffIndex);
+	}
+
+	if(OGLE::config.captureTexCoords && attribs && tArray && tArray->enabled) {
+		resolveStream(plan.t, tArray.rawPtr(), buffIndex);
+	}
+
+	if(OGLE::config.captureColors && cArray.enabled) {
+		resolveStream(plan.c, &cArray, buffIndex);
+	}
+}
+
+// Draws from generic attributes, with the locations the config maps to
+// position, normal, texcoord and colour.  The bound vertex array object keeps
+// the plan's formats until its state changes or buffer names are
+// re-created, so a draw only has to find where the shadows are now.
+
+void OGLE::resolveAttribPlan(FetchPlan &plan) {
+	VertexArray *va = vao.rawPtr();
+	FetchPlan::Stream *streams[4];
+
+	if(!va->planValid || va->planEpoch != shared->buffers->epoch) {
+		int locs[4] = {
+			OGLE::config.positionAttrib,
+			OGLE::config.captureNormals ? OGLE::config.normalAttrib : -1,
+			OGLE::config.captureTexCoords ? OGLE::config.texCoordAttrib : -1,
+			OGLE::config.captureColors ? OGLE::config.colorAttrib : -1
+		};
+
+		memset(&va->plan, 0, sizeof(va->plan));
+		streams[0] = &va->plan.v; streams[1] = &va->plan.n; streams[2] = &va->plan.t; streams[3] = &va->plan.c;
+
+		for(int k = 0; k < 4; k++) {
+			va->sources[k] = 0;
+			va->offsets[k] = 0;
+
+			if(locs[k] < 0 || locs[k] >= va->attribs.size()) continue;
+
+			CArray *a = va->attribs[locs[k]].rawPtr();
+			if(!a || !a->enabled || a->divisor) continue;
+
+			BufferPtr buff = shared->buffers->find(a->buffer);
+			if((a->buffer && !buff) || !streamFormat(*streams[k], a)) {
+				// leaves size 0, so the stream is never read
+				memset(streams[k], 0, sizeof(FetchPlan::Stream));
+				continue;
+			}
+
+			va->sources[k] = buff;
+			va->offsets[k] = a->data;
+		}
+
+		va->planValid = 1;
+		va->planEpoch = shared->buffers->epoch;
+	}
+
+	plan = va->plan;
+	if(!keepAttribs()) {
+		memset(&plan.n, 0, sizeof(plan.n));
+		memset(&plan.t, 0, sizeof(plan.t));
+	}
+	streams[0] = &plan.v; streams[1] = &plan.n; streams[2] = &plan.t; streams[3] = &plan.c;
+
+	for(int k = 0; k < 4; k++) {
+		Buffer *buff = 0;
+
+		if(!streams[k]->size) continue;
+
+		if(va->sources[k]) {
+			buff = currentBuffer(GL_ARRAY_BUFFER, va->sources[k]->name);
+			if(!buff) continue;
+		}
+
+		bindStream(*streams[k], va->offsets[k], buff);
+	}
+}
+
+bool OGLE::resolveStream(FetchPlan::Stream &s, const CArray *arr, GLuint buffIndex) {
+	s.data = 0;
+	s.end = 0;
+
+	if(!streamFormat(s, arr)) {
+		return false;
+	}
+
+	if(buffIndex) {
+		BufferPtr buff = shared->buffers->find(buffIndex);
+		return buff && bindStream(s, arr->data, buff.rawPtr());
+	}
+
+	return bindStream(s, arr->data, 0);
+}
+
+bool OGLE::streamFormat(FetchPlan::Stream &s, const CArray *arr) {
+	switch(arr->type) {
+		case GL_BYTE: case GL_UNSIGNED_BYTE:
+		case GL_SHORT: case GL_UNSIGNED_SHORT:
+		case GL_INT: case GL_UNSIGNED_INT:
+		case GL_FLOAT: case GL_DOUBLE:
+			break;
+		default: return false;
+	}
+
+	if(arr->size < 1 || arr->size > 4) {
+		return false;
+	}
+
+	s.size = arr->size;
+	s.type = arr->type;
+	s.normalized = arr->normalized != 0;
+	s.bytes = arr->size * glTypeSize(arr->type);
+	s.stride = arr->stride ? arr->stride : s.bytes;
+	return true;
+}
+
+// Point s at pointer, which is an offset into buff's shadow when there
+// is a buff.  Fails if the data is not where we can read it.
+
+bool OGLE::bindStream(FetchPlan::Stream &s, const GLbyte *pointer, Buffer *buff) {
+	s.data = 0;
+	s.end = 0;
+
+	s.buffer = buff;
+
+	if(!buff) {
+		s.data = pointer;
+		return s.data != 0;
+	}
+
+	size_t offset = (size_t)pointer;
+	if(!buff->ptr || offset >= buff->size) {
+		return false;
+	}
+
+	s.data = (const GLbyte *)buff->ptr + offset;
+	s.end = (const GLbyte *)buff->ptr + buff->size;
+	return true;
+}
+
+
+#define GLVoidPDeRef(TYPE, ARRAY, INDEX) (  *((TYPE *)(((char *)ARRAY) + INDEX * sizeof(TYPE)))  )
+
+GLint OGLE::derefIndexArray(GLenum type, const GLvoid *indices, int i) {
+	GLint index = 0;
+
+	switch (type) {
+		case GL_UNSIGNED_BYTE: index = GLVoidPDeRef(GLubyte, indices, i); break;
+		case GL_UNSIGNED_SHORT:  index = GLVoidPDeRef(GLushort, indices, i); break;
+		case GL_UNSIGNED_INT:  index = GLVoidPDeRef(GLuint, indices, i);break;
+    }
+
+	return index; 
+
+}
+
+// The lowest and highest vertex the draws read; false if they read none.
+
+bool OGLE::drawRange(GLenum type, const SubDraw *draws, GLsizei n, GLint &lo, GLint &hi) {
+	lo = INT_MAX;
+	hi = -1;
+
+	for(int i = 0; i < n; i++) {
+		const SubDraw &d = draws[i];
+
+		if(!type) {
+			if(d.count <= 0) continue;
+			lo = std::min(lo, d.first);
+			hi = std::max(hi, d.first + d.count - 1);
+			continue;
+		}
+
+		for(GLsizei k = 0; k < d.count; k++) {
+			GLint index = derefIndexArray(type, d.indices, k);
+			if(index < d.start || index > d.end) continue;
+			index += d.baseVertex;
+			lo = std::min(lo, index);
+			hi = std::max(hi, index);
+		}
+	}
+
+	return hi >= lo && lo >= 0;
+}
+
+bool OGLE::isElementLocked(int i) {
+  GLint lock_first;
+  GLsizei lock_count;
+  BlobPtr lfP, lcP;
+
+  lfP =	glState["GL_LOCK_ARRAYS_FIRST"];
+  lock_first = lfP ? lfP->toInt() : -1;
+
+  lcP =	glState["GL_LOCK_ARRAYS_COUNT"];
+  lock_count = lcP ? lcP->toSizeI() : 0;
+
+  return (lock_first > -1 && lock_count > 0) && (i < lock_first || i > lock_first + lock_count);
+}
+
+
+// (Re)fill the lock cache unless it was built for the current set's
+// transforms and the same array buffer contents.
+
+void OGLE::buildLockCache() {
+	GLuint buffIndex = getBufferIndex(GL_ARRAY_BUFFER);
+	BufferPtr buff = shared->buffers->find(buffIndex);
+	unsigned int generation = buff ? buff->generation : 0;
+
+	if(lockCache->matches(*currSet.rawPtr(), buffIndex, generation)) {
+		return;
+	}
+
+	// addElement transforms and scales the elements in place, so the
+	// set they are built in only has to carry the transforms
+	ElementSetPtr set = new ElementSet(currSet->mode, currSet->transform, currSet->texCoordTransform);
+
+	FetchPlan plan;
+	resolveFetchPlan(plan);
+
+	for(GLsizei j = 0; j < lockCache->count; j++) {
+		ElementPtr E = plan.v.data ? fetchElement(plan, lockCache->first + j) : ElementPtr(0);
+		if(E) {
+			set->addElement(E);
+		}
+		lockCache->elements[j] = E;
+	}
+
+	lockCache->built = 1;
+	lockCache->transform = currSet->transform;
+	lockCache->texCoordTransform = currSet->texCoordTransform;
+	lockCache->buffer = buffIndex;
+	lockCache->generation = generation;
+	lockCache->nBuilt++;
+}
+
+// The array pointers changed under a lock; whatever was cached is stale.
+
+void OGLE::invalidateLockCache() {
+	if(lockCache) {
+		lockCache->built = 0;
+	}
+}
+
+
+GLuint OGLE::getBufferIndex(GLenum target) {
+	BlobPtr index;
+
+	switch(target) {
+		case GL_ARRAY_BUFFER: 
+			index = glState["GL_ARRAY_BUFFER_INDEX"]; break;
+		case GL_ELEMENT_ARRAY_BUFFER: 
+			index = glState["GL_ELEMENT_ARRAY_BUFFER_INDEX"]; break;
+		case GL_DRAW_INDIRECT_BUFFER: 
+			index = glState["GL_DRAW_INDIRECT_BUFFER_INDEX"]; break;
+		case GL_UNIFORM_BUFFER: 
+			index = glState["GL_UNIFORM_BUFFER_INDEX"]; break;
+		default:
+			if(const char *state = copyTargetState(target)) {
+				index = glState[state];
+			}
+			break;
+	}
+
+	return index ? index->toUInt() : 0;
+}
+
+
+const GLbyte *OGLE::getBufferedArray(const GLbyte *array) {
+	GLuint buffIndex = 0;
+	GLuint offset = 0;
+	BufferPtr buff;
+
+
+	if(buffIndex = getBufferIndex(GL_ARRAY_BUFFER)) {
+		BufferPtr buff = shared->buffers->find(buffIndex);
+		if(buff && buff->ptr) {
+			offset = (GLuint)array;
+			array = ((GLbyte *)buff->ptr) + offset;
+		}
+	}
+	return array;
+}
+
+// The count indices of type at indices, or in the element array buffer
+// at that offset.  Indices that would run past the end of the buffer's
+// shadow are not read at all: 0, as for a buffer with no shadow.
+
+const GLvoid *OGLE::getBufferedIndices(const GLvoid *indices, GLsizei count, GLenum type) {
+
+	const GLbyte *ptr = (GLbyte *)indices;
+
+	if(GLuint buffIndex = getBufferIndex(GL_ELEMENT_ARRAY_BUFFER)) {
+		BufferPtr buff = shared->buffers->find(buffIndex);
+		if(!buff || buff->ptr == 0) {
+			return 0;
+		}
+
+		size_t offset = (size_t)ptr;
+		size_t bytes = count > 0 ? (size_t)count * indexTypeSize(type) : 0;
+		if(offset > (size_t)buff->size || bytes > (size_t)buff->size - offset) {
+			fprintf(OGLE::LOG, "\tOGLE: %d indices at offset %u run past the end of buffer %u (%d bytes)\n",
+				(int)count, (unsigned int)offset, buffIndex, (int)buff->size);
+			return 0;
+		}
+
+		ptr = ((GLbyte *)buff->ptr) + offset;
+	}
+
+
+	return ptr;
+}
+
+
+// Look to see if the program has set up Vertex or Element buffers
+// Copy them into buffers we will read from.
+
+void OGLE::checkBuffers() {
+	TRACE_ZONE("check buffers");
+	if(!canReadBack()) {
+		return;
+	}
+
+	currentBuffer(GL_ARRAY_BUFFER);
+	currentBuffer(GL_ELEMENT_ARRAY_BUFFER);
+
+	// restoring evicted shadows may have taken us back over budget
+	shared->buffers->enforceBudget(true, getBufferIndex(GL_ARRAY_BUFFER), getBufferIndex(GL_ELEMENT_ARRAY_BUFFER));
+}
+
+// The shadow of the buffer bound to target, brought up to date.  Returns
+// 0 if nothing is bound or the contents cannot be had.
+
+OGLE::Buffer *OGLE::currentBuffer(GLenum target) {
+	return currentBuffer(target, getBufferIndex(target));
+}
+
+// The same for buffer name, which need not be the one bound to target.
+
+OGLE::Buffer *OGLE::currentBuffer(GLenum target, GLuint name) {
+	BufferPtr bp = shared->buffers->find(name);
+	if(!bp) return 0;
+
+	if(bp->map) {
+		// only persistent maps can still be mapped at draw time
+		syncMappedBuffer(target, bp.rawPtr());
+	}
+
+	if(bp->isCurrent()) {
+		// nothing we can see has touched it since the last fetch
+		shared->buffers->touch(bp.rawPtr());
+	}
+	else if(canReadBack() && shared->buffers->restore(bp.rawPtr())) {
+		if(bp->fetchedGeneration == bp->generation) {
+			// fetched already, but the GPU may have written it since;
+			// what is read now counts as new contents
+			shared->buffers->modified(bp.rawPtr());
+		}
+		readBack(target, bp.rawPtr());
+	}
+
+	return bp->ptr && bp->fetchedGeneration == bp->generation ? bp.rawPtr() : 0;
+}
+
+// Copy the whole buffer from GL into its shadow.  A buffer that is not
+// the one bound to target is bound there just for the read.
+
+void OGLE::readBack(GLenum target, Buffer *buff) {
+	TRACE_ZONE("buffer read back");
+	GLuint bound = getBufferIndex(target);
+
+	if(bound != buff->name) {
+		if(!iglBindBuffer) return;
+		iglBindBuffer(target, buff->name);
+	}
+
+	iglGetBufferSubData(target, 0, buff->size, buff->ptr);
+	buff->fetchedGeneration = buff->generation;
+
+	if(bound != buff->name) {
+		iglBindBuffer(target, bound);
+	}
+}
+
+
+// Where the parameters of an indirect draw are: an offset into the
+// indirect buffer, or with none bound, client memory.
+
+const GLbyte *OGLE::getIndirect(const GLvoid *indirect, GLsizeiptr size) {
+	if(!getBufferIndex(GL_DRAW_INDIRECT_BUFFER)) {
+		return (const GLbyte *)indirect;
+	}
+
+	Buffer *buff = currentBuffer(GL_DRAW_INDIRECT_BUFFER);
+	size_t offset = (size_t)indirect;
+
+	if(!buff || offset + size > (size_t)buff->size) {
+		return 0;
+	}
+
+	return (const GLbyte *)buff->ptr + offset;
+}
+
+
+// Bring the shadow of a mapped buffer up to date from the mapping,
+// copying only what was written through it where we can tell.
+
+void OGLE::syncMappedBuffer(GLenum target, Buffer *buff) {
+	if(!buff->map || !(buff->mapAccess & GL_MAP_WRITE_BIT)) {
+		return;
+	}
+	TRACE_ZONE("sync mapped buffer");
+
+	if(!(buff->mapAccess & GL_MAP_FLUSH_EXPLICIT_BIT)) {
+		// every byte of the range may have been written
+		buff->dirty.clear();
+		buff->addDirty(buff->mapOffset, buff->mapLength);
+		shared->buffers->modified(buff);
+	}
+	else if(buff->dirty.empty()) {
+		return;
+	}
+
+	// The invalidate bits leave the range, or the whole buffer, undefined
+	// until it is written.  Whatever of it was not written is unknown
+	// now, so the shadow can no longer be kept current from the writes.
+	// That only holds for the first sync after the map.
+	if(buff->mapAccess & (GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)) {
+		bool whole = (buff->mapAccess & GL_MAP_INVALIDATE_BUFFER_BIT) != 0;
+		if(!(whole ? buff->dirtyCovers(0, buff->size) : buff->dirtyCovers(buff->mapOffset, buff->mapLength))) {
+			buff->mapCurrent = 0;
+		}
+		buff->mapAccess &= ~(GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	}
+
+	if(!buff->mapCurrent && buff->dirtyCovers(0, buff->size)) {
+		// every byte of the buffer was written through the mapping, so
+		// copying them makes the shadow current regardless.  With
+		// GL_MAP_FLUSH_EXPLICIT_BIT that takes flushes that cover it all.
+		buff->mapCurrent = shared->buffers->restore(buff);
+	}
+	else if(!buff->mapCurrent && (buff->mapAccess & GL_MAP_PERSISTENT_BIT) && canReadBack()) {
+		// reading back a persistently mapped buffer is allowed; do it
+		// once, and from then on follow the writes
+		if(shared->buffers->restore(buff)) {
+			readBack(target, buff);
+			buff->dirty.clear();
+			buff->mapCurrent = buff->fetchedGeneration == buff->generation;
+			return;
+		}
+	}
+
+	buff->copyDirty();
+}
+
+GLsizei OGLE::indexTypeSize(GLenum type) {
+	switch (type) {
+		case GL_UNSIGNED_BYTE: return sizeof(GLubyte);
+		case GL_UNSIGNED_SHORT: return sizeof(GLushort);
+		case GL_UNSIGNED_INT: return sizeof(GLuint);
+	}
+	return 0;
+}
+
+GLsizei OGLE::glTypeSize(GLenum type) {
+	GLsizei size = 0;
+	switch (type) {
+		case GL_BYTE: size = sizeof(GLbyte); break;
+		case GL_UNSIGNED_BYTE: size = sizeof(GLubyte); break;
+		case GL_UNSIGNED_SHORT: size = sizeof(GLushort); break;
+		case GL_UNSIGNED_INT: size = sizeof(GLuint); break;
+		case GL_SHORT: size = sizeof(GLshort); break;
+		case GL_INT: size = sizeof(GLint); break;
+		case GL_FLOAT: size = sizeof(GLfloat); break;
+		case GL_DOUBLE: size = sizeof(GLdouble); break;
+	}	
+	return size;
+}
+
+
+OGLE::VertexPtr OGLE::doTransform(VertexPtr vp, Transform T) {
+	
+	  OGLE::Vector V = vp->toVector();
+
+	  OGLE::Vector R(4);
+
+	  mtl::mult(T,V,R);
+
+	  return new OGLE::Vertex(R);
+}
+	
+OGLE::Transform OGLE::getCurrTransform(GLenum type) {
+		GLfloat mat[16];
+		getCurrMatrix(type, mat);
+
+		return toTransform(mat);
+}
+
+// The modelview comes from the program's uniforms when there are any
+// to go by.
+
+void OGLE::getCurrMatrix(GLenum type, GLfloat *mat) {
+	if(type == GL_MODELVIEW_MATRIX && getShaderModelView(mat)) {
+		return;
+	}
+	GLV->glGetFloatv(type, mat);
+}
+
+// GL matrices are column major
+OGLE::Transform OGLE::toTransform(const GLfloat *mat) {
+		int i, j;
+
+		Transform T(4,4);
+		for( i = 0; i < 4; i++) {
+			for( j = 0; j < 4; j++) {
+				T(j,i) = (float) mat[4*i + j];
+			}
+		}
+		return T;
+}
+
+void OGLE::transformPoint(const GLfloat *M, const GLfloat *in, GLfloat *out) {
+	for(int i = 0; i < 4; i++) {
+		out[i] = M[i] * in[0] + M[4 + i] * in[1] + M[8 + i] * in[2] + M[12 + i] * in[3];
+	}
+}
+
+// transformPoint over n packed 4-float points, one SSE register per
+// point.  The sums are in the same order, so the results are the same.
+
+void OGLE::transformPoints(const GLfloat *M, const GLfloat *in, GLfloat *out, size_t n) {
+	__m128 c0 = _mm_loadu_ps(M);
+	__m128 c1 = _mm_loadu_ps(M + 4);
+	__m128 c2 = _mm_loadu_ps(M + 8);
+	__m128 c3 = _mm_loadu_ps(M + 12);
+
+	for(size_t i = 0; i < n; i++) {
+		__m128 p = _mm_loadu_ps(in + 4*i);
+
+		__m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(p, p, _MM_SHUFFLE(0,0,0,0)));
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1,1,1,1))));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2,2,2,2))));
+		r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(p, p, _MM_SHUFFLE(3,3,3,3))));
+
+		_mm_storeu_ps(out + 4*i, r);
+	}
+}
+
+// out = A * B, all column major
+void OGLE::multMatrix(const GLfloat *A, const GLfloat *B, GLfloat *out) {
+	for(int c = 0; c < 4; c++) {
+		transformPoint(A, B + 4*c, out + 4*c);
+	}
+}
+
+// General 4x4 inverse by cofactors; false if m is singular.
+
+bool OGLE::invertMatrix(const GLfloat *m, GLfloat *out) {
+	GLfloat inv[16];
+
+	inv[0] = m[5]*m[10]*m[15] - m[5]*m[11]*m[14] - m[9]*m[6]*m[15] + m[9]*m[7]*m[14] + m[13]*m[6]*m[11] - m[13]*m[7]*m[10];
+	inv[4] = -m[4]*m[10]*m[15] + m[4]*m[11]*m[14] + m[8]*m[6]*m[15] - m[8]*m[7]*m[14] - m[12]*m[6]*m[11] + m[12]*m[7]*m[10];
+	inv[8] = m[4]*m[9]*m[15] - m[4]*m[11]*m[13] - m[8]*m[5]*m[15] + m[8]*m[7]*m[13] + m[12]*m[5]*m[11] - m[12]*m[7]*m[9];
+	inv[12] = -m[4]*m[9]*m[14] + m[4]*m[10]*m[13] + m[8]*m[5]*m[14] - m[8]*m[6]*m[13] - m[12]*m[5]*m[10] + m[12]*m[6]*m[9];
+	inv[1] = -m[1]*m[10]*m[15] + m[1]*m[11]*m[14] + m[9]*m[2]*m[15] - m[9]*m[3]*m[14] - m[13]*m[2]*m[11] + m[13]*m[3]*m[10];
+	inv[5] = m[0]*m[10]*m[15] - m[0]*m[11]*m[14] - m[8]*m[2]*m[15] + m[8]*m[3]*m[14] + m[12]*m[2]*m[11] - m[12]*m[3]*m[10];
+	inv[9] = -m[0]*m[9]*m[15] + m[0]*m[11]*m[13] + m[8]*m[1]*m[15] - m[8]*m[3]*m[13] - m[12]*m[1]*m[11] + m[12]*m[3]*m[9];
+	inv[13] = m[0]*m[9]*m[14] - m[0]*m[10]*m[13] - m[8]*m[1]*m[14] + m[8]*m[2]*m[13] + m[12]*m[1]*m[10] - m[12]*m[2]*m[9];
+	inv[2] = m[1]*m[6]*m[15] - m[1]*m[7]*m[14] - m[5]*m[2]*m[15] + m[5]*m[3]*m[14] + m[13]*m[2]*m[7] - m[13]*m[3]*m[6];
+	inv[6] = -m[0]*m[6]*m[15] + m[0]*m[7]*m[14] + m[4]*m[2]*m[15] - m[4]*m[3]*m[14] - m[12]*m[2]*m[7] + m[12]*m[3]*m[6];
+	inv[10] = m[0]*m[5]*m[15] - m[0]*m[7]*m[13] - m[4]*m[1]*m[15] + m[4]*m[3]*m[13] + m[12]*m[1]*m[7] - m[12]*m[3]*m[5];
+	inv[14] = -m[0]*m[5]*m[14] + m[0]*m[6]*m[13] + m[4]*m[1]*m[14] - m[4]*m[2]*m[13] - m[12]*m[1]*m[6] + m[12]*m[2]*m[5];
+	inv[3] = -m[1]*m[6]*m[11] + m[1]*m[7]*m[10] + m[5]*m[2]*m[11] - m[5]*m[3]*m[10] - m[9]*m[2]*m[7] + m[9]*m[3]*m[6];
+	inv[7] = m[0]*m[6]*m[11] - m[0]*m[7]*m[10] - m[4]*m[2]*m[11] + m[4]*m[3]*m[10] + m[8]*m[2]*m[7] - m[8]*m[3]*m[6];
+	inv[11] = -m[0]*m[5]*m[11] + m[0]*m[7]*m[9] + m[4]*m[1]*m[11] - m[4]*m[3]*m[9] - m[8]*m[1]*m[7] + m[8]*m[3]*m[5];
+	inv[15] = m[0]*m[5]*m[10] - m[0]*m[6]*m[9] - m[4]*m[1]*m[10] + m[4]*m[2]*m[9] + m[8]*m[1]*m[6] - m[8]*m[2]*m[5];
+
+	GLfloat det = m[0]*inv[0] + m[1]*inv[4] + m[2]*inv[8] + m[3]*inv[12];
+	if(det == 0) {
+		return false;
+	}
+
+	det = 1.0f / det;
+	for(int i = 0; i < 16; i++) {
+		out[i] = inv[i] * det;
+	}
+	return true;
+}
+
+bool OGLE::isIdentityTransform(Transform T) {
+	OGLE::Vector V(4,1);
+	OGLE::Vector R(4);
+
+	mtl::mult(T,V,R);
+
+	float prod = 1.0;
+	for(int t = 0; t < 4; t++) {
+		prod *= R[t];
+	}
+
+	return prod == 1.0;
+}
+
+
+
+
+
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// OGLE::LockCache functions
+//////////////////////////////////////////////////////////////////////////////////
+
+OGLE::LockCache::LockCache(GLint _first, GLsizei _count) :
+	first(_first),
+	count(_count),
+	built(0),
+	buffer(0),
+	generation(0),
+	elements(_count),
+	nBuilt(0),
+	nHits(0)
+{}
+
+bool OGLE::LockCache::matches(const ElementSet &set, GLuint _buffer, unsigned int _generation) const {
+	if(!built || buffer != _buffer || generation != _generation) {
+		return false;
+	}
+
+	for(int i = 0; i < 4; i++) {
+		for(int j = 0; j < 4; j++) {
+			if(transform(i,j) != set.transform(i,j)
+				|| texCoordTransform(i,j) != set.texCoordTransform(i,j)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// OGLE::ElementSet functions
+//////////////////////////////////////////////////////////////////////////////////
+
+OGLE::ElementSet::ElementSet(GLenum _mode, Transform _transform, Transform _texCoordTransform, bool _deferred) :
+	mode(_mode),
+	transform(_transform),
+	texCoordTransform(_texCoordTransform),
+	hasTransform(1),
+	deferred(_deferred),
+	coalesce(0)
+{}
+
+OGLE::ElementSet::ElementSet(GLenum _mode) :
+	mode(_mode),
+	hasTransform(0),
+	deferred(0),
+	coalesce(0)
+{}
+
+void OGLE::ElementSet::addElement(const GLfloat V[], GLsizei dim) {
+	addElement(new Vertex(V, dim));
+}
+
+void OGLE::ElementSet::addElement(VertexPtr V) {	
+	addElement(new OGLE::Element(V));
+}
+
+void OGLE::ElementSet::addElement(ElementPtr E) {
+	if(!deferred) {
+		placeElement(*E.rawPtr());
+	}
+
+	elements.push_back(E);
+}
+
+void OGLE::ElementSet::place() {
+	if(!deferred) return;
+	TRACE_ZONE("deferred transform");
+
+	for(int i = 0; i < elements.size(); i++) {
+		placeElement(*elements[i].rawPtr());
+	}
+	deferred = 0;
+}
+
+void OGLE::ElementSet::placeElement(Element &E) {
+	if(hasTransform) {
+		if(E.v) E.v = OGLE::doTransform(E.v, transform);
+		if(E.n) E.n = OGLE::doTransform(E.n, transform);
+		if(E.t) E.t = OGLE::doTransform(E.t, texCoordTransform);
+	}
+
+
+	float scale = OGLE::config.scale;
+	if(scale) {
+		if(E.v) {
+			E.v->x *= scale;
+			E.v->y *= scale;
+			E.v->z *= scale;
+		}
+
+		if(E.n) {
+			E.n->x *= scale;
+			E.n->y *= scale;
+			E.n->z *= scale;
+		}
+	}
+}
+
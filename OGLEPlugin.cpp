@@ -1,594 +1,1649 @@
-#include "stdafx.h"
-#include "../../MainLib/InterceptPluginInterface.h"
-#include "OGLEPlugin.h"
-#include "ogle.h"
-
-#include <ConfigParser.h>
-#include <CommonErrorLog.h>
-#include <MiscUtils.h>
-
-#include <algorithm>
-
-#include "Ptr/Ptr.in"
-
-USING_ERRORLOG
-
-//Path to the dll
-extern string dllPath;
-
-
-#include <string>
-
-//Include the common DLL code
-#include <PluginCommon.cpp>
-
-///////////////////////////////////////////////////////////////////////////////
-
-InterceptPluginInterface * GLIAPI CreateFunctionLogPlugin(const char *pluginName, InterceptPluginCallbacks * callBacks)
-{
-  //If no call backs, return NULL
-  if(callBacks == NULL)
-  {
-    return NULL;
-  }
-
-  //Assign the error logger
-  if(errorLog == NULL)
-  {
-    errorLog = callBacks->GetLogErrorFunction();
-  }
-
-  string cmpPluginName(pluginName);
-
-  //Test for the function status plugin
-  if(cmpPluginName == "OGLE")
-  {
-    return new OGLEPlugin(callBacks);
-  }
-
-  return NULL;
-}
-
-
-///////////////////////////////////////////////////////////////////////////////
-
-void OGLEPlugin::ProcessConfigData(ConfigParser *parser)
-{
-  //Get if logging by call count
-  const ConfigToken *testToken = parser->GetToken("Scale");
-
-  if(testToken)
-  {
-	  testToken->Get(OGLE::config.scale);
-	  fprintf(OGLE::LOG, "SCALE: %f\n", OGLE::config.scale);
-  }
-
-  testToken = parser->GetToken("CaptureNormals");
-
-  if(testToken)
-  {
-	  testToken->Get(OGLE::config.captureNormals);
-	  fprintf(OGLE::LOG, "CAPTURE NORMALS: %d\n", OGLE::config.captureNormals);
-  }
-
-  testToken = parser->GetToken("CaptureTextureCoords");
-
-  if(testToken)
-  {
-	  testToken->Get(OGLE::config.captureTexCoords);
-	  fprintf(OGLE::LOG, "CAPTURE TEX COORDS: %d\n", OGLE::config.captureTexCoords);
-  }
-
-
-  testToken = parser->GetToken("FlipPolygonStrips");
-
-  if(testToken)
-  {
-	  testToken->Get(OGLE::config.flipPolyStrips);
-	  fprintf(OGLE::LOG, "FLIP POLY STRIPS: %d\n", OGLE::config.flipPolyStrips);
-  }
-
-
-  testToken = parser->GetToken("LogFunctions");
-
-  if(testToken)
-  {
-	  testToken->Get(OGLE::config.logFunctions);
-	  fprintf(OGLE::LOG, "LOG FUNCTIONS: %d\n", OGLE::config.logFunctions);
-  }
-
-
-  testToken = parser->GetToken("ObjFileName");
-
-  if(testToken)
-  {
-	  testToken->Get(objFileName);
-	  int pos;
-	  if((pos = objFileName.find(".obj", objFileName.size() - 4)) == (objFileName.size() - 4)) {
-		  objFileName = objFileName.substr(0, objFileName.size() - 4);
-	  }
-
-
-	  fprintf(OGLE::LOG, "OBJFileName: %s\n", objFileName.c_str());
-  }
-
-  testToken = parser->GetToken("FilePerFrame");
-
-  if(testToken)
-  {
-	  testToken->Get(filePerFrame);
-	  fprintf(OGLE::LOG, "FilePerFrame: %d\n", filePerFrame);
-  }
-
-  testToken = parser->GetToken("FileInFrameDir");
-
-  if(testToken)
-  {
-	  testToken->Get(fileInFrameDir);
-	  fprintf(OGLE::LOG, "FileInFrameDir: %d\n", fileInFrameDir);
-  }
-
-
-
-
-  for(int i = 0; i < OGLE::Config::nPolyTypes; i++) {
-	  const char *type = OGLE::Config::polyTypes[i];
-
-	  testToken = parser->GetToken(type);
-
-	  if(testToken)
-	  {
-		  bool tmp;
-		  testToken->Get(tmp);
-		  OGLE::config.polyTypesEnabled[type] = tmp;
-		  fprintf(OGLE::LOG, "%s: %d\n", type, tmp);
-	  }
-  }
-
-  fflush(OGLE::LOG);
-
-}
-
-
-
-///////////////////////////////////////////////////////////////////////////////
-//
-OGLEPlugin::OGLEPlugin(InterceptPluginCallbacks *callBacks):
-gliCallBacks(callBacks),
-GLV(callBacks->GetCoreGLFunctions()),
-objFileName("ogle"),
-filePerFrame(0),
-fileInFrameDir(0),
-isRecording(0)
-{
-
-/**/
-  gliCallBacks->RegisterGLFunction("glBegin");
-  gliCallBacks->RegisterGLFunction("glEnd");
-  gliCallBacks->RegisterGLFunction("glArrayElement");
-  gliCallBacks->RegisterGLFunction("glVertex3fv");
-  gliCallBacks->RegisterGLFunction("glVertex3f");
-  gliCallBacks->RegisterGLFunction("glVertex3dv");
-  gliCallBacks->RegisterGLFunction("glVertex3d");
-  gliCallBacks->RegisterGLFunction("glNormal3fv");
-  gliCallBacks->RegisterGLFunction("glNormal3f");
-  gliCallBacks->RegisterGLFunction("glTexCoord2fv");
-  gliCallBacks->RegisterGLFunction("glTexCoord3fv");
-  gliCallBacks->RegisterGLFunction("glTexCoord2f");
-  gliCallBacks->RegisterGLFunction("glTexCoord3f");
-  gliCallBacks->RegisterGLFunction("glClientActiveTexture");
-  gliCallBacks->RegisterGLFunction("glClientActiveTextureARB");
-
-
-  gliCallBacks->RegisterGLFunction("glEnableClientState");
-  gliCallBacks->RegisterGLFunction("glDisableClientState");
-  gliCallBacks->RegisterGLFunction("glVertexPointer");
-  gliCallBacks->RegisterGLFunction("glNormalPointer");
-  gliCallBacks->RegisterGLFunction("glTexCoordPointer");
-  gliCallBacks->RegisterGLFunction("glDrawArrays");
-  gliCallBacks->RegisterGLFunction("glDrawElements");
-
-  gliCallBacks->RegisterGLFunction("glInterleavedArrays");
-
-
-  gliCallBacks->RegisterGLFunction("glDrawRangeElements");
-  gliCallBacks->RegisterGLFunction("glDrawRangeElementsEXT");
-
-  gliCallBacks->RegisterGLFunction("glLockArraysEXT");
-  gliCallBacks->RegisterGLFunction("glUnlockArraysEXT");
-
-  gliCallBacks->RegisterGLFunction("glBindBuffer");
-  gliCallBacks->RegisterGLFunction("glBindBufferARB");
-  gliCallBacks->RegisterGLFunction("glBufferData");
-  gliCallBacks->RegisterGLFunction("glBufferDataARB");
-  gliCallBacks->RegisterGLFunction("glBufferSubData");
-  gliCallBacks->RegisterGLFunction("glBufferSubDataARB");
-  gliCallBacks->RegisterGLFunction("glMapBuffer");
-  gliCallBacks->RegisterGLFunction("glMapBufferARB");
-  gliCallBacks->RegisterGLFunction("glUnmapBuffer");
-  gliCallBacks->RegisterGLFunction("glUnmapBufferARB");
-/**/
-  
-  //Get calls that are even outside contexts  
-  gliCallBacks->SetContextFunctionCalls(true);
-
-  //Parse the config file
-  ConfigParser fileParser;
-  if(fileParser.Parse(dllPath + "config.ini"))
-  {
-    ProcessConfigData(&fileParser);
-    fileParser.LogUnusedTokens(); 
-  }
-
-  //Parse the config string
-  ConfigParser stringParser;
-  if(stringParser.ParseString(gliCallBacks->GetConfigString()))
-  {
-    ProcessConfigData(&stringParser);
-    stringParser.LogUnusedTokens(); 
-  }
-
-  ogle = new OGLE(callBacks, callBacks->GetCoreGLFunctions());
-}
-
-
-///////////////////////////////////////////////////////////////////////////////
-//
-
-void OGLEPlugin::Destroy()
-{
-  delete this;
-}
-
-OGLEPlugin::~OGLEPlugin()
-{
-
-}
-
-///////////////////////////////////////////////////////////////////////////////
-//
-void OGLEPlugin::GLFunctionPre (uint updateID, const char *funcName, uint funcIndex, const FunctionArgs & args )
-{
-
-	//Create a access copy of the arguments
-	FunctionArgs _args(args);
-
-	if(isRecording || OGLE_BIND_BUFFERS_ALL_FRAMES) {
-		// do these always, because sometimes data buffers get set up in earlier frames
-		if(strcmp(funcName, "glBindBuffer") == 0 
-			|| strcmp(funcName, "glBindBufferARB") == 0) {
-			GLenum  target; _args.Get(target);
-			GLuint  buffer; _args.Get(buffer);
-			ogle->glBindBuffer(target , buffer);
-		}
-		else if(strcmp(funcName, "glBufferData") == 0
-				|| strcmp(funcName, "glBufferDataARB") == 0) {
-			GLenum  target; _args.Get(target);
-			GLsizei size; _args.Get(size);
-			GLvoid * data; _args.Get(data);
-			GLenum  usage; _args.Get(usage);
-			ogle->glBufferData(target , size , data , usage);
-		}
-
-
-
-
-		if(OGLE_CAPTURE_BUFFERS_ALL_FRAMES) {
-			// but we dont need to keep the actual data up-to-date, because we 
-			// re-fetch before drawing.
-			if(strcmp(funcName, "glBufferSubData") == 0
-					|| strcmp(funcName, "glBufferSubDataARB") == 0) {
-				GLenum  target; _args.Get(target);
-				GLint offset; _args.Get(offset);
-				GLsizei  size; _args.Get(size);
-				GLvoid * data; _args.Get(data);
-				ogle->glBufferSubData(target , offset , size , data);
-			}
-			else if(strcmp(funcName, "glMapBuffer") == 0 
-					|| strcmp(funcName, "glMapBufferARB") == 0) {
-				GLenum  target; _args.Get(target);
-				GLenum  access; _args.Get(access);
-				ogle->glMapBuffer(target , access);
-			}
-			else if(strcmp(funcName, "glUnmapBuffer") == 0 
-					|| strcmp(funcName, "glUnmapBufferARB") == 0) {
-				GLenum  target; _args.Get(target);
-				ogle->glUnmapBuffer(target);
-			}
-		}
-	}
-
-	if(!isRecording) return;
-	
-	if(OGLE::config.logFunctions) {
-		char buff[1024];
-		gliCallBacks->GetGLArgString(funcIndex, args, 1024, buff);
-		fprintf(OGLE::LOG, "PRE FUNCTION (%d): %s\n", funcIndex, buff);
-		fflush(OGLE::LOG);
-	}
-
-	if(strcmp(funcName, "glDrawElements") == 0) {
-		GLenum mode; _args.Get(mode);
-		GLsizei count; _args.Get(count);
-		GLenum type; _args.Get(type);
-		GLvoid *indices; _args.Get(indices);
-		ogle->glDrawElements(mode , count , type , indices);
-	}
-	else if(strcmp(funcName, "glDrawArrays") == 0) {
-		GLenum mode; _args.Get(mode);
-		GLint first; _args.Get(first);
-		GLsizei count; _args.Get(count);
-		ogle->glDrawArrays(mode , first , count);
-	}
-	else if(strcmp(funcName, "glLockArraysEXT") == 0) {
-		GLint first; _args.Get(first);
-		GLsizei count; _args.Get(count);
-		ogle->glLockArraysEXT(first, count);
-	}
-	else if(strcmp(funcName, "glUnlockArraysEXT") == 0) {
-		ogle->glUnlockArraysEXT();
-	}
-	else if(strcmp(funcName, "glDrawRangeElements") == 0
-			|| strcmp(funcName, "glDrawRangeElementsEXT") == 0
-			) {
-		GLenum  mode; _args.Get(mode);
-		GLuint  start; _args.Get(start);
-		GLuint  end; _args.Get(end);
-		GLsizei  count; _args.Get(count);
-		GLenum  type; _args.Get(type);
-		GLvoid * indices; _args.Get(indices);
-		ogle->glDrawRangeElements(mode , start , end , count , type , indices);
-	}
-	else if(strcmp(funcName, "glBegin") == 0) {
-		GLenum  mode; _args.Get(mode);
-		ogle->glBegin(mode);
-	}
-	else if(strcmp(funcName, "glEnd") == 0) {
-		ogle->glEnd();
-	}
-	else if(strcmp(funcName, "glArrayElement") == 0) {
-		GLint i; _args.Get(i);
-		ogle->glArrayElement(i);
-	}
-	else if(strcmp(funcName, "glVertex3fv") == 0) {
-		//GLfloat *V; _args.Get(V);
-		void *V; _args.Get(V);
-		ogle->glVertexfv((GLfloat *)V, 3);
-	}
-	else if(strcmp(funcName, "glVertex3f") == 0) {
-		GLfloat V[3]; _args.Get(*V); _args.Get(*(V+1)); _args.Get(*(V+2));
-		ogle->glVertexfv(V, 3);
-	}
-	else if(strcmp(funcName, "glVertex3dv") == 0) {
-		//GLdouble *V; _args.Get(V);
-		void *VV; _args.Get(VV);
-		GLdouble *V = (GLdouble *)VV;
-		GLfloat tmp[3]; tmp[0] = V[0]; tmp[1] = V[1]; tmp[2] = V[2];
-		ogle->glVertexfv(tmp, 3);
-	}
-	else if(strcmp(funcName, "glVertex3d") == 0) {
-		GLdouble V[3]; _args.Get(*V); _args.Get(*(V+1)); _args.Get(*(V+2));
-		GLfloat tmp[3]; tmp[0] = V[0]; tmp[1] = V[1]; tmp[2] = V[2];
-		ogle->glVertexfv(tmp, 3);
-	}
-	else if(strcmp(funcName, "glNormal3fv") == 0) {
-		//GLfloat *V; _args.Get(V);
-		void *V; _args.Get(V);
-		ogle->glNormalfv((GLfloat *)V, 3);
-	}
-	else if(strcmp(funcName, "glNormal3f") == 0) {
-		GLfloat V[3]; _args.Get(*V); _args.Get(*(V+1)); _args.Get(*(V+2));
-		ogle->glNormalfv(V, 3);
-	}
-	else if(strcmp(funcName, "glTexCoord3fv") == 0) {
-		//GLfloat *V; _args.Get(V);
-		void *V; _args.Get(V);
-		ogle->glTexCoordfv((GLfloat *)V, 3);
-	}
-	else if(strcmp(funcName, "glTexCoord2fv") == 0) {
-		//GLfloat *V; _args.Get(V);
-		void *V; _args.Get(V);
-		ogle->glTexCoordfv((GLfloat *)V, 2);
-	}
-	else if(strcmp(funcName, "glTexCoord3f") == 0) {
-		GLfloat V[3]; _args.Get(*V); _args.Get(*(V+1)); _args.Get(*(V+2));
-		ogle->glTexCoordfv(V, 3);
-	}
-	else if(strcmp(funcName, "glTexCoord2f") == 0) {
-		GLfloat V[2]; _args.Get(*V); _args.Get(*(V+1));
-		ogle->glTexCoordfv(V, 2);
-	}
-	else if(strcmp(funcName, "glEnableClientState") == 0) {
-		GLenum array; _args.Get(array);
-		ogle->glEnableClientState(array);		
-	}
-	else if(strcmp(funcName, "glDisableClientState") == 0) {
-		GLenum array; _args.Get(array);
-		ogle->glDisableClientState(array);
-	}
-	else if(strcmp(funcName, "glClientActiveTexture") == 0
-		|| strcmp(funcName, "glClientActiveTextureARB") == 0) {
-		GLenum texture; _args.Get(texture);
-		ogle->glClientActiveTexture(texture);
-	}
-	else if(strcmp(funcName, "glVertexPointer") == 0) {
-		GLint size; _args.Get(size);
-		GLenum type; _args.Get(type);
-		GLsizei stride; _args.Get(stride);
-		GLvoid *pointer; _args.Get(pointer);
-		ogle->glVertexPointer(size , type , stride , pointer);
-	}
-	else if(strcmp(funcName, "glNormalPointer") == 0) {
-		GLenum type; _args.Get(type);
-		GLsizei stride; _args.Get(stride);
-		GLvoid *pointer; _args.Get(pointer);
-		ogle->glNormalPointer(type , stride , pointer);
-	}
-	else if(strcmp(funcName, "glTexCoordPointer") == 0) {
-		GLint size; _args.Get(size);
-		GLenum type; _args.Get(type);
-		GLsizei stride; _args.Get(stride);
-		GLvoid *pointer; _args.Get(pointer);
-		ogle->glTexCoordPointer(size , type , stride , pointer);
-	}
-	else if(strcmp(funcName, "glInterleavedArrays") == 0) {
-		GLenum format; _args.Get(format);
-		GLsizei stride; _args.Get(stride);
-		GLvoid *pointer; _args.Get(pointer);
-		ogle->glInterleavedArrays(format , stride , pointer);
-	}
-	
-
-
-
-
-	/*
-	else if(strcmp(funcName, "gl") == 0) {
-		ogle->gl();
-	}
-	*/
-
-} 
-
-
-///////////////////////////////////////////////////////////////////////////////
-//
-void OGLEPlugin::GLFunctionPost(uint updateID, const char *funcName, uint funcIndex, const FunctionRetValue & retVal)
-{
-	FunctionRetValue _retVal(retVal);
-
-
-	if(isRecording || OGLE_CAPTURE_BUFFERS_ALL_FRAMES) {
-		if(strcmp(funcName, "glMapBuffer") == 0 
-				|| strcmp(funcName, "glMapBufferARB") == 0) {
-
-			GLvoid *retValue; _retVal.Get(retValue);
-			ogle->glMapBufferPost(retValue);
-		}
-	}
-
-
-	if(!isRecording) return;
-	
-	if(OGLE::config.logFunctions) {
-		char buff[1024];
-		gliCallBacks->GetGLReturnString(funcIndex, retVal, 1024, buff);
-		fprintf(OGLE::LOG, "\t%s (%d) returned: %s\n",funcName, funcIndex, buff);
-		fflush(OGLE::LOG);
-	}
-
-}
-
-
-///////////////////////////////////////////////////////////////////////////////
-//
-void OGLEPlugin::OnGLContextSet(HGLRC oldRCHandle, HGLRC newRCHandle)
-{
-//	fprintf(OGLE::LOG, "OP::OGLCS: %p, %p\n", oldRCHandle, newRCHandle);
-	if(newRCHandle) {
-		ogle->initFunctions();
-	}
-}
-
-
-///////////////////////////////////////////////////////////////////////////////
-//
-void OGLEPlugin::GLFrameEndPost(const char *funcName, uint funcIndex, const FunctionRetValue & retVal)
-{
-
-	
-	if(gliCallBacks->GetLoggerMode()) {
-		fprintf(OGLE::LOG, "Starting to record, to filename %s\n", objFileName.c_str()); fflush(OGLE::LOG);
-		isRecording = 1;
-		string fileName = objFileName;
-		unsigned int frame = gliCallBacks->GetFrameNumber();
-
-		if(filePerFrame) {
-			char buff[256];
-			sprintf(buff, ".%d", gliCallBacks->GetFrameNumber());
-			fileName.append(buff);
-		}
-		if(fileInFrameDir) {
-
-			string path;
-			StringPrintF(path,"Frame_%06u\\", frame);
-
-			path.append(fileName);
-
-			fileName = path;
-
-			fprintf(OGLE::LOG, "frame file: %s\n", fileName.c_str() ); 
-		}
-
-		fileName.append(".obj");
-		ogle->startRecording(fileName);
-	}
-
-#ifdef OGLE_GATHER_USELESS_FEEDBACK_BUFFER_DATA_TEST
-
-	if(gliCallBacks->GetLoggerMode()) {
-		fprintf(OGLE::LOG, "OP::GLFEPo: [%d] %s Logging: %d\n", gliCallBacks->GetFrameNumber(), funcName, gliCallBacks->GetLoggerMode()); 
-
-		buff = new OGLE::Buffer(0, 1000000  * sizeof(GLfloat));
-		fprintf(OGLE::LOG, "BUFFERING TO: %p\n", buff->ptr);
-		GLV->glFeedbackBuffer(buff->size / sizeof(GLfloat), GL_3D, (GLfloat *)buff->ptr);
-		GLV->glRenderMode(GL_FEEDBACK);
-		fflush(OGLE::LOG);
-
-		GLfloat *p = (GLfloat *)buff->ptr;
-	}
-#endif
-
-}
-
-
-///////////////////////////////////////////////////////////////////////////////
-//
-void OGLEPlugin::GLFrameEndPre(const char *funcName, uint funcIndex, const FunctionArgs & args )
-{
-	if(isRecording) {
-		fprintf(OGLE::LOG, "Done recording\n"); fflush(OGLE::LOG);
-		isRecording = 0;
-		ogle->stopRecording();
-	}
-
-
-#ifdef OGLE_GATHER_USELESS_FEEDBACK_BUFFER_DATA_TEST
-
-	if(gliCallBacks->GetLoggerMode()) {
-		fprintf(OGLE::LOG, "OP::GLFEPr: [%d] %s Logging: %d\n", gliCallBacks->GetFrameNumber(), funcName, gliCallBacks->GetLoggerMode()); 
-
-		int n = GLV->glRenderMode(GL_RENDER);
-		fprintf(OGLE::LOG, "GL RENDER MODE RETURNED: %d\n", n);
-		fflush(OGLE::LOG);
-		if(n > 0) {
-			FILE *DAT = fopen("ogle.dat", "w");
-			fwrite(buff->ptr, 1, n * sizeof(GLfloat), DAT);
-			fclose(DAT);
-
-			GLfloat *p = (GLfloat *)buff->ptr;
-			int i = 0;
-			while(i < buff->size / sizeof(GLfloat)) {
-				GLfloat tok = p[i++];
-				if(tok == GL_POLYGON_TOKEN) {
-					GLfloat n = p[i++];
-					fprintf(OGLE::LOG, "GOT POLY WITH %f VERT [%f]\n", n, OGLE::scale); fflush(OGLE::LOG);
-					OGLE::ElementSetPtr set = new OGLE::ElementSet(GL_POLYGON);
-					for(int j = 0; j < n; j++) {
-						OGLE::VertexPtr v = new OGLE::Vertex(p + i, 3);
-						fprintf(OGLE::LOG, "[%f, %f, %f]\n", p[i], p[i+1], p[i+2]);
-
-						set->addElement(v);
-						i += 3;
-					}
-					set->printToObj(ogle->objFile);
-					fflush(OGLE::LOG);
-				}
-			}
-
-		}
-	}
-#endif
-
-}
-
+#include "stdafx.h"
+#include "../../MainLib/InterceptPluginInterface.h"
+#include "OGLEPlugin.h"
+#include "ogle.h"
+#include "OutStream.h"
+#include "ObjFile.h"
+#include "CallLog.h"
+#include "Latency.h"
+#include "Trace.h"
+
+#include <ConfigParser.h>
+#include <CommonErrorLog.h>
+#include <MiscUtils.h>
+
+#include <algorithm>
+
+#include "Ptr/Ptr.in"
+
+USING_ERRORLOG
+
+//Path to the dll
+extern string dllPath;
+
+
+#include <string>
+
+//Include the common DLL code
+#include <PluginCommon.cpp>
+
+///////////////////////////////////////////////////////////////////////////////
+
+InterceptPluginInterface * GLIAPI CreateFunctionLogPlugin(const char *pluginName, InterceptPluginCallbacks * callBacks)
+{
+  //If no call backs, return NULL
+  if(callBacks == NULL)
+  {
+    return NULL;
+  }
+
+  //Assign the error logger
+  if(errorLog == NULL)
+  {
+    errorLog = callBacks->GetLogErrorFunction();
+  }
+
+  string cmpPluginName(pluginName);
+
+  //Test for the function status plugin
+  if(cmpPluginName == "OGLE")
+  {
+    return new OGLEPlugin(callBacks);
+  }
+
+  return NULL;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+void OGLEPlugin::ProcessConfigData(ConfigParser *parser)
+{
+  //Get if logging by call count
+  const ConfigToken *testToken = parser->GetToken("Scale");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.scale);
+	  fprintf(OGLE::LOG, "SCALE: %f\n", OGLE::config.scale);
+  }
+
+  testToken = parser->GetToken("CaptureNormals");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.captureNormals);
+	  fprintf(OGLE::LOG, "CAPTURE NORMALS: %d\n", OGLE::config.captureNormals);
+  }
+
+  testToken = parser->GetToken("CaptureColors");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.captureColors);
+	  fprintf(OGLE::LOG, "CAPTURE COLORS: %d\n", OGLE::config.captureColors);
+  }
+
+  testToken = parser->GetToken("CaptureTextureCoords");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.captureTexCoords);
+	  fprintf(OGLE::LOG, "CAPTURE TEX COORDS: %d\n", OGLE::config.captureTexCoords);
+  }
+
+
+  testToken = parser->GetToken("FlipPolygonStrips");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.flipPolyStrips);
+	  fprintf(OGLE::LOG, "FLIP POLY STRIPS: %d\n", OGLE::config.flipPolyStrips);
+  }
+
+
+  testToken = parser->GetToken("CoalesceDrawElements");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.coalesceDrawElements);
+	  fprintf(OGLE::LOG, "COALESCE DRAW ELEMENTS: %d\n", OGLE::config.coalesceDrawElements);
+  }
+
+
+  testToken = parser->GetToken("CoalesceSetElements");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.coalesceSetElements);
+	  fprintf(OGLE::LOG, "COALESCE SET ELEMENTS: %d\n", OGLE::config.coalesceSetElements);
+  }
+
+
+  testToken = parser->GetToken("SkipDuplicateDraws");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.skipDuplicateDraws);
+	  fprintf(OGLE::LOG, "SKIP DUPLICATE DRAWS: %d\n", OGLE::config.skipDuplicateDraws);
+  }
+
+
+  testToken = parser->GetToken("EncoderThreads");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.encoderThreads);
+	  fprintf(OGLE::LOG, "ENCODER THREADS: %d\n", OGLE::config.encoderThreads);
+  }
+
+
+  testToken = parser->GetToken("EncoderBatchSize");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.encoderBatchSize);
+	  fprintf(OGLE::LOG, "ENCODER BATCH SIZE: %d\n", OGLE::config.encoderBatchSize);
+  }
+
+
+  testToken = parser->GetToken("Compression");
+
+  if(testToken)
+  {
+	  string codec;
+	  testToken->Get(codec);
+	  OGLE::config.compression = OutStream::codecFromName(codec);
+	  fprintf(OGLE::LOG, "COMPRESSION: %s\n", OutStream::codecName((OutStream::Codec)OGLE::config.compression));
+  }
+
+
+  testToken = parser->GetToken("CompressionLevel");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.compressionLevel);
+	  fprintf(OGLE::LOG, "COMPRESSION LEVEL: %d\n", OGLE::config.compressionLevel);
+  }
+
+
+  testToken = parser->GetToken("CompressionThreads");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.compressionThreads);
+	  fprintf(OGLE::LOG, "COMPRESSION THREADS: %d\n", OGLE::config.compressionThreads);
+  }
+
+
+  testToken = parser->GetToken("CompressionBlockSize");
+
+  if(testToken)
+  {
+	  int kb;
+	  testToken->Get(kb);
+	  if(kb > 0) {
+		  OGLE::config.compressionBlockSize = kb * 1024;
+	  }
+	  fprintf(OGLE::LOG, "COMPRESSION BLOCK SIZE: %d\n", OGLE::config.compressionBlockSize);
+  }
+
+
+  testToken = parser->GetToken("BufferMemoryBudget");
+
+  if(testToken)
+  {
+	  int mb;
+	  testToken->Get(mb);
+	  OGLE::config.bufferBudget = (mb > 0 ? (size_t)mb << 20 : 0);
+	  fprintf(OGLE::LOG, "BUFFER MEMORY BUDGET: %d MB\n", mb);
+  }
+
+
+  testToken = parser->GetToken("BufferPoolSize");
+
+  if(testToken)
+  {
+	  int mb;
+	  testToken->Get(mb);
+	  OGLE::config.bufferPoolSize = (mb > 0 ? (size_t)mb << 20 : 0);
+	  BufferPool::maxPooledBytes = OGLE::config.bufferPoolSize;
+	  fprintf(OGLE::LOG, "BUFFER POOL SIZE: %d MB\n", mb);
+  }
+
+
+  testToken = parser->GetToken("InstanceTransformAttrib");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.instanceTransformAttrib);
+	  fprintf(OGLE::LOG, "INSTANCE TRANSFORM ATTRIB: %d\n", OGLE::config.instanceTransformAttrib);
+  }
+
+
+  testToken = parser->GetToken("PositionAttrib");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.positionAttrib);
+	  fprintf(OGLE::LOG, "POSITION ATTRIB: %d\n", OGLE::config.positionAttrib);
+  }
+
+  testToken = parser->GetToken("NormalAttrib");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.normalAttrib);
+	  fprintf(OGLE::LOG, "NORMAL ATTRIB: %d\n", OGLE::config.normalAttrib);
+  }
+
+  testToken = parser->GetToken("ColorAttrib");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.colorAttrib);
+	  fprintf(OGLE::LOG, "COLOR ATTRIB: %d\n", OGLE::config.colorAttrib);
+  }
+
+  testToken = parser->GetToken("TexCoordAttrib");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.texCoordAttrib);
+	  fprintf(OGLE::LOG, "TEXCOORD ATTRIB: %d\n", OGLE::config.texCoordAttrib);
+  }
+
+
+  // the matrix uniforms of shader based applications, by name
+  static const char *matrixTokens[OGLE::Program::N_MATRICES][2] = {
+	  { "ModelMatrixUniform", "ModelMatrixOffset" },
+	  { "ViewMatrixUniform", "ViewMatrixOffset" },
+	  { "ModelViewMatrixUniform", "ModelViewMatrixOffset" }
+  };
+
+  for(int k = 0; k < OGLE::Program::N_MATRICES; k++) {
+	  testToken = parser->GetToken(matrixTokens[k][0]);
+
+	  if(testToken)
+	  {
+		  testToken->Get(OGLE::config.matrixUniforms[k]);
+		  fprintf(OGLE::LOG, "%s: %s\n", matrixTokens[k][0], OGLE::config.matrixUniforms[k].c_str());
+	  }
+
+	  testToken = parser->GetToken(matrixTokens[k][1]);
+
+	  if(testToken)
+	  {
+		  testToken->Get(OGLE::config.matrixBlockOffsets[k]);
+		  fprintf(OGLE::LOG, "%s: %d\n", matrixTokens[k][1], OGLE::config.matrixBlockOffsets[k]);
+	  }
+  }
+
+  testToken = parser->GetToken("BoneIndexAttrib");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.boneIndexAttrib);
+	  fprintf(OGLE::LOG, "BONE INDEX ATTRIB: %d\n", OGLE::config.boneIndexAttrib);
+  }
+
+  testToken = parser->GetToken("BoneWeightAttrib");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.boneWeightAttrib);
+	  fprintf(OGLE::LOG, "BONE WEIGHT ATTRIB: %d\n", OGLE::config.boneWeightAttrib);
+  }
+
+  testToken = parser->GetToken("BonePaletteUniform");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.bonePaletteUniform);
+	  fprintf(OGLE::LOG, "BONE PALETTE UNIFORM: %s\n", OGLE::config.bonePaletteUniform.c_str());
+  }
+
+  testToken = parser->GetToken("SkinningThreads");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.skinningThreads);
+	  fprintf(OGLE::LOG, "SKINNING THREADS: %d\n", OGLE::config.skinningThreads);
+  }
+
+
+  testToken = parser->GetToken("MatrixBlockBinding");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.matrixBlockBinding);
+	  fprintf(OGLE::LOG, "MATRIX BLOCK BINDING: %d\n", OGLE::config.matrixBlockBinding);
+  }
+
+
+  testToken = parser->GetToken("FeedbackCapture");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.feedbackCapture);
+	  fprintf(OGLE::LOG, "FEEDBACK CAPTURE: %d\n", OGLE::config.feedbackCapture);
+  }
+
+  testToken = parser->GetToken("FeedbackBufferSize");
+
+  if(testToken)
+  {
+	  int mb;
+	  testToken->Get(mb);
+	  if(mb > 0) {
+		  OGLE::config.feedbackBufferSize = (size_t)mb << 20;
+	  }
+	  fprintf(OGLE::LOG, "FEEDBACK BUFFER SIZE: %d MB\n", mb);
+  }
+
+  testToken = parser->GetToken("FlightRecorderFrames");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.flightFrames);
+	  fprintf(OGLE::LOG, "FLIGHT RECORDER FRAMES: %d\n", OGLE::config.flightFrames);
+  }
+
+  testToken = parser->GetToken("FlightRecorderArenaSize");
+
+  if(testToken)
+  {
+	  int mb;
+	  testToken->Get(mb);
+	  if(mb > 0) {
+		  OGLE::config.flightArenaSize = (size_t)mb << 20;
+	  }
+	  fprintf(OGLE::LOG, "FLIGHT RECORDER ARENA SIZE: %d MB\n", mb);
+  }
+
+  testToken = parser->GetToken("CaptureBudget");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.captureBudget);
+	  fprintf(OGLE::LOG, "CAPTURE BUDGET: %.2f ms\n", OGLE::config.captureBudget);
+  }
+
+
+  testToken = parser->GetToken("LogFunctions");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.logFunctions);
+	  fprintf(OGLE::LOG, "LOG FUNCTIONS: %d\n", OGLE::config.logFunctions);
+  }
+
+  testToken = parser->GetToken("LogFunctionsBinary");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.logFunctionsBinary);
+	  fprintf(OGLE::LOG, "LOG FUNCTIONS BINARY: %d\n", OGLE::config.logFunctionsBinary);
+  }
+
+
+  testToken = parser->GetToken("LatencyHistograms");
+
+  if(testToken)
+  {
+	  testToken->Get(OGLE::config.latencyHistograms);
+	  fprintf(OGLE::LOG, "LATENCY HISTOGRAMS: %d\n", OGLE::config.latencyHistograms);
+  }
+
+
+  testToken = parser->GetToken("ObjFileName");
+
+  if(testToken)
+  {
+	  testToken->Get(objFileName);
+	  int pos;
+	  if((pos = objFileName.find(".obj", objFileName.size() - 4)) == (objFileName.size() - 4)) {
+		  objFileName = objFileName.substr(0, objFileName.size() - 4);
+	  }
+
+
+	  fprintf(OGLE::LOG, "OBJFileName: %s\n", objFileName.c_str());
+  }
+
+  testToken = parser->GetToken("FilePerFrame");
+
+  if(testToken)
+  {
+	  testToken->Get(filePerFrame);
+	  fprintf(OGLE::LOG, "FilePerFrame: %d\n", filePerFrame);
+  }
+
+  testToken = parser->GetToken("FileInFrameDir");
+
+  if(testToken)
+  {
+	  testToken->Get(fileInFrameDir);
+	  fprintf(OGLE::LOG, "FileInFrameDir: %d\n", fileInFrameDir);
+  }
+
+
+
+
+  for(int i = 0; i < OGLE::Config::nPolyTypes; i++) {
+	  const char *type = OGLE::Config::polyTypes[i];
+
+	  testToken = parser->GetToken(type);
+
+	  if(testToken)
+	  {
+		  bool tmp;
+		  testToken->Get(tmp);
+		  OGLE::config.polyTypesEnabled[type] = tmp;
+		  fprintf(OGLE::LOG, "%s: %d\n", type, tmp);
+	  }
+  }
+
+  fflush(OGLE::LOG);
+
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+OGLEPlugin::OGLEPlugin(InterceptPluginCallbacks *callBacks):
+gliCallBacks(callBacks),
+GLV(callBacks->GetCoreGLFunctions()),
+objFileName("ogle"),
+filePerFrame(0),
+fileInFrameDir(0),
+isRecording(0),
+flightTriggered(0),
+nCompilingLists(0)
+{
+  InitializeCriticalSection(&contextsLock);
+  currentSlot = TlsAlloc();
+  memset((void *)funcFlags, 0, sizeof(funcFlags));
+
+/**/
+  gliCallBacks->RegisterGLFunction("glBegin");
+  gliCallBacks->RegisterGLFunction("glEnd");
+  gliCallBacks->RegisterGLFunction("glArrayElement");
+  gliCallBacks->RegisterGLFunction("glVertex3fv");
+  gliCallBacks->RegisterGLFunction("glVertex3f");
+  gliCallBacks->RegisterGLFunction("glVertex3dv");
+  gliCallBacks->RegisterGLFunction("glVertex3d");
+  gliCallBacks->RegisterGLFunction("glNormal3fv");
+  gliCallBacks->RegisterGLFunction("glNormal3f");
+  gliCallBacks->RegisterGLFunction("glColor3fv");
+  gliCallBacks->RegisterGLFunction("glColor3f");
+  gliCallBacks->RegisterGLFunction("glColor4fv");
+  gliCallBacks->RegisterGLFunction("glColor4f");
+  gliCallBacks->RegisterGLFunction("glColor3ubv");
+  gliCallBacks->RegisterGLFunction("glColor3ub");
+  gliCallBacks->RegisterGLFunction("glColor4ubv");
+  gliCallBacks->RegisterGLFunction("glColor4ub");
+  gliCallBacks->RegisterGLFunction("glTexCoord2fv");
+  gliCallBacks->RegisterGLFunction("glTexCoord3fv");
+  gliCallBacks->RegisterGLFunction("glTexCoord2f");
+  gliCallBacks->RegisterGLFunction("glTexCoord3f");
+  gliCallBacks->RegisterGLFunction("glClientActiveTexture");
+  gliCallBacks->RegisterGLFunction("glClientActiveTextureARB");
+
+
+  gliCallBacks->RegisterGLFunction("glEnableClientState");
+  gliCallBacks->RegisterGLFunction("glDisableClientState");
+  gliCallBacks->RegisterGLFunction("glVertexPointer");
+  gliCallBacks->RegisterGLFunction("glNormalPointer");
+  gliCallBacks->RegisterGLFunction("glColorPointer");
+  gliCallBacks->RegisterGLFunction("glTexCoordPointer");
+  gliCallBacks->RegisterGLFunction("glDrawArrays");
+  gliCallBacks->RegisterGLFunction("glDrawElements");
+
+  gliCallBacks->RegisterGLFunction("glInterleavedArrays");
+
+
+  gliCallBacks->RegisterGLFunction("glDrawRangeElements");
+  gliCallBacks->RegisterGLFunction("glDrawRangeElementsEXT");
+  gliCallBacks->RegisterGLFunction("glDrawElementsBaseVertex");
+  gliCallBacks->RegisterGLFunction("glDrawRangeElementsBaseVertex");
+  gliCallBacks->RegisterGLFunction("glMultiDrawArrays");
+  gliCallBacks->RegisterGLFunction("glMultiDrawArraysEXT");
+  gliCallBacks->RegisterGLFunction("glMultiDrawElements");
+  gliCallBacks->RegisterGLFunction("glMultiDrawElementsEXT");
+  gliCallBacks->RegisterGLFunction("glMultiDrawElementsBaseVertex");
+  gliCallBacks->RegisterGLFunction("glDrawArraysIndirect");
+  gliCallBacks->RegisterGLFunction("glDrawElementsIndirect");
+  gliCallBacks->RegisterGLFunction("glMultiDrawArraysIndirect");
+  gliCallBacks->RegisterGLFunction("glMultiDrawElementsIndirect");
+  gliCallBacks->RegisterGLFunction("glDrawArraysInstanced");
+  gliCallBacks->RegisterGLFunction("glDrawArraysInstancedARB");
+  gliCallBacks->RegisterGLFunction("glDrawArraysInstancedEXT");
+  gliCallBacks->RegisterGLFunction("glDrawElementsInstanced");
+  gliCallBacks->RegisterGLFunction("glDrawElementsInstancedARB");
+  gliCallBacks->RegisterGLFunction("glDrawElementsInstancedEXT");
+
+  gliCallBacks->RegisterGLFunction("glVertexAttribPointer");
+  gliCallBacks->RegisterGLFunction("glVertexAttribPointerARB");
+  gliCallBacks->RegisterGLFunction("glVertexAttribIPointer");
+  gliCallBacks->RegisterGLFunction("glVertexAttribIPointerEXT");
+  gliCallBacks->RegisterGLFunction("glEnableVertexAttribArray");
+  gliCallBacks->RegisterGLFunction("glEnableVertexAttribArrayARB");
+  gliCallBacks->RegisterGLFunction("glDisableVertexAttribArray");
+  gliCallBacks->RegisterGLFunction("glDisableVertexAttribArrayARB");
+  gliCallBacks->RegisterGLFunction("glVertexAttribDivisor");
+  gliCallBacks->RegisterGLFunction("glVertexAttribDivisorARB");
+  gliCallBacks->RegisterGLFunction("glBindVertexArray");
+  gliCallBacks->RegisterGLFunction("glDeleteVertexArrays");
+
+  gliCallBacks->RegisterGLFunction("glLockArraysEXT");
+  gliCallBacks->RegisterGLFunction("glUnlockArraysEXT");
+
+  gliCallBacks->RegisterGLFunction("glBindBuffer");
+  gliCallBacks->RegisterGLFunction("glBindBufferARB");
+  gliCallBacks->RegisterGLFunction("glBufferData");
+  gliCallBacks->RegisterGLFunction("glBufferDataARB");
+  gliCallBacks->RegisterGLFunction("glDeleteBuffers");
+  gliCallBacks->RegisterGLFunction("glDeleteBuffersARB");
+  gliCallBacks->RegisterGLFunction("glBufferSubData");
+  gliCallBacks->RegisterGLFunction("glBufferSubDataARB");
+  gliCallBacks->RegisterGLFunction("glMapBuffer");
+  gliCallBacks->RegisterGLFunction("glMapBufferARB");
+  gliCallBacks->RegisterGLFunction("glUnmapBuffer");
+  gliCallBacks->RegisterGLFunction("glUnmapBufferARB");
+  gliCallBacks->RegisterGLFunction("glMapBufferRange");
+  gliCallBacks->RegisterGLFunction("glFlushMappedBufferRange");
+  gliCallBacks->RegisterGLFunction("glBufferStorage");
+  gliCallBacks->RegisterGLFunction("glBindBufferBase");
+  gliCallBacks->RegisterGLFunction("glBindBufferRange");
+  gliCallBacks->RegisterGLFunction("glCopyBufferSubData");
+  gliCallBacks->RegisterGLFunction("glCopyNamedBufferSubData");
+  gliCallBacks->RegisterGLFunction("glClearBufferData");
+  gliCallBacks->RegisterGLFunction("glClearBufferSubData");
+  gliCallBacks->RegisterGLFunction("glTexBuffer");
+  gliCallBacks->RegisterGLFunction("glTexBufferARB");
+  gliCallBacks->RegisterGLFunction("glTexBufferEXT");
+  gliCallBacks->RegisterGLFunction("glTexBufferRange");
+
+  gliCallBacks->RegisterGLFunction("glUseProgram");
+  gliCallBacks->RegisterGLFunction("glUseProgramObjectARB");
+  gliCallBacks->RegisterGLFunction("glLinkProgram");
+  gliCallBacks->RegisterGLFunction("glLinkProgramARB");
+  gliCallBacks->RegisterGLFunction("glDeleteProgram");
+  gliCallBacks->RegisterGLFunction("glGetUniformLocation");
+  gliCallBacks->RegisterGLFunction("glGetUniformLocationARB");
+  gliCallBacks->RegisterGLFunction("glUniformMatrix4fv");
+  gliCallBacks->RegisterGLFunction("glUniformMatrix4fvARB");
+  gliCallBacks->RegisterGLFunction("glProgramUniformMatrix4fv");
+  gliCallBacks->RegisterGLFunction("glProgramUniformMatrix4fvEXT");
+
+  gliCallBacks->RegisterGLFunction("glNewList");
+  gliCallBacks->RegisterGLFunction("glEndList");
+  gliCallBacks->RegisterGLFunction("glCallList");
+  gliCallBacks->RegisterGLFunction("glCallLists");
+  gliCallBacks->RegisterGLFunction("glListBase");
+  gliCallBacks->RegisterGLFunction("glDeleteLists");
+/**/
+  
+  //Get calls that are even outside contexts  
+  gliCallBacks->SetContextFunctionCalls(true);
+
+  //Parse the config file
+  ConfigParser fileParser;
+  if(fileParser.Parse(dllPath + "config.ini"))
+  {
+    ProcessConfigData(&fileParser);
+    fileParser.LogUnusedTokens(); 
+  }
+
+  //Parse the config string
+  ConfigParser stringParser;
+  if(stringParser.ParseString(gliCallBacks->GetConfigString()))
+  {
+    ProcessConfigData(&stringParser);
+    stringParser.LogUnusedTokens(); 
+  }
+
+  if(OGLE::config.flightFrames > 0 && !OGLE::config.feedbackCapture) {
+    flight = new OGLE::FlightRecorder(OGLE::config.flightFrames, OGLE::config.flightArenaSize);
+  }
+
+  if(OGLE::config.captureBudget > 0 && !OGLE::config.feedbackCapture) {
+    governor = new OGLE::Governor(OGLE::config.captureBudget);
+  }
+
+  if(OGLE::config.logFunctions && OGLE::config.logFunctionsBinary) {
+    callLog = new CallLog("ogle.calls");
+    if(!callLog->isOpen()) {
+      callLog = 0;
+    }
+  }
+
+  if(OGLE::config.latencyHistograms) {
+    latency = new Latency();
+  }
+
+  contexts[0] = new OGLE(callBacks, callBacks->GetCoreGLFunctions());
+  contexts[0]->flight = flight;
+  contexts[0]->governor = governor;
+  defaultContext = contexts[0].rawPtr();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+
+void OGLEPlugin::Destroy()
+{
+  delete this;
+}
+
+OGLEPlugin::~OGLEPlugin()
+{
+  TlsFree(currentSlot);
+  DeleteCriticalSection(&contextsLock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Charges the time a recording context spends in the plugin to the
+//  flight recorder's current frame and the governor's.
+//
+class CaptureTimer
+{
+public:
+  CaptureTimer(OGLE *ogle) : rec(0), governor(0)
+  {
+    if(ogle->isRecording()) {
+      rec = ogle->flight.rawPtr();
+      governor = ogle->governor.rawPtr();
+    }
+    if(rec || governor) QueryPerformanceCounter(&start);
+  }
+
+  ~CaptureTimer()
+  {
+    if(rec || governor) {
+      LARGE_INTEGER end;
+      QueryPerformanceCounter(&end);
+      if(rec) rec->addTicks(end.QuadPart - start.QuadPart);
+      if(governor) governor->addTicks(end.QuadPart - start.QuadPart);
+    }
+  }
+
+private:
+  OGLE::FlightRecorder *rec;
+  OGLE::Governor *governor;
+  LARGE_INTEGER start;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Adds the whole time a call spends in the plugin, early outs and all,
+//  to its latency histogram.
+//
+class LatencyTimer
+{
+public:
+  LatencyTimer(Latency *_latency, uint _funcIndex, const char *_funcName, bool recording) :
+    latency(_latency), funcIndex(_funcIndex), funcName(_funcName),
+    state(recording ? Latency::RECORDING : Latency::IDLE)
+  {
+    if(latency) QueryPerformanceCounter(&start);
+  }
+
+  ~LatencyTimer()
+  {
+    if(latency) {
+      LARGE_INTEGER end;
+      QueryPerformanceCounter(&end);
+      latency->add(funcIndex, funcName, state, end.QuadPart - start.QuadPart);
+    }
+  }
+
+private:
+  Latency *latency;
+  uint funcIndex;
+  const char *funcName;
+  int state;
+  LARGE_INTEGER start;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  The functions whose state is followed whether or not a frame is being
+//  recorded, and those with work to do after the call.  Every other
+//  registered function is geometry.
+//
+static const char *stateFunctions[] = {
+  "glBindBuffer", "glBindBufferARB", "glBufferData", "glBufferDataARB",
+  "glDeleteBuffers", "glDeleteBuffersARB", "glBufferSubData", "glBufferSubDataARB",
+  "glMapBuffer", "glMapBufferARB", "glMapBufferRange", "glFlushMappedBufferRange",
+  "glBufferStorage", "glUnmapBuffer", "glUnmapBufferARB",
+  "glVertexAttribPointer", "glVertexAttribPointerARB",
+  "glVertexAttribIPointer", "glVertexAttribIPointerEXT",
+  "glEnableVertexAttribArray", "glEnableVertexAttribArrayARB",
+  "glDisableVertexAttribArray", "glDisableVertexAttribArrayARB",
+  "glVertexAttribDivisor", "glVertexAttribDivisorARB",
+  "glBindVertexArray", "glDeleteVertexArrays",
+  "glBindBufferBase", "glBindBufferRange",
+  "glCopyBufferSubData", "glCopyNamedBufferSubData",
+  "glClearBufferData", "glClearBufferSubData",
+  "glTexBuffer", "glTexBufferARB", "glTexBufferEXT", "glTexBufferRange",
+  "glUseProgram", "glUseProgramObjectARB", "glLinkProgram", "glLinkProgramARB",
+  "glDeleteProgram", "glGetUniformLocation", "glGetUniformLocationARB",
+  "glUniformMatrix4fv", "glUniformMatrix4fvARB",
+  "glProgramUniformMatrix4fv", "glProgramUniformMatrix4fvEXT",
+  "glNewList", "glEndList", "glListBase", "glDeleteLists",
+};
+
+static const char *postFunctions[] = {
+  "glMapBuffer", "glMapBufferARB", "glMapBufferRange",
+  "glGetUniformLocation", "glGetUniformLocationARB",
+};
+
+int OGLEPlugin::classifyFunction(const char *funcName)
+{
+  int flags = FUNC_SEEN | FUNC_GEOMETRY;
+
+  for(int i = 0; i < sizeof(stateFunctions) / sizeof(stateFunctions[0]); i++) {
+    if(strcmp(funcName, stateFunctions[i]) == 0) {
+      flags = FUNC_SEEN | FUNC_STATE;
+      break;
+    }
+  }
+
+  for(int i = 0; i < sizeof(postFunctions) / sizeof(postFunctions[0]); i++) {
+    if(strcmp(funcName, postFunctions[i]) == 0) {
+      flags |= FUNC_POST;
+      break;
+    }
+  }
+
+  return flags;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+void OGLEPlugin::GLFunctionPre (uint updateID, const char *funcName, uint funcIndex, const FunctionArgs & args )
+{
+	// with the histograms off not even the timer is set up
+	if(latency) {
+		LatencyTimer latencyTimer(latency.rawPtr(), funcIndex, funcName, recording.isActive() || flight.rawPtr());
+		if(!skipPre(funcIndex, funcName)) {
+			functionPre(funcName, funcIndex, args);
+		}
+	}
+	else if(!skipPre(funcIndex, funcName)) {
+		functionPre(funcName, funcIndex, args);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  The rest of GLFunctionPre, for the calls skipPre does not let through.
+//  Kept out of line so that the ones it does never set up its frame.
+//
+void OGLEPlugin::functionPre(const char *funcName, uint funcIndex, const FunctionArgs & args)
+{
+	int flags = functionFlags(funcIndex, funcName);
+
+	TRACE_ZONE(funcName);
+
+	OGLE *ogle = currentContext();
+	CaptureTimer timer(ogle);
+	OGLE::ShareGroup::Lock lock(ogle->shared.rawPtr());
+
+	// whether this thread's context is recording
+	bool isRecording = ogle->isRecording();
+
+	//Create a access copy of the arguments
+	FunctionArgs _args(args);
+
+	if((flags & FUNC_STATE) && (isRecording || OGLE_BIND_BUFFERS_ALL_FRAMES)) {
+		// do these always, because sometimes data buffers get set up in earlier frames
+		if(strcmp(funcName, "glBindBuffer") == 0 
+			|| strcmp(funcName, "glBindBufferARB") == 0) {
+			GLenum  target; _args.Get(target);
+			GLuint  buffer; _args.Get(buffer);
+			ogle->glBindBuffer(target , buffer);
+		}
+		else if(strcmp(funcName, "glBufferData") == 0
+				|| strcmp(funcName, "glBufferDataARB") == 0) {
+			GLenum  target; _args.Get(target);
+			GLsizei size; _args.Get(size);
+			GLvoid * data; _args.Get(data);
+			GLenum  usage; _args.Get(usage);
+			ogle->glBufferData(target , size , data , usage);
+		}
+		else if(strcmp(funcName, "glDeleteBuffers") == 0
+				|| strcmp(funcName, "glDeleteBuffersARB") == 0) {
+			GLsizei n; _args.Get(n);
+			GLuint *buffers; _args.Get(buffers);
+			ogle->glDeleteBuffers(n , buffers);
+		}
+		// outside a recording these only bump the buffer's generation,
+		// so the next recorded draw knows to fetch it again
+		else if(strcmp(funcName, "glBufferSubData") == 0
+				|| strcmp(funcName, "glBufferSubDataARB") == 0) {
+			GLenum  target; _args.Get(target);
+			GLint offset; _args.Get(offset);
+			GLsizei  size; _args.Get(size);
+			GLvoid * data; _args.Get(data);
+			ogle->glBufferSubData(target , offset , size , data);
+		}
+		else if(strcmp(funcName, "glMapBuffer") == 0 
+				|| strcmp(funcName, "glMapBufferARB") == 0) {
+			GLenum  target; _args.Get(target);
+			GLenum  access; _args.Get(access);
+			ogle->glMapBuffer(target , access);
+		}
+		else if(strcmp(funcName, "glMapBufferRange") == 0) {
+			GLenum  target; _args.Get(target);
+			GLintptr offset; _args.Get(offset);
+			GLsizeiptr length; _args.Get(length);
+			GLbitfield access; _args.Get(access);
+			ogle->glMapBufferRange(target , offset , length , access);
+		}
+		else if(strcmp(funcName, "glFlushMappedBufferRange") == 0) {
+			GLenum  target; _args.Get(target);
+			GLintptr offset; _args.Get(offset);
+			GLsizeiptr length; _args.Get(length);
+			ogle->glFlushMappedBufferRange(target , offset , length);
+		}
+		else if(strcmp(funcName, "glBufferStorage") == 0) {
+			GLenum  target; _args.Get(target);
+			GLsizeiptr size; _args.Get(size);
+			GLvoid * data; _args.Get(data);
+			GLbitfield flags; _args.Get(flags);
+			ogle->glBufferStorage(target , size , data , flags);
+		}
+		else if(strcmp(funcName, "glUnmapBuffer") == 0 
+				|| strcmp(funcName, "glUnmapBufferARB") == 0) {
+			GLenum  target; _args.Get(target);
+			ogle->glUnmapBuffer(target);
+		}
+		// written by the GPU, so the shadows go stale
+		else if(strcmp(funcName, "glCopyBufferSubData") == 0) {
+			GLenum  readTarget; _args.Get(readTarget);
+			GLenum  writeTarget; _args.Get(writeTarget);
+			GLintptr readOffset; _args.Get(readOffset);
+			GLintptr writeOffset; _args.Get(writeOffset);
+			GLsizeiptr size; _args.Get(size);
+			ogle->glCopyBufferSubData(readTarget , writeTarget , readOffset , writeOffset , size);
+		}
+		else if(strcmp(funcName, "glCopyNamedBufferSubData") == 0) {
+			GLuint  readBuffer; _args.Get(readBuffer);
+			GLuint  writeBuffer; _args.Get(writeBuffer);
+			GLintptr readOffset; _args.Get(readOffset);
+			GLintptr writeOffset; _args.Get(writeOffset);
+			GLsizeiptr size; _args.Get(size);
+			ogle->glCopyNamedBufferSubData(readBuffer , writeBuffer , readOffset , writeOffset , size);
+		}
+		else if(strcmp(funcName, "glClearBufferData") == 0) {
+			GLenum  target; _args.Get(target);
+			GLenum  internalformat; _args.Get(internalformat);
+			GLenum  format; _args.Get(format);
+			GLenum  type; _args.Get(type);
+			GLvoid * data; _args.Get(data);
+			ogle->glClearBufferData(target , internalformat , format , type , data);
+		}
+		else if(strcmp(funcName, "glClearBufferSubData") == 0) {
+			GLenum  target; _args.Get(target);
+			GLenum  internalformat; _args.Get(internalformat);
+			GLintptr offset; _args.Get(offset);
+			GLsizeiptr size; _args.Get(size);
+			GLenum  format; _args.Get(format);
+			GLenum  type; _args.Get(type);
+			GLvoid * data; _args.Get(data);
+			ogle->glClearBufferSubData(target , internalformat , offset , size , format , type , data);
+		}
+		else if(strcmp(funcName, "glTexBuffer") == 0
+				|| strcmp(funcName, "glTexBufferARB") == 0
+				|| strcmp(funcName, "glTexBufferEXT") == 0
+				|| strcmp(funcName, "glTexBufferRange") == 0) {
+			GLenum  target; _args.Get(target);
+			GLenum  internalformat; _args.Get(internalformat);
+			GLuint  buffer; _args.Get(buffer);
+			ogle->glTexBuffer(target , internalformat , buffer);
+		}
+		// generic attribute arrays are usually set up once, at load time
+		else if(strcmp(funcName, "glVertexAttribPointer") == 0
+				|| strcmp(funcName, "glVertexAttribPointerARB") == 0) {
+			GLuint  index; _args.Get(index);
+			GLint  size; _args.Get(size);
+			GLenum  type; _args.Get(type);
+			GLboolean  normalized; _args.Get(normalized);
+			GLsizei  stride; _args.Get(stride);
+			GLvoid * pointer; _args.Get(pointer);
+			ogle->glVertexAttribPointer(index , size , type , normalized , stride , pointer);
+		}
+		// integer attributes, bone indices mostly
+		else if(strcmp(funcName, "glVertexAttribIPointer") == 0
+				|| strcmp(funcName, "glVertexAttribIPointerEXT") == 0) {
+			GLuint  index; _args.Get(index);
+			GLint  size; _args.Get(size);
+			GLenum  type; _args.Get(type);
+			GLsizei  stride; _args.Get(stride);
+			GLvoid * pointer; _args.Get(pointer);
+			ogle->glVertexAttribPointer(index , size , type , GL_FALSE , stride , pointer);
+		}
+		else if(strcmp(funcName, "glEnableVertexAttribArray") == 0
+				|| strcmp(funcName, "glEnableVertexAttribArrayARB") == 0) {
+			GLuint  index; _args.Get(index);
+			ogle->glEnableVertexAttribArray(index);
+		}
+		else if(strcmp(funcName, "glDisableVertexAttribArray") == 0
+				|| strcmp(funcName, "glDisableVertexAttribArrayARB") == 0) {
+			GLuint  index; _args.Get(index);
+			ogle->glDisableVertexAttribArray(index);
+		}
+		else if(strcmp(funcName, "glVertexAttribDivisor") == 0
+				|| strcmp(funcName, "glVertexAttribDivisorARB") == 0) {
+			GLuint  index; _args.Get(index);
+			GLuint  divisor; _args.Get(divisor);
+			ogle->glVertexAttribDivisor(index , divisor);
+		}
+		else if(strcmp(funcName, "glBindVertexArray") == 0) {
+			GLuint  array; _args.Get(array);
+			ogle->glBindVertexArray(array);
+		}
+		else if(strcmp(funcName, "glDeleteVertexArrays") == 0) {
+			GLsizei n; _args.Get(n);
+			GLuint *arrays; _args.Get(arrays);
+			ogle->glDeleteVertexArrays(n , arrays);
+		}
+		else if(strcmp(funcName, "glBindBufferBase") == 0) {
+			GLenum  target; _args.Get(target);
+			GLuint  index; _args.Get(index);
+			GLuint  buffer; _args.Get(buffer);
+			ogle->glBindBufferBase(target , index , buffer);
+		}
+		else if(strcmp(funcName, "glBindBufferRange") == 0) {
+			GLenum  target; _args.Get(target);
+			GLuint  index; _args.Get(index);
+			GLuint  buffer; _args.Get(buffer);
+			GLintptr offset; _args.Get(offset);
+			GLsizeiptr size; _args.Get(size);
+			ogle->glBindBufferRange(target , index , buffer , offset , size);
+		}
+		// uniforms keep their values from frame to frame, so shader
+		// transforms have to be followed all along
+		else if(strcmp(funcName, "glUseProgram") == 0
+				|| strcmp(funcName, "glUseProgramObjectARB") == 0) {
+			GLuint  program; _args.Get(program);
+			ogle->glUseProgram(program);
+		}
+		else if(strcmp(funcName, "glLinkProgram") == 0
+				|| strcmp(funcName, "glLinkProgramARB") == 0) {
+			GLuint  program; _args.Get(program);
+			ogle->glLinkProgram(program);
+		}
+		else if(strcmp(funcName, "glDeleteProgram") == 0) {
+			GLuint  program; _args.Get(program);
+			ogle->glDeleteProgram(program);
+		}
+		else if(strcmp(funcName, "glGetUniformLocation") == 0
+				|| strcmp(funcName, "glGetUniformLocationARB") == 0) {
+			GLuint  program; _args.Get(program);
+			GLvoid * name; _args.Get(name);
+			ogle->glGetUniformLocation(program , (const char *)name);
+		}
+		else if(strcmp(funcName, "glUniformMatrix4fv") == 0
+				|| strcmp(funcName, "glUniformMatrix4fvARB") == 0) {
+			GLint  location; _args.Get(location);
+			GLsizei  count; _args.Get(count);
+			GLboolean  transpose; _args.Get(transpose);
+			GLfloat * value; _args.Get(value);
+			ogle->glUniformMatrix4fv(location , count , transpose , value);
+		}
+		else if(strcmp(funcName, "glProgramUniformMatrix4fv") == 0
+				|| strcmp(funcName, "glProgramUniformMatrix4fvEXT") == 0) {
+			GLuint  program; _args.Get(program);
+			GLint  location; _args.Get(location);
+			GLsizei  count; _args.Get(count);
+			GLboolean  transpose; _args.Get(transpose);
+			GLfloat * value; _args.Get(value);
+			ogle->glProgramUniformMatrix4fv(program , location , count , transpose , value);
+		}
+	}
+
+	// display lists are usually compiled long before the recorded frame
+	if(flags & FUNC_STATE) {
+		if(strcmp(funcName, "glNewList") == 0) {
+			GLuint list; _args.Get(list);
+			GLenum mode; _args.Get(mode);
+			bool compiling = ogle->isCompilingList();
+			ogle->glNewList(list , mode);
+			if(!compiling && ogle->isCompilingList()) {
+				InterlockedIncrement(&nCompilingLists);
+			}
+		}
+		else if(strcmp(funcName, "glEndList") == 0) {
+			bool compiling = ogle->isCompilingList();
+			ogle->glEndList();
+			if(compiling && !ogle->isCompilingList()) {
+				InterlockedDecrement(&nCompilingLists);
+			}
+		}
+		else if(strcmp(funcName, "glListBase") == 0) {
+			GLuint base; _args.Get(base);
+			ogle->glListBase(base);
+		}
+		else if(strcmp(funcName, "glDeleteLists") == 0) {
+			GLuint list; _args.Get(list);
+			GLsizei range; _args.Get(range);
+			ogle->glDeleteLists(list , range);
+		}
+	}
+
+	// while a list is being compiled its geometry calls are wanted
+	// whether or not this frame is being recorded
+	if(!isRecording && !ogle->isCompilingList()) return;
+	
+	if(isRecording && callLog) {
+		callLog->logPre(funcIndex, funcName, args);
+	}
+	else if(isRecording && OGLE::config.logFunctions) {
+		char buff[1024];
+		gliCallBacks->GetGLArgString(funcIndex, args, 1024, buff);
+		fprintf(OGLE::LOG, "PRE FUNCTION (%d): %s\n", funcIndex, buff);
+		fflush(OGLE::LOG);
+	}
+
+	if(!(flags & FUNC_GEOMETRY)) return;
+
+	if(strcmp(funcName, "glDrawElements") == 0) {
+		GLenum mode; _args.Get(mode);
+		GLsizei count; _args.Get(count);
+		GLenum type; _args.Get(type);
+		GLvoid *indices; _args.Get(indices);
+		ogle->glDrawElements(mode , count , type , indices);
+	}
+	else if(strcmp(funcName, "glDrawArrays") == 0) {
+		GLenum mode; _args.Get(mode);
+		GLint first; _args.Get(first);
+		GLsizei count; _args.Get(count);
+		ogle->glDrawArrays(mode , first , count);
+	}
+	else if(strcmp(funcName, "glLockArraysEXT") == 0) {
+		GLint first; _args.Get(first);
+		GLsizei count; _args.Get(count);
+		ogle->glLockArraysEXT(first, count);
+	}
+	else if(strcmp(funcName, "glUnlockArraysEXT") == 0) {
+		ogle->glUnlockArraysEXT();
+	}
+	else if(strcmp(funcName, "glDrawRangeElements") == 0
+			|| strcmp(funcName, "glDrawRangeElementsEXT") == 0
+			) {
+		GLenum  mode; _args.Get(mode);
+		GLuint  start; _args.Get(start);
+		GLuint  end; _args.Get(end);
+		GLsizei  count; _args.Get(count);
+		GLenum  type; _args.Get(type);
+		GLvoid * indices; _args.Get(indices);
+		ogle->glDrawRangeElements(mode , start , end , count , type , indices);
+	}
+	else if(strcmp(funcName, "glDrawElementsBaseVertex") == 0) {
+		GLenum  mode; _args.Get(mode);
+		GLsizei  count; _args.Get(count);
+		GLenum  type; _args.Get(type);
+		GLvoid * indices; _args.Get(indices);
+		GLint  basevertex; _args.Get(basevertex);
+		ogle->glDrawElementsBaseVertex(mode , count , type , indices , basevertex);
+	}
+	else if(strcmp(funcName, "glDrawRangeElementsBaseVertex") == 0) {
+		GLenum  mode; _args.Get(mode);
+		GLuint  start; _args.Get(start);
+		GLuint  end; _args.Get(end);
+		GLsizei  count; _args.Get(count);
+		GLenum  type; _args.Get(type);
+		GLvoid * indices; _args.Get(indices);
+		GLint  basevertex; _args.Get(basevertex);
+		ogle->glDrawRangeElementsBaseVertex(mode , start , end , count , type , indices , basevertex);
+	}
+	else if(strcmp(funcName, "glMultiDrawArrays") == 0
+			|| strcmp(funcName, "glMultiDrawArraysEXT") == 0) {
+		GLenum  mode; _args.Get(mode);
+		GLint * first; _args.Get(first);
+		GLsizei * count; _args.Get(count);
+		GLsizei  drawcount; _args.Get(drawcount);
+		ogle->glMultiDrawArrays(mode , first , count , drawcount);
+	}
+	else if(strcmp(funcName, "glMultiDrawElements") == 0
+			|| strcmp(funcName, "glMultiDrawElementsEXT") == 0) {
+		GLenum  mode; _args.Get(mode);
+		GLsizei * count; _args.Get(count);
+		GLenum  type; _args.Get(type);
+		GLvoid ** indices; _args.Get(indices);
+		GLsizei  drawcount; _args.Get(drawcount);
+		ogle->glMultiDrawElements(mode , count , type , indices , drawcount);
+	}
+	else if(strcmp(funcName, "glMultiDrawElementsBaseVertex") == 0) {
+		GLenum  mode; _args.Get(mode);
+		GLsizei * count; _args.Get(count);
+		GLenum  type; _args.Get(type);
+		GLvoid ** indices; _args.Get(indices);
+		GLsizei  drawcount; _args.Get(drawcount);
+		GLint * basevertex; _args.Get(basevertex);
+		ogle->glMultiDrawElementsBaseVertex(mode , count , type , indices , drawcount , basevertex);
+	}
+	else if(strcmp(funcName, "glDrawArraysIndirect") == 0) {
+		GLenum  mode; _args.Get(mode);
+		GLvoid * indirect; _args.Get(indirect);
+		ogle->glDrawArraysIndirect(mode , indirect);
+	}
+	else if(strcmp(funcName, "glDrawElementsIndirect") == 0) {
+		GLenum  mode; _args.Get(mode);
+		GLenum  type; _args.Get(type);
+		GLvoid * indirect; _args.Get(indirect);
+		ogle->glDrawElementsIndirect(mode , type , indirect);
+	}
+	else if(strcmp(funcName, "glMultiDrawArraysIndirect") == 0) {
+		GLenum  mode; _args.Get(mode);
+		GLvoid * indirect; _args.Get(indirect);
+		GLsizei  drawcount; _args.Get(drawcount);
+		GLsizei  stride; _args.Get(stride);
+		ogle->glMultiDrawArraysIndirect(mode , indirect , drawcount , stride);
+	}
+	else if(strcmp(funcName, "glMultiDrawElementsIndirect") == 0) {
+		GLenum  mode; _args.Get(mode);
+		GLenum  type; _args.Get(type);
+		GLvoid * indirect; _args.Get(indirect);
+		GLsizei  drawcount; _args.Get(drawcount);
+		GLsizei  stride; _args.Get(stride);
+		ogle->glMultiDrawElementsIndirect(mode , type , indirect , drawcount , stride);
+	}
+	else if(strcmp(funcName, "glDrawArraysInstanced") == 0
+			|| strcmp(funcName, "glDrawArraysInstancedARB") == 0
+			|| strcmp(funcName, "glDrawArraysInstancedEXT") == 0) {
+		GLenum  mode; _args.Get(mode);
+		GLint  first; _args.Get(first);
+		GLsizei  count; _args.Get(count);
+		GLsizei  instancecount; _args.Get(instancecount);
+		ogle->glDrawArraysInstanced(mode , first , count , instancecount);
+	}
+	else if(strcmp(funcName, "glDrawElementsInstanced") == 0
+			|| strcmp(funcName, "glDrawElementsInstancedARB") == 0
+			|| strcmp(funcName, "glDrawElementsInstancedEXT") == 0) {
+		GLenum  mode; _args.Get(mode);
+		GLsizei  count; _args.Get(count);
+		GLenum  type; _args.Get(type);
+		GLvoid * indices; _args.Get(indices);
+		GLsizei  instancecount; _args.Get(instancecount);
+		ogle->glDrawElementsInstanced(mode , count , type , indices , instancecount);
+	}
+	else if(strcmp(funcName, "glCallList") == 0) {
+		GLuint list; _args.Get(list);
+		ogle->glCallList(list);
+	}
+	else if(strcmp(funcName, "glCallLists") == 0) {
+		GLsizei n; _args.Get(n);
+		GLenum type; _args.Get(type);
+		GLvoid *lists; _args.Get(lists);
+		ogle->glCallLists(n , type , lists);
+	}
+	else if(strcmp(funcName, "glBegin") == 0) {
+		GLenum  mode; _args.Get(mode);
+		ogle->glBegin(mode);
+	}
+	else if(strcmp(funcName, "glEnd") == 0) {
+		ogle->glEnd();
+	}
+	else if(strcmp(funcName, "glArrayElement") == 0) {
+		GLint i; _args.Get(i);
+		ogle->glArrayElement(i);
+	}
+	else if(strcmp(funcName, "glVertex3fv") == 0) {
+		//GLfloat *V; _args.Get(V);
+		void *V; _args.Get(V);
+		ogle->glVertexfv((GLfloat *)V, 3);
+	}
+	else if(strcmp(funcName, "glVertex3f") == 0) {
+		GLfloat V[3]; _args.Get(*V); _args.Get(*(V+1)); _args.Get(*(V+2));
+		ogle->glVertexfv(V, 3);
+	}
+	else if(strcmp(funcName, "glVertex3dv") == 0) {
+		//GLdouble *V; _args.Get(V);
+		void *VV; _args.Get(VV);
+		GLdouble *V = (GLdouble *)VV;
+		GLfloat tmp[3]; tmp[0] = V[0]; tmp[1] = V[1]; tmp[2] = V[2];
+		ogle->glVertexfv(tmp, 3);
+	}
+	else if(strcmp(funcName, "glVertex3d") == 0) {
+		GLdouble V[3]; _args.Get(*V); _args.Get(*(V+1)); _args.Get(*(V+2));
+		GLfloat tmp[3]; tmp[0] = V[0]; tmp[1] = V[1]; tmp[2] = V[2];
+		ogle->glVertexfv(tmp, 3);
+	}
+	else if(strcmp(funcName, "glNormal3fv") == 0) {
+		//GLfloat *V; _args.Get(V);
+		void *V; _args.Get(V);
+		ogle->glNormalfv((GLfloat *)V, 3);
+	}
+	else if(strcmp(funcName, "glNormal3f") == 0) {
+		GLfloat V[3]; _args.Get(*V); _args.Get(*(V+1)); _args.Get(*(V+2));
+		ogle->glNormalfv(V, 3);
+	}
+	else if(strcmp(funcName, "glColor3fv") == 0 || strcmp(funcName, "glColor4fv") == 0) {
+		void *V; _args.Get(V);
+		ogle->glColorfv((GLfloat *)V, funcName[7] - '0');
+	}
+	else if(strcmp(funcName, "glColor3f") == 0) {
+		GLfloat V[4] = { 0, 0, 0, 1 }; _args.Get(*V); _args.Get(*(V+1)); _args.Get(*(V+2));
+		ogle->glColorfv(V, 4);
+	}
+	else if(strcmp(funcName, "glColor4f") == 0) {
+		GLfloat V[4]; _args.Get(*V); _args.Get(*(V+1)); _args.Get(*(V+2)); _args.Get(*(V+3));
+		ogle->glColorfv(V, 4);
+	}
+	else if(strcmp(funcName, "glColor3ubv") == 0 || strcmp(funcName, "glColor4ubv") == 0) {
+		void *VV; _args.Get(VV);
+		GLubyte *V = (GLubyte *)VV;
+		GLfloat tmp[4] = { 0, 0, 0, 1 };
+		for(int i = 0; i < funcName[7] - '0'; i++) tmp[i] = V[i] / 255.0f;
+		ogle->glColorfv(tmp, 4);
+	}
+	else if(strcmp(funcName, "glColor3ub") == 0 || strcmp(funcName, "glColor4ub") == 0) {
+		GLubyte V[4] = { 0, 0, 0, 255 };
+		for(int i = 0; i < funcName[7] - '0'; i++) _args.Get(V[i]);
+		GLfloat tmp[4]; for(int i = 0; i < 4; i++) tmp[i] = V[i] / 255.0f;
+		ogle->glColorfv(tmp, 4);
+	}
+	else if(strcmp(funcName, "glTexCoord3fv") == 0) {
+		//GLfloat *V; _args.Get(V);
+		void *V; _args.Get(V);
+		ogle->glTexCoordfv((GLfloat *)V, 3);
+	}
+	else if(strcmp(funcName, "glTexCoord2fv") == 0) {
+		//GLfloat *V; _args.Get(V);
+		void *V; _args.Get(V);
+		ogle->glTexCoordfv((GLfloat *)V, 2);
+	}
+	else if(strcmp(funcName, "glTexCoord3f") == 0) {
+		GLfloat V[3]; _args.Get(*V); _args.Get(*(V+1)); _args.Get(*(V+2));
+		ogle->glTexCoordfv(V, 3);
+	}
+	else if(strcmp(funcName, "glTexCoord2f") == 0) {
+		GLfloat V[2]; _args.Get(*V); _args.Get(*(V+1));
+		ogle->glTexCoordfv(V, 2);
+	}
+	else if(strcmp(funcName, "glEnableClientState") == 0) {
+		GLenum array; _args.Get(array);
+		ogle->glEnableClientState(array);		
+	}
+	else if(strcmp(funcName, "glDisableClientState") == 0) {
+		GLenum array; _args.Get(array);
+		ogle->glDisableClientState(array);
+	}
+	else if(strcmp(funcName, "glClientActiveTexture") == 0
+		|| strcmp(funcName, "glClientActiveTextureARB") == 0) {
+		GLenum texture; _args.Get(texture);
+		ogle->glClientActiveTexture(texture);
+	}
+	else if(strcmp(funcName, "glVertexPointer") == 0) {
+		GLint size; _args.Get(size);
+		GLenum type; _args.Get(type);
+		GLsizei stride; _args.Get(stride);
+		GLvoid *pointer; _args.Get(pointer);
+		ogle->glVertexPointer(size , type , stride , pointer);
+	}
+	else if(strcmp(funcName, "glNormalPointer") == 0) {
+		GLenum type; _args.Get(type);
+		GLsizei stride; _args.Get(stride);
+		GLvoid *pointer; _args.Get(pointer);
+		ogle->glNormalPointer(type , stride , pointer);
+	}
+	else if(strcmp(funcName, "glColorPointer") == 0) {
+		GLint size; _args.Get(size);
+		GLenum type; _args.Get(type);
+		GLsizei stride; _args.Get(stride);
+		GLvoid *pointer; _args.Get(pointer);
+		ogle->glColorPointer(size , type , stride , pointer);
+	}
+	else if(strcmp(funcName, "glTexCoordPointer") == 0) {
+		GLint size; _args.Get(size);
+		GLenum type; _args.Get(type);
+		GLsizei stride; _args.Get(stride);
+		GLvoid *pointer; _args.Get(pointer);
+		ogle->glTexCoordPointer(size , type , stride , pointer);
+	}
+	else if(strcmp(funcName, "glInterleavedArrays") == 0) {
+		GLenum format; _args.Get(format);
+		GLsizei stride; _args.Get(stride);
+		GLvoid *pointer; _args.Get(pointer);
+		ogle->glInterleavedArrays(format , stride , pointer);
+	}
+	
+
+
+
+
+	/*
+	else if(strcmp(funcName, "gl") == 0) {
+		ogle->gl();
+	}
+	*/
+
+} 
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+void OGLEPlugin::GLFunctionPost(uint updateID, const char *funcName, uint funcIndex, const FunctionRetValue & retVal)
+{
+	if(latency) {
+		LatencyTimer latencyTimer(latency.rawPtr(), funcIndex, funcName, recording.isActive() || flight.rawPtr());
+		if(!skipPost(funcIndex, funcName)) {
+			functionPost(funcName, funcIndex, retVal);
+		}
+	}
+	else if(!skipPost(funcIndex, funcName)) {
+		functionPost(funcName, funcIndex, retVal);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  The rest of GLFunctionPost, as for functionPre.
+//
+void OGLEPlugin::functionPost(const char *funcName, uint funcIndex, const FunctionRetValue & retVal)
+{
+	TRACE_ZONE(funcName);
+
+	OGLE *ogle = currentContext();
+	OGLE::ShareGroup::Lock lock(ogle->shared.rawPtr());
+
+	// whether this thread's context is recording
+	bool isRecording = ogle->isRecording();
+
+	FunctionRetValue _retVal(retVal);
+
+
+	// persistent maps outlive the frame they were made in, so the
+	// pointer has to be kept whenever the map itself was seen
+	if(isRecording || OGLE_BIND_BUFFERS_ALL_FRAMES) {
+		if(strcmp(funcName, "glMapBuffer") == 0 
+				|| strcmp(funcName, "glMapBufferARB") == 0
+				|| strcmp(funcName, "glMapBufferRange") == 0) {
+
+			GLvoid *retValue; _retVal.Get(retValue);
+			ogle->glMapBufferPost(retValue);
+		}
+		else if(strcmp(funcName, "glGetUniformLocation") == 0
+				|| strcmp(funcName, "glGetUniformLocationARB") == 0) {
+
+			GLint location; _retVal.Get(location);
+			ogle->glGetUniformLocationPost(location);
+		}
+	}
+
+
+	if(!isRecording) return;
+	
+	if(callLog) {
+		callLog->logPost(funcIndex, funcName, retVal);
+	}
+	else if(OGLE::config.logFunctions) {
+		char buff[1024];
+		gliCallBacks->GetGLReturnString(funcIndex, retVal, 1024, buff);
+		fprintf(OGLE::LOG, "\t%s (%d) returned: %s\n",funcName, funcIndex, buff);
+		fflush(OGLE::LOG);
+	}
+
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+OGLE *OGLEPlugin::getContext(HGLRC rcHandle)
+{
+	EnterCriticalSection(&contextsLock);
+
+	OGLEPtr &context = contexts[rcHandle];
+	if(!context) {
+		// a context made before we were loaded
+		context = new OGLE(gliCallBacks, GLV);
+		context->flight = flight;
+		context->governor = governor;
+	}
+	OGLE *ogle = context.rawPtr();
+
+	LeaveCriticalSection(&contextsLock);
+	return ogle;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+void OGLEPlugin::OnGLContextCreate(HGLRC rcHandle)
+{
+	getContext(rcHandle);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+void OGLEPlugin::OnGLContextDelete(HGLRC rcHandle)
+{
+	if(!rcHandle) return;
+
+	EnterCriticalSection(&contextsLock);
+
+	std::unordered_map<HGLRC, OGLEPtr>::iterator i = contexts.find(rcHandle);
+	if(i != contexts.end()) {
+		if(TlsGetValue(currentSlot) == i->second.rawPtr()) {
+			TlsSetValue(currentSlot, 0);
+		}
+		if(i->second->isCompilingList()) {
+			InterlockedDecrement(&nCompilingLists);
+		}
+		i->second->flushCoalesced();
+		contexts.erase(i);
+	}
+
+	LeaveCriticalSection(&contextsLock);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+void OGLEPlugin::OnGLContextShareLists(HGLRC srcHandle, HGLRC dstHandle)
+{
+	getContext(dstHandle)->shareLists(getContext(srcHandle));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+void OGLEPlugin::OnGLContextSet(HGLRC oldRCHandle, HGLRC newRCHandle)
+{
+//	fprintf(OGLE::LOG, "OP::OGLCS: %p, %p\n", oldRCHandle, newRCHandle);
+	if(newRCHandle) {
+		OGLE *ogle = getContext(newRCHandle);
+		TlsSetValue(currentSlot, ogle);
+
+		// entry points are only known once the context is current
+		if(!ogle->functionsInitialized()) {
+			ogle->initFunctions();
+		}
+	}
+	else {
+		TlsSetValue(currentSlot, 0);
+	}
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+void OGLEPlugin::GLFrameEndPost(const char *funcName, uint funcIndex, const FunctionRetValue & retVal)
+{
+	OGLE *ogle = currentContext();
+
+	if(flight) {
+		// the logger key writes out the frames held, rather than
+		// recording the next one
+		bool trigger = gliCallBacks->GetLoggerMode() != 0;
+		if(trigger && !flightTriggered) {
+			writeFlight(ogle);
+		}
+		flightTriggered = trigger;
+
+		flight->beginFrame(gliCallBacks->GetFrameNumber());
+		return;
+	}
+	
+	if(isRecording && OGLE::config.feedbackCapture) {
+		// a feedback frame that did not fit is tried again with this one
+		ogle->beginFeedback();
+	}
+	else if(gliCallBacks->GetLoggerMode()) {
+		fprintf(OGLE::LOG, "Starting to record, to filename %s\n", objFileName.c_str()); fflush(OGLE::LOG);
+		isRecording = 1;
+		fprintf(OGLE::LOG, "Buffer shadows: %.1f MB, %d evicted so far\n",
+				ogle->shared->buffers->bytes / (1024.0 * 1024.0), ogle->shared->buffers->nEvicted);
+
+		string fileName = frameFileName(gliCallBacks->GetFrameNumber(), filePerFrame);
+
+		// the frame's timeline goes next to its .obj
+		TRACE_BEGIN_FRAME(frameFileName(gliCallBacks->GetFrameNumber(), true) + ".trace.json");
+
+		ogle->startRecording(fileName);
+
+		recording.set(ogle->objFile);
+
+		if(OGLE::config.feedbackCapture) {
+			ogle->beginFeedback();
+		}
+	}
+
+
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+void OGLEPlugin::GLFrameEndPre(const char *funcName, uint funcIndex, const FunctionArgs & args )
+{
+	bool recorded = isRecording || flight;
+
+	if(isRecording) {
+		OGLE *ogle = currentContext();
+		// waiting for the file to be written is part of the frame's cost
+		CaptureTimer timer(ogle);
+
+		if(OGLE::config.feedbackCapture && !ogle->endFeedback()) {
+			fflush(OGLE::LOG);
+			return;
+		}
+
+		fprintf(OGLE::LOG, "Done recording\n"); fflush(OGLE::LOG);
+		isRecording = 0;
+
+		// small draws the contexts are still holding go in first
+		flushCoalesced();
+
+		// whatever the other threads still add is dropped once it is
+		// closed; each holds its own reference until it lets go
+		Ptr<ObjFile> closedFile = recording.get();
+		recording.set(0);
+		{
+			TRACE_ZONE("frame end");
+			ogle->stopRecording();
+			closedFile->close();
+		}
+		TRACE_END_FRAME();
+	}
+
+	if(governor) {
+		governor->endFrame(gliCallBacks->GetFrameNumber(), recorded);
+	}
+
+	if(latency) {
+		latency->endFrame(gliCallBacks->GetFrameNumber());
+	}
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Sends on what every context recording to the current file is holding
+//  back.  A context on another thread only touches its held draws under
+//  its share group's lock, and only switches files under it too, so the
+//  ones still on the file are safe to flush here.
+//
+void OGLEPlugin::flushCoalesced()
+{
+  if(!OGLE::config.coalesceDrawElements) return;
+
+  EnterCriticalSection(&contextsLock);
+  std::vector<OGLEPtr> current;
+  for(std::unordered_map<HGLRC, OGLEPtr>::iterator i = contexts.begin(); i != contexts.end(); ++i) {
+    current.push_back(i->second);
+  }
+  LeaveCriticalSection(&contextsLock);
+
+  Ptr<ObjFile> file = recording.get();
+
+  for(size_t i = 0; i < current.size(); i++) {
+    OGLE::ShareGroup::Lock lock(current[i]->shared.rawPtr());
+    if(current[i]->objFile.rawPtr() == file.rawPtr()) {
+      current[i]->flushCoalesced();
+    }
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+string OGLEPlugin::frameFileName(unsigned int frame, bool numbered)
+{
+	string fileName = objFileName;
+
+	if(numbered) {
+		char buff[256];
+		sprintf(buff, ".%d", frame);
+		fileName.append(buff);
+	}
+	if(fileInFrameDir) {
+
+		string path;
+		StringPrintF(path,"Frame_%06u\\", frame);
+
+		path.append(fileName);
+
+		fileName = path;
+
+		fprintf(OGLE::LOG, "frame file: %s\n", fileName.c_str() ); 
+	}
+
+	fileName.append(".obj");
+	return fileName;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+void OGLEPlugin::writeFlight(OGLE *ogle)
+{
+	// other threads wait to add their draws until this is done
+	EnterCriticalSection(&flight->lock);
+
+	fprintf(OGLE::LOG, "Flight recorder: writing the last %d frames\n", flight->size());
+
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+
+	for(int i = 0; i < flight->size(); i++) {
+		const OGLE::FlightRecorder::Frame &f = flight->frame(i);
+
+		fprintf(OGLE::LOG, "  frame %u: %d draws, %.1f MB, %d dropped, %.2f ms capturing\n",
+				f.number, (int)f.draws.size(), f.bytes() / (1024.0 * 1024.0), f.nDropped,
+				f.ticks * 1000.0 / freq.QuadPart);
+
+		ogle->writeFlightFrame(f, frameFileName(f.number, true));
+	}
+	fflush(OGLE::LOG);
+
+	LeaveCriticalSection(&flight->lock);
+}
@@ -1,233 +1,333 @@
-#ifndef __FUNCTION_STATS_PLUGIN_H_
-#define __FUNCTION_STATS_PLUGIN_H_
-
-#include "../../MainLib/InterceptPluginInterface.h"
-
-#include <vector>
-#include <string>
-
-using namespace std;
-
-#include "ogle.h"
-
-#include "Ptr/Interface.h"
-#include "Ptr/Ptr.h"
-
-class ConfigParser;
-
-//@
-//  Summary:
-//    This class implements a plugin that displays the total number
-//    of OpenGL calls made and the counts for each function.
-//  
-class OGLEPlugin : public InterceptPluginInterface
-{
-public:
-	OGLEPlugin(InterceptPluginCallbacks *callBacks);
-	virtual ~OGLEPlugin();
-
-  //@
-  //  Summary:
-  //    Called when an OpenGL function that has been registered 
-  //    (via RegisterGLFunction) is about to be made.
-  //  
-  //  Parameters:
-  //    funcData - The data of the function logged.
-  //
-  //    index    - A index to the function logged (In the function table).
-  //
-  //    args     - The arguments of the function.
-  //
-  virtual void GLIAPI GLFunctionPre (uint updateID, const char *funcName, uint funcIndex, const FunctionArgs & args );
-
-  //@
-  //  Summary:
-  //    Called when an OpenGL function that has been registered 
-  //    (via RegisterGLFunction) has been made.
-  //  
-  //  Parameters:
-  //    funcData - The data of the function logged.
-  //
-  //    index    - A index to the function logged (In the function table).
-  //
-  //    retVal   - The return vlaue of the function (if any).
-  //
-  virtual void GLIAPI GLFunctionPost(uint updateID, const char *funcName, uint funcIndex, const FunctionRetValue & retVal);
-
-  //@
-  //  Summary:
-  //    Called when the OpenGL "frame end" call is about to be made.
-  //  
-  //  Parameters:
-  //    funcData - The data of the function logged.
-  //
-  //    index    - A index to the function logged (In the function table).
-  //
-  //    args     - The arguments of the function.
-  //
-  virtual void GLIAPI GLFrameEndPre(const char *funcName, uint funcIndex, const FunctionArgs & args );
-
-  //@
-  //  Summary:
-  //    Called after OpenGL "frame end" call has been made.
-  //  
-  //  Parameters:
-  //    funcData - The data of the function logged.
-  //
-  //    index    - A index to the function logged (In the function table).
-  //
-  //    args     - The arguments of the function.
-  //
-  virtual void GLIAPI GLFrameEndPost(const char *funcName, uint funcIndex, const FunctionRetValue & retVal);
-
-  //@
-  //  Summary:
-  //    Called when a OpenGL "render" call is about to be made.
-  //  
-  //  Parameters:
-  //    funcData - The data of the function logged.
-  //
-  //    index    - A index to the function logged (In the function table).
-  //
-  //    args     - The arguments of the function.
-  //
-  inline virtual void GLIAPI GLRenderPre (const char *funcName, uint funcIndex, const FunctionArgs & args );
-
-  //@
-  //  Summary:
-  //    Called when a OpenGL "render" call has been made.
-  //  
-  //  Parameters:
-  //    funcData - The data of the function logged.
-  //
-  //    index    - A index to the function logged (In the function table).
-  //
-  //    retVal   - The return value of the function. (If any).
-  //
-  inline virtual void GLIAPI GLRenderPost(const char *funcName, uint funcIndex, const FunctionRetValue & retVal);
-
-  //@
-  //  Summary:
-  //    Called when a OpenGL error occurs.
-  //  
-  //  Parameters:
-  //    funcData - The data of the function that cause the error.
-  //
-  //    index    - A index to the function (In the function table).
-  //
-  inline virtual void GLIAPI OnGLError(const char *funcName, uint funcIndex);
-
-  //@
-  //  Summary:
-  //    Called when a OpenGL context is created.
-  //  
-  //  Parameters:
-  //    rcHandle - The new OpenGL context.
-  //
-  inline virtual void GLIAPI OnGLContextCreate(HGLRC rcHandle);
-
-  //@
-  //  Summary:
-  //    Called when a OpenGL context is deleted.
-  //  
-  //  Parameters:
-  //    rcHandle - The OpenGL context that is deleted.
-  //
-  inline virtual void GLIAPI OnGLContextDelete(HGLRC rcHandle);
-
-  //@
-  //  Summary:
-  //    Called when a OpenGL context is assigned (set).
-  //  
-  //  Parameters:
-  //    oldRCHandle - The old (previous) OpenGL context.
-  //
-  //    newRCHandle - The new OpenGL context.
-  //
-  virtual void GLIAPI OnGLContextSet(HGLRC oldRCHandle, HGLRC newRCHandle);
-
-  //@
-  //  Summary:
-  //    Called when a OpenGL context share lists.
-  //  
-  //  Parameters:
-  //    srcHandle - The context constaining the lists.
-  //
-  //    dstHandle - The context to now share the lists.
-  //
-  inline virtual void GLIAPI OnGLContextShareLists(HGLRC srcHandle, HGLRC dstHandle);
-
-
-  //@
-  //  Summary:
-  //    Called when this plugin is to be destroyed. The plugin should delete 
-  //    itself. (Note: If a plugin needs to shutdown, always request deletion
-  //    via InterceptPluginCallbacks::DestroyPlugin which will call this method
-  //    on the next update. Do not destroy the plugin by other means.)
-  //  
-  virtual void GLIAPI Destroy();
-
-protected:
-
-  InterceptPluginCallbacks *gliCallBacks;         // The callbacks to GLIntercept
-  const GLCoreDriver       *GLV;                  //The core OpenGL driver
-  string objFileName;
-  bool filePerFrame;
-  bool fileInFrameDir;
-
-  bool isRecording;
-
-  OGLEPtr ogle;
-
-  //@
-  //  Summary:
-  //    To process the configuration data.
-  //
-  void ProcessConfigData(ConfigParser *parser);
-};
-
-
-
-///////////////////////////////////////////////////////////////////////////////
-//
-inline void OGLEPlugin::GLRenderPre (const char *funcName, uint funcIndex, const FunctionArgs & args)
-{
-
-}
-///////////////////////////////////////////////////////////////////////////////
-//
-inline void OGLEPlugin::GLRenderPost(const char *funcName, uint funcIndex, const FunctionRetValue & retVal)
-{
-
-}
-
-///////////////////////////////////////////////////////////////////////////////
-//
-inline void OGLEPlugin::OnGLError(const char *funcName, uint funcIndex)
-{
-
-}
-
-///////////////////////////////////////////////////////////////////////////////
-//
-inline void OGLEPlugin::OnGLContextCreate(HGLRC rcHandle)
-{
-
-}
-
-///////////////////////////////////////////////////////////////////////////////
-//
-inline void OGLEPlugin::OnGLContextDelete(HGLRC rcHandle)
-{
-
-}
-
-///////////////////////////////////////////////////////////////////////////////
-//
-inline void OGLEPlugin::OnGLContextShareLists(HGLRC srcHandle, HGLRC dstHandle)
-{
-
-}
-
-
+#ifndef __FUNCTION_STATS_PLUGIN_H_
+#define __FUNCTION_STATS_PLUGIN_H_
+
+#include "../../MainLib/InterceptPluginInterface.h"
+
+#include <vector>
+#include <string>
+
+using namespace std;
+
+#include "ogle.h"
+#include "RecordingFile.h"
+
+#include "Ptr/Interface.h"
+#include "Ptr/Ptr.h"
+
+class ConfigParser;
+class CallLog;
+class Latency;
+
+//@
+//  Summary:
+//    This class implements a plugin that displays the total number
+//    of OpenGL calls made and the counts for each function.
+//  
+class OGLEPlugin : public InterceptPluginInterface
+{
+public:
+	OGLEPlugin(InterceptPluginCallbacks *callBacks);
+	virtual ~OGLEPlugin();
+
+  //@
+  //  Summary:
+  //    Called when an OpenGL function that has been registered 
+  //    (via RegisterGLFunction) is about to be made.
+  //  
+  //  Parameters:
+  //    funcData - The data of the function logged.
+  //
+  //    index    - A index to the function logged (In the function table).
+  //
+  //    args     - The arguments of the function.
+  //
+  virtual void GLIAPI GLFunctionPre (uint updateID, const char *funcName, uint funcIndex, const FunctionArgs & args );
+
+  //@
+  //  Summary:
+  //    Called when an OpenGL function that has been registered 
+  //    (via RegisterGLFunction) has been made.
+  //  
+  //  Parameters:
+  //    funcData - The data of the function logged.
+  //
+  //    index    - A index to the function logged (In the function table).
+  //
+  //    retVal   - The return vlaue of the function (if any).
+  //
+  virtual void GLIAPI GLFunctionPost(uint updateID, const char *funcName, uint funcIndex, const FunctionRetValue & retVal);
+
+  //@
+  //  Summary:
+  //    Called when the OpenGL "frame end" call is about to be made.
+  //  
+  //  Parameters:
+  //    funcData - The data of the function logged.
+  //
+  //    index    - A index to the function logged (In the function table).
+  //
+  //    args     - The arguments of the function.
+  //
+  virtual void GLIAPI GLFrameEndPre(const char *funcName, uint funcIndex, const FunctionArgs & args );
+
+  //@
+  //  Summary:
+  //    Called after OpenGL "frame end" call has been made.
+  //  
+  //  Parameters:
+  //    funcData - The data of the function logged.
+  //
+  //    index    - A index to the function logged (In the function table).
+  //
+  //    args     - The arguments of the function.
+  //
+  virtual void GLIAPI GLFrameEndPost(const char *funcName, uint funcIndex, const FunctionRetValue & retVal);
+
+  //@
+  //  Summary:
+  //    Called when a OpenGL "render" call is about to be made.
+  //  
+  //  Parameters:
+  //    funcData - The data of the function logged.
+  //
+  //    index    - A index to the function logged (In the function table).
+  //
+  //    args     - The arguments of the function.
+  //
+  inline virtual void GLIAPI GLRenderPre (const char *funcName, uint funcIndex, const FunctionArgs & args );
+
+  //@
+  //  Summary:
+  //    Called when a OpenGL "render" call has been made.
+  //  
+  //  Parameters:
+  //    funcData - The data of the function logged.
+  //
+  //    index    - A index to the function logged (In the function table).
+  //
+  //    retVal   - The return value of the function. (If any).
+  //
+  inline virtual void GLIAPI GLRenderPost(const char *funcName, uint funcIndex, const FunctionRetValue & retVal);
+
+  //@
+  //  Summary:
+  //    Called when a OpenGL error occurs.
+  //  
+  //  Parameters:
+  //    funcData - The data of the function that cause the error.
+  //
+  //    index    - A index to the function (In the function table).
+  //
+  inline virtual void GLIAPI OnGLError(const char *funcName, uint funcIndex);
+
+  //@
+  //  Summary:
+  //    Called when a OpenGL context is created.
+  //  
+  //  Parameters:
+  //    rcHandle - The new OpenGL context.
+  //
+  virtual void GLIAPI OnGLContextCreate(HGLRC rcHandle);
+
+  //@
+  //  Summary:
+  //    Called when a OpenGL context is deleted.
+  //  
+  //  Parameters:
+  //    rcHandle - The OpenGL context that is deleted.
+  //
+  virtual void GLIAPI OnGLContextDelete(HGLRC rcHandle);
+
+  //@
+  //  Summary:
+  //    Called when a OpenGL context is assigned (set).
+  //  
+  //  Parameters:
+  //    oldRCHandle - The old (previous) OpenGL context.
+  //
+  //    newRCHandle - The new OpenGL context.
+  //
+  virtual void GLIAPI OnGLContextSet(HGLRC oldRCHandle, HGLRC newRCHandle);
+
+  //@
+  //  Summary:
+  //    Called when a OpenGL context share lists.
+  //  
+  //  Parameters:
+  //    srcHandle - The context constaining the lists.
+  //
+  //    dstHandle - The context to now share the lists.
+  //
+  virtual void GLIAPI OnGLContextShareLists(HGLRC srcHandle, HGLRC dstHandle);
+
+
+  //@
+  //  Summary:
+  //    Called when this plugin is to be destroyed. The plugin should delete 
+  //    itself. (Note: If a plugin needs to shutdown, always request deletion
+  //    via InterceptPluginCallbacks::DestroyPlugin which will call this method
+  //    on the next update. Do not destroy the plugin by other means.)
+  //  
+  virtual void GLIAPI Destroy();
+
+protected:
+
+  InterceptPluginCallbacks *gliCallBacks;         // The callbacks to GLIntercept
+  const GLCoreDriver       *GLV;                  //The core OpenGL driver
+  string objFileName;
+  bool filePerFrame;
+  bool fileInFrameDir;
+
+  bool isRecording;
+
+  // the state of each context; 0 stands in for threads with no
+  // context current.  Each thread's current one is in thread local
+  // storage, so contexts on different threads are captured separately.
+  std::unordered_map<HGLRC, OGLEPtr> contexts;
+  CRITICAL_SECTION contextsLock;
+  DWORD currentSlot;
+  OGLE *defaultContext;
+
+  // the file every context writes to while recording
+  RecordingFile recording;
+
+  // in flight recorder mode, the last frames, and whether the logger
+  // key was already down at the end of the last frame
+  OGLE::FlightRecorderPtr flight;
+  bool flightTriggered;
+
+  // how many contexts are compiling a display list, so calls between
+  // recordings only look up their thread's context when one is
+  volatile LONG nCompilingLists;
+
+  // the capture budget, shared by every context; 0 if there is none
+  OGLE::GovernorPtr governor;
+
+  // where LogFunctions goes when LogFunctionsBinary is set
+  Ptr<CallLog> callLog;
+
+  // the time spent in each function, with LatencyHistograms
+  Ptr<Latency> latency;
+
+  OGLE *getContext(HGLRC rcHandle);
+  inline OGLE *currentContext();
+
+  // what GLFunctionPre and GLFunctionPost have to do for a function,
+  // worked out from its name the first time its index is seen
+  enum FunctionFlags {
+    FUNC_SEEN = 1,
+    FUNC_STATE = 2,       // followed in every frame
+    FUNC_GEOMETRY = 4,    // only wanted while recording or compiling a list
+    FUNC_POST = 8         // has something to do after the call too
+  };
+  enum { MAX_FUNCTIONS = 4096 };
+  volatile unsigned char funcFlags[MAX_FUNCTIONS];
+
+  inline int functionFlags(uint funcIndex, const char *funcName);
+  static int classifyFunction(const char *funcName);
+
+  // whether a call can be let through with nothing done before or
+  // after it, as nearly every call is between recordings, and what is
+  // done with the others
+  inline bool skipPre(uint funcIndex, const char *funcName);
+  inline bool skipPost(uint funcIndex, const char *funcName);
+  void functionPre(const char *funcName, uint funcIndex, const FunctionArgs & args);
+  void functionPost(const char *funcName, uint funcIndex, const FunctionRetValue & retVal);
+
+  string frameFileName(unsigned int frame, bool numbered);
+  void writeFlight(OGLE *ogle);
+  void flushCoalesced();
+
+  //@
+  //  Summary:
+  //    To process the configuration data.
+  //
+  void ProcessConfigData(ConfigParser *parser);
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+inline void OGLEPlugin::GLRenderPre (const char *funcName, uint funcIndex, const FunctionArgs & args)
+{
+
+}
+///////////////////////////////////////////////////////////////////////////////
+//
+inline void OGLEPlugin::GLRenderPost(const char *funcName, uint funcIndex, const FunctionRetValue & retVal)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+inline OGLE *OGLEPlugin::currentContext()
+{
+  OGLE *ogle = (OGLE *)TlsGetValue(currentSlot);
+  if(!ogle) ogle = defaultContext;
+
+  // recording is started and stopped on the thread that ends the frame;
+  // the others catch up on their next call
+  recording.catchUp(ogle);
+  return ogle;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+inline int OGLEPlugin::functionFlags(uint funcIndex, const char *funcName)
+{
+  if(funcIndex >= MAX_FUNCTIONS) {
+    return classifyFunction(funcName);
+  }
+
+  // two threads seeing an index at once both write the same thing
+  int flags = funcFlags[funcIndex];
+  if(!flags) {
+    flags = classifyFunction(funcName);
+    funcFlags[funcIndex] = flags;
+  }
+  return flags;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+inline bool OGLEPlugin::skipPre(uint funcIndex, const char *funcName)
+{
+  // feedback capture gets the geometry from GL at the end of the frame
+  if(OGLE::config.feedbackCapture) return true;
+
+  // between recordings geometry is let through before anything else
+  // is looked at, unless this thread's context is compiling a list
+  if(!(functionFlags(funcIndex, funcName) & FUNC_GEOMETRY) || recording.isActive() || flight.rawPtr()) {
+    return false;
+  }
+  if(!nCompilingLists) return true;
+
+  OGLE *ogle = (OGLE *)TlsGetValue(currentSlot);
+  if(!ogle) ogle = defaultContext;
+  return !ogle->isCompilingList();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+inline bool OGLEPlugin::skipPost(uint funcIndex, const char *funcName)
+{
+  if(OGLE::config.feedbackCapture) return true;
+
+  // only maps and uniform lookups have anything to do afterwards,
+  // unless the calls are being logged
+  return !(functionFlags(funcIndex, funcName) & FUNC_POST)
+    && !(OGLE::config.logFunctions && (recording.isActive() || flight.rawPtr()));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+inline void OGLEPlugin::OnGLError(const char *funcName, uint funcIndex)
+{
+
+}
+
+
+
 #endif // __FUNCTION_STATS_PLUGIN_H_
\ No newline at end of file
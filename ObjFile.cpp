@@ -1,245 +1,630 @@
-#include "stdafx.h"
-
-#include "Ptr/Ptr.in"
-
-#include "ogle.h"
-
-#include "ObjFile.h"
-
-
-int ObjFile::vertexCount;
-int ObjFile::normalCount;
-int ObjFile::texCoordCount;
-int ObjFile::groupCount;
-
-ObjFile::ObjFile(string _objFileName) {
-	objFileName = _objFileName;
-	f =	fopen(objFileName.c_str(), "w");
-
-	init();
-}
-
-ObjFile::~ObjFile() {
-	if(f) {
-		fclose(f);
-	}
-}
-
-void ObjFile::init() {
-	vertexCount = 0;
-	normalCount = 0;
-	texCoordCount = 0;
-	groupCount = 0;
-}
-
-
-ObjFile::Element ObjFile::generateElement(OGLE::ElementPtr e) {
-	OGLE::VertexPtr v;
-
-	v = e->v;
-	printVertex(v, "", 3);
-	Element oe(nextVertexID());
-
-	v = e->n;
-	if(v) {
-		printVertex(v, "n", 3);
-		oe.nid = nextNormalID();
-	}
-
-	v = e->t;
-	if(v) {
-		printVertex(v, "t", 2);
-		oe.tid = nextTexCoordID();
-	}
-
-	return oe;
-
-}
-
-void ObjFile::addSet(OGLE::ElementSetPtr set) {	
-	printSet(set);
-}
-
-
-void ObjFile::printSet(OGLE::ElementSetPtr set) {
-	if(!f) return;
-
-	int i;
-	Element e;
-
-	FacePtr face = new ObjFile::Face();
-
-
-	if(0) {}
-	else if(set->mode == GL_TRIANGLES) {
-		if(set->elements.size() >= 3) fprintf(f, "#TRIANGLES\ng %d\n", nextGroupID());
-		for(i = 0; i < set->elements.size(); i++) {
-
-			face->addElement(generateElement(set->elements[i]));
-
-			if(((i + 1) % 3) == 0) {
-				printFace(face);
-				face->clear();
-			}
-		}
-	}
-
-	else if(set->mode == GL_TRIANGLE_STRIP) {
-		if(set->elements.size() >= 3) fprintf(f, "#TRIANGLE_STRIP\ng %d\n", nextGroupID());
-		int flip_flag = 1;
-		for(i = 0; i < set->elements.size(); i++) {
-
-			face->addElement(generateElement(set->elements[i]));
-
-			if(i >= 2) {
-				printFace(face,
-					OGLE::config.flipPolyStrips	&& (flip_flag = (flip_flag + 1) % 2)
-					);
-
-				face->shiftElements(1);
-			}
-		}
-	}
-
-	else if(set->mode == GL_TRIANGLE_FAN) {
-		if(set->elements.size() >= 3) fprintf(f, "#TRIANGLE_FAN\ng %d\n", nextGroupID());
-
-		Element firste, laste;
-
-		for(i = 0; i < set->elements.size(); i++) {
-			e = generateElement(set->elements[i]);
-
-			if(i == 0) {
-				firste = e;
-			}
-			laste = e;
-
-			face->addElement(e);
-			
-			if(i >= 2) {
-				printFace(face);
-				face->clear();
-				face->addElement(firste);
-				face->addElement(laste);
-			}
-		}
-	}
-
-	else if(set->mode == GL_QUADS) {
-		if(set->elements.size() >= 4) fprintf(f, "#QUADS\ng %d\n", nextGroupID());
-		for(i = 0; i < set->elements.size(); i++) {
-
-			face->addElement(generateElement(set->elements[i]));
-
-			if(((i + 1) % 4) == 0) {
-				printFace(face);
-				face->clear();
-			}
-		}
-	}
-
-	else if(set->mode == GL_QUAD_STRIP) {
-		if(set->elements.size() >= 4) fprintf(f, "#QUAD_STRIP\ng %d\n", nextGroupID());
-		int flip_flag = 1;
-		for(i = 0; i < set->elements.size(); i++) {
-
-			face->addElement(generateElement(set->elements[i]));
-
-			if(i >= 3) {
-				printFace(face,
-					OGLE::config.flipPolyStrips	&& (flip_flag = (flip_flag + 1) % 2)					
-					);
-				face->shiftElements(1);
-			}
-		}
-	}
-
-	else if(set->mode == GL_POLYGON) {
-		if(set->elements.size() >= 3) fprintf(f, "#POLYGON [%d]\ng %d\n", set->elements.size(), nextGroupID());
-		for(i = 0; i < set->elements.size(); i++) {
-			face->addElement(generateElement(set->elements[i]));
-		}
-		printFace(face);
-	}
-
-	fflush(f);
-}
-
-
-void ObjFile::printFace(FacePtr face, bool flip) {
-	if(!f) return;
-
-	fprintf(f, "f ");
-	for(int i = (flip ? face->elements.size() - 1 : 0); 
-					i < face->elements.size() && i >= 0; 
-					i += (flip ? -1 : 1)) {
-
-		Element v = face->elements[i];
-
-		fprintf(f, "%d", v.vid);
-
-		if(v.tid) {
-			fprintf(f, "/%d", v.tid);
-		}
-		else if(v.nid) {
-			fprintf(f, "/");
-		}
-
-		if(v.nid) {
-			fprintf(f, "/%d", v.nid);
-		}
-
-		fprintf(f, " ");
-	}
-
-	fprintf(f, "\n");
-}
-
-
-void ObjFile::printVertex(OGLE::VertexPtr v, const char *typeStr, int n) {
-	if(!f) return;
-
-	fprintf(f, "v%s", typeStr);
-
-	if(n <= 0) n = v->size;
-
-	if(n >= 1) fprintf(f, " %e", v->x);
-	if(n >= 2) fprintf(f, " %e", v->y);
-	if(n >= 3) fprintf(f, " %e", v->z);
-
-	fprintf(f, "\n");	
-}
-
-
-
-
-
-
-void ObjFile::Face::addElement(Element e) { 
-	elements.push_back(e); 
-}
-
-void ObjFile::Face::shiftElements(int n) { 
-	while(n-- > 0) elements.pop_front(); 
-}
-
-void ObjFile::Face::clear() { 
-	elements.clear(); 
-}
-
-
-int ObjFile::nextVertexID() {
-	return ++vertexCount;
-}
-
-int ObjFile::nextNormalID() {
-	return ++normalCount;
-}
-
-int ObjFile::nextTexCoordID() {
-	return ++texCoordCount;
-}
-
-int ObjFile::nextGroupID() {
-	return ++groupCount;
-}
\ No newline at end of file
+#include "stdafx.h"
+
+#include "Ptr/Ptr.in"
+
+#include "ogle.h"
+
+#include "ObjFile.h"
+#include "Trace.h"
+
+#include <stdarg.h>
+
+#include <algorithm>
+
+
+ObjFile::ObjFile(string _objFileName) :
+	pendingElements(0),
+	pool(0),
+	queuedElements(0),
+	waiting(0),
+	closed(0),
+	writerIdle(0),
+	stopping(0),
+	writer(0)
+{
+	objFileName = _objFileName;
+	out = OutStream::open(objFileName, (OutStream::Codec)OGLE::config.compression);
+
+	int nThreads = OGLE::config.encoderThreads;
+	if(nThreads < 0) {
+		nThreads = WorkerPool::defaultThreadCount();
+	}
+	if(nThreads > 0) {
+		pool = new WorkerPool(nThreads);
+	}
+
+	maxQueued = std::max(OGLE::config.encoderBatchSize, 1 << 12) * 4;
+
+	InitializeCriticalSection(&lock);
+	InitializeConditionVariable(&wake);
+	InitializeConditionVariable(&room);
+
+	if(out) {
+		writer = CreateThread(NULL, 0, writerMain, this, 0, NULL);
+	}
+}
+
+ObjFile::~ObjFile() {
+	close();
+	DeleteCriticalSection(&lock);
+}
+
+
+// Called from whichever thread drew the set.  The push never waits on
+// other threads; only the writer falling far behind holds it up.
+
+void ObjFile::addSet(OGLE::ElementSetPtr set) {
+	if(closed || !writer) return;
+
+	LONG n = (LONG)set->elements.size();
+	LONG queued = InterlockedExchangeAdd(&queuedElements, n) + n;
+
+	queue.push(set);
+
+	// the interlocked read orders it after the push, so a writer that
+	// went idle before the push is sure to be woken
+	if(InterlockedCompareExchange(&writerIdle, 1, 1)) {
+		EnterCriticalSection(&lock);
+		WakeConditionVariable(&wake);
+		LeaveCriticalSection(&lock);
+	}
+
+	if(queued > maxQueued) {
+		waitQueued(maxQueued);
+	}
+}
+
+void ObjFile::waitQueued(LONG most) {
+	EnterCriticalSection(&lock);
+	InterlockedIncrement(&waiting);
+	while(queuedElements > most && !stopping) {
+		SleepConditionVariableCS(&room, &lock, INFINITE);
+	}
+	InterlockedDecrement(&waiting);
+	LeaveCriticalSection(&lock);
+}
+
+
+DWORD WINAPI ObjFile::writerMain(LPVOID param) {
+	((ObjFile *)param)->runWriter();
+	return 0;
+}
+
+void ObjFile::runWriter() {
+	OGLE::ElementSetPtr set;
+
+	for(;;) {
+		while(queue.pop(set)) {
+			LONG n = (LONG)set->elements.size();
+			writeSet(set);
+			set = 0;
+
+			LONG left = InterlockedExchangeAdd(&queuedElements, -n) - n;
+			if(left <= maxQueued && waiting) {
+				EnterCriticalSection(&lock);
+				WakeAllConditionVariable(&room);
+				LeaveCriticalSection(&lock);
+			}
+		}
+
+		EnterCriticalSection(&lock);
+		InterlockedExchange(&writerIdle, 1);
+		while(queue.empty() && !stopping) {
+			SleepConditionVariableCS(&wake, &lock, INFINITE);
+		}
+		InterlockedExchange(&writerIdle, 0);
+		bool stop = stopping && queue.empty();
+		LeaveCriticalSection(&lock);
+
+		if(stop) break;
+	}
+}
+
+
+void ObjFile::close() {
+	TRACE_ZONE("close");
+	if(!writer) return;
+
+	InterlockedExchange(&closed, 1);
+	waitQueued(0);
+
+	EnterCriticalSection(&lock);
+	stopping = 1;
+	WakeConditionVariable(&wake);
+	WakeAllConditionVariable(&room);
+	LeaveCriticalSection(&lock);
+
+	WaitForSingleObject(writer, INFINITE);
+	CloseHandle(writer);
+	writer = 0;
+
+	flush();
+	out = 0;
+}
+
+
+void ObjFile::writeSet(OGLE::ElementSetPtr set) {
+	TRACE_ZONE("write set");
+	if(!out) return;
+
+	// sets the governor deferred are transformed here, off the
+	// application's thread
+	set->place();
+
+	if(!pool) {
+		// serial: format and write each set as it arrives
+		Chunk chunk;
+		chunk.counts = counts;
+		printSet(chunk, *set.rawPtr());
+
+		out->write(chunk.text.data(), chunk.text.size());
+		out->flush();
+
+		counts = chunk.counts;
+		return;
+	}
+
+	pending.push_back(set);
+	pendingElements += set->elements.size();
+
+	if(pendingElements >= OGLE::config.encoderBatchSize) {
+		flush();
+	}
+}
+
+
+// Format the pending sets on the worker pool.  The record numbers each
+// chunk starts from are a prefix sum of the per-set counts, so the
+// chunks can be formatted in any order and still concatenate to the
+// same bytes a serial run would have written.
+
+void ObjFile::flush() {
+	TRACE_ZONE("flush");
+	if(!out || pending.empty()) return;
+
+	// a pool whose threads could not be started has none, and its jobs
+	// are run by whoever waits for them
+	int nChunks = std::max(pool->size() * 4, 1);
+	int chunkElements = pendingElements / nChunks + 1;
+
+	std::vector<Chunk> chunks;
+	chunks.reserve(nChunks + 1);
+
+	Counts prefix = counts;
+	int i = 0;
+
+	while(i < pending.size()) {
+		chunks.push_back(Chunk());
+		Chunk &chunk = chunks.back();
+
+		chunk.counts = prefix;
+		chunk.first = &pending[i];
+
+		int n = 0;
+		do {
+			n += pending[i]->elements.size();
+			prefix.add(countSet(*pending[i].rawPtr()));
+			i++;
+		} while(i < pending.size() && n < chunkElements);
+
+		chunk.last = &pending[0] + i;
+	}
+
+	std::vector<WorkerPool::Job *> jobs;
+	for(i = 0; i < chunks.size(); i++) {
+		jobs.push_back(&chunks[i]);
+	}
+	pool->runAll(jobs);
+
+	for(i = 0; i < chunks.size(); i++) {
+		out->write(chunks[i].text.data(), chunks[i].text.size());
+	}
+	out->flush();
+
+	counts = prefix;
+	pending.clear();
+	pendingElements = 0;
+}
+
+
+void ObjFile::Chunk::run() {
+	TRACE_ZONE("format chunk");
+	if(tokens) {
+		printFeedback(*this);
+		return;
+	}
+
+	// Only raw pointers are touched here, so the pool threads never
+	// contend on the reference counts.
+	for(const OGLE::ElementSetPtr *s = first; s != last; s++) {
+		printSet(*this, *s->rawPtr());
+	}
+}
+
+// A frame of feedback buffer tokens.  One pass over the tokens splits
+// them into chunks at token boundaries and counts the records in each,
+// and the chunks are then formatted like sets are, straight from the
+// buffer, without making Elements first.
+
+void ObjFile::addFeedback(const GLfloat *data, GLsizei size, int vertexFloats, int colorOffset, int texOffset) {
+	TRACE_ZONE("feedback");
+	if(!out) return;
+
+	// anything already captured comes first; the writer is idle after
+	// this, and nothing else adds sets in feedback mode
+	waitQueued(0);
+	flush();
+
+	int nChunks = pool ? std::max(pool->size() * 4, 1) : 1;
+	size_t chunkFloats = size / nChunks + 1;
+
+	std::vector<Chunk> chunks;
+	chunks.reserve(nChunks + 1);
+
+	Counts prefix = counts;
+	const GLfloat *p = data, *end = data + size;
+
+	while(p < end) {
+		chunks.push_back(Chunk());
+		Chunk &chunk = chunks.back();
+
+		chunk.counts = prefix;
+		chunk.tokens = p;
+		chunk.vertexFloats = vertexFloats;
+		chunk.colorOffset = colorOffset;
+		chunk.texOffset = texOffset;
+		chunk.header = chunks.size() == 1;
+		if(chunk.header) {
+			prefix.group++;
+		}
+
+		const GLfloat *stop = p + std::min(chunkFloats, (size_t)(end - p));
+		while(p < stop) {
+			int nVerts;
+			p = nextToken(p, end, vertexFloats, nVerts);
+
+			if(nVerts >= 3) {
+				prefix.vertex += nVerts;
+				if(texOffset >= 0) prefix.texCoord += nVerts;
+			}
+		}
+
+		chunk.tokensEnd = p;
+	}
+
+	if(pool && chunks.size() > 1) {
+		std::vector<WorkerPool::Job *> jobs;
+		for(int i = 0; i < chunks.size(); i++) {
+			jobs.push_back(&chunks[i]);
+		}
+		pool->runAll(jobs);
+	}
+	else {
+		for(int i = 0; i < chunks.size(); i++) {
+			chunks[i].run();
+		}
+	}
+
+	for(int i = 0; i < chunks.size(); i++) {
+		out->write(chunks[i].text.data(), chunks[i].text.size());
+	}
+	out->flush();
+
+	counts = prefix;
+}
+
+// Step over one feedback token.  nPolyVerts is the vertex count of a
+// polygon, 0 for anything else.  A token cut off by the end of the
+// buffer ends it.
+
+const GLfloat *ObjFile::nextToken(const GLfloat *p, const GLfloat *end, int vertexFloats, int &nPolyVerts) {
+	nPolyVerts = 0;
+
+	switch((GLint)*p) {
+		case GL_POLYGON_TOKEN: {
+			if(p + 1 >= end) return end;
+			GLint n = (GLint)p[1];
+			if(n < 0 || (end - p - 2) / vertexFloats < n) return end;
+			nPolyVerts = n;
+			return p + 2 + n * vertexFloats;
+		}
+		case GL_LINE_TOKEN:
+		case GL_LINE_RESET_TOKEN:
+			p += 1 + 2 * vertexFloats;
+			break;
+		case GL_POINT_TOKEN:
+		case GL_BITMAP_TOKEN:
+		case GL_DRAW_PIXEL_TOKEN:
+		case GL_COPY_PIXEL_TOKEN:
+			p += 1 + vertexFloats;
+			break;
+		case GL_PASS_THROUGH_TOKEN:
+			p += 2;
+			break;
+		default:
+			// not a token; the buffer cannot be followed past here
+			return end;
+	}
+
+	return p < end ? p : end;
+}
+
+void ObjFile::printFeedback(Chunk &out) {
+	float scale = OGLE::config.scale ? OGLE::config.scale : 1;
+
+	if(out.header) {
+		out.printf("#FEEDBACK\ng %d\n", out.nextGroupID());
+	}
+
+	Face face;
+	const GLfloat *p = out.tokens;
+
+	while(p < out.tokensEnd) {
+		int nVerts;
+		const GLfloat *next = nextToken(p, out.tokensEnd, out.vertexFloats, nVerts);
+
+		if(nVerts >= 3) {
+			const GLfloat *v = p + 2;
+
+			for(int i = 0; i < nVerts; i++, v += out.vertexFloats) {
+				out.printf("v %e %e %e", v[0] * scale, v[1] * scale, v[2] * scale);
+				if(out.colorOffset >= 0) {
+					const GLfloat *c = v + out.colorOffset;
+					out.printf(" %e %e %e", c[0], c[1], c[2]);
+				}
+				out.printf("\n");
+				Element e(out.nextVertexID());
+
+				if(out.texOffset >= 0) {
+					out.printf("vt %e %e\n", v[out.texOffset], v[out.texOffset + 1]);
+					e.tid = out.nextTexCoordID();
+				}
+
+				face.addElement(e);
+			}
+
+			printFace(out, face);
+			face.clear();
+		}
+
+		p = next;
+	}
+}
+
+
+void ObjFile::Chunk::printf(const char *fmt, ...) {
+	char buff[256];
+
+	va_list args;
+	va_start(args, fmt);
+	int n = vsnprintf(buff, sizeof(buff), fmt, args);
+	va_end(args);
+
+	if(n < 0 || n >= sizeof(buff)) {
+		n = sizeof(buff) - 1;
+	}
+	text.append(buff, n);
+}
+
+
+// The number of each kind of record printSet() will emit for a set,
+// without formatting anything.
+
+ObjFile::Counts ObjFile::countSet(const OGLE::ElementSet &set) {
+	Counts c;
+	int minElements = 0;
+
+	switch(set.mode) {
+		case GL_TRIANGLES:
+		case GL_TRIANGLE_STRIP:
+		case GL_TRIANGLE_FAN:
+		case GL_POLYGON:
+			minElements = 3;
+			break;
+		case GL_QUADS:
+		case GL_QUAD_STRIP:
+			minElements = 4;
+			break;
+		default:
+			return c;
+	}
+
+	if(set.elements.size() >= minElements) {
+		c.group = 1;
+	}
+
+	for(int i = 0; i < set.elements.size(); i++) {
+		const OGLE::Element &e = *set.elements[i].rawPtr();
+		c.vertex++;
+		if(e.n.rawPtr()) c.normal++;
+		if(e.t.rawPtr()) c.texCoord++;
+	}
+
+	return c;
+}
+
+
+ObjFile::Element ObjFile::generateElement(Chunk &out, const OGLE::Element &e) {
+	printVertex(out, *e.v.rawPtr(), "", 3, e.c.rawPtr());
+	Element oe(out.nextVertexID());
+
+	if(e.n.rawPtr()) {
+		printVertex(out, *e.n.rawPtr(), "n", 3);
+		oe.nid = out.nextNormalID();
+	}
+
+	if(e.t.rawPtr()) {
+		printVertex(out, *e.t.rawPtr(), "t", 2);
+		oe.tid = out.nextTexCoordID();
+	}
+
+	return oe;
+
+}
+
+
+void ObjFile::printSet(Chunk &out, const OGLE::ElementSet &set) {
+	int i;
+	Element e;
+
+	Face face;
+
+#define OGLE_SET_ELEMENT(I) (*set.elements[I].rawPtr())
+
+	if(0) {}
+	else if(set.mode == GL_TRIANGLES) {
+		if(set.elements.size() >= 3) out.printf("#TRIANGLES\ng %d\n", out.nextGroupID());
+		for(i = 0; i < set.elements.size(); i++) {
+
+			face.addElement(generateElement(out, OGLE_SET_ELEMENT(i)));
+
+			if(((i + 1) % 3) == 0) {
+				printFace(out, face);
+				face.clear();
+			}
+		}
+	}
+
+	else if(set.mode == GL_TRIANGLE_STRIP) {
+		if(set.elements.size() >= 3) out.printf("#TRIANGLE_STRIP\ng %d\n", out.nextGroupID());
+		int flip_flag = 1;
+		for(i = 0; i < set.elements.size(); i++) {
+
+			face.addElement(generateElement(out, OGLE_SET_ELEMENT(i)));
+
+			if(i >= 2) {
+				printFace(out, face,
+					OGLE::config.flipPolyStrips	&& (flip_flag = (flip_flag + 1) % 2)
+					);
+
+				face.shiftElements(1);
+			}
+		}
+	}
+
+	else if(set.mode == GL_TRIANGLE_FAN) {
+		if(set.elements.size() >= 3) out.printf("#TRIANGLE_FAN\ng %d\n", out.nextGroupID());
+
+		Element firste, laste;
+
+		for(i = 0; i < set.elements.size(); i++) {
+			e = generateElement(out, OGLE_SET_ELEMENT(i));
+
+			if(i == 0) {
+				firste = e;
+			}
+			laste = e;
+
+			face.addElement(e);
+
+			if(i >= 2) {
+				printFace(out, face);
+				face.clear();
+				face.addElement(firste);
+				face.addElement(laste);
+			}
+		}
+	}
+
+	else if(set.mode == GL_QUADS) {
+		if(set.elements.size() >= 4) out.printf("#QUADS\ng %d\n", out.nextGroupID());
+		for(i = 0; i < set.elements.size(); i++) {
+
+			face.addElement(generateElement(out, OGLE_SET_ELEMENT(i)));
+
+			if(((i + 1) % 4) == 0) {
+				printFace(out, face);
+				face.clear();
+			}
+		}
+	}
+
+	else if(set.mode == GL_QUAD_STRIP) {
+		if(set.elements.size() >= 4) out.printf("#QUAD_STRIP\ng %d\n", out.nextGroupID());
+		int flip_flag = 1;
+		for(i = 0; i < set.elements.size(); i++) {
+
+			face.addElement(generateElement(out, OGLE_SET_ELEMENT(i)));
+
+			if(i >= 3) {
+				printFace(out, face,
+					OGLE::config.flipPolyStrips	&& (flip_flag = (flip_flag + 1) % 2)
+					);
+				face.shiftElements(1);
+			}
+		}
+	}
+
+	else if(set.mode == GL_POLYGON) {
+		if(set.elements.size() >= 3) out.printf("#POLYGON [%d]\ng %d\n", set.elements.size(), out.nextGroupID());
+		for(i = 0; i < set.elements.size(); i++) {
+			face.addElement(generateElement(out, OGLE_SET_ELEMENT(i)));
+		}
+		printFace(out, face);
+	}
+
+#undef OGLE_SET_ELEMENT
+}
+
+
+void ObjFile::printFace(Chunk &out, Face &face, bool flip) {
+	out.printf("f ");
+	for(int i = (flip ? face.elements.size() - 1 : 0);
+					i < face.elements.size() && i >= 0;
+					i += (flip ? -1 : 1)) {
+
+		Element v = face.elements[i];
+
+		out.printf("%d", v.vid);
+
+		if(v.tid) {
+			out.printf("/%d", v.tid);
+		}
+		else if(v.nid) {
+			out.printf("/");
+		}
+
+		if(v.nid) {
+			out.printf("/%d", v.nid);
+		}
+
+		out.printf(" ");
+	}
+
+	out.printf("\n");
+}
+
+
+// A colour goes after the position, as "v x y z r g b", which most
+// OBJ readers take as per vertex colour.
+
+void ObjFile::printVertex(Chunk &out, const OGLE::Vertex &v, const char *typeStr, int n, const OGLE::Vertex *color) {
+	out.printf("v%s", typeStr);
+
+	if(n <= 0) n = v.size;
+
+	if(n >= 1) out.printf(" %e", v.x);
+	if(n >= 2) out.printf(" %e", v.y);
+	if(n >= 3) out.printf(" %e", v.z);
+
+	if(color) out.printf(" %e %e %e", color->x, color->y, color->z);
+
+	out.printf("\n");
+}
+
+
+
+
+
+
+void ObjFile::Face::addElement(Element e) { 
+	elements.push_back(e); 
+}
+
+void ObjFile::Face::shiftElements(int n) { 
+	while(n-- > 0) elements.pop_front();
+}
+
+void ObjFile::Face::clear() { 
+	elements.clear(); 
+}
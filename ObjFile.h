@@ -1,71 +1,157 @@
-#ifndef __OBJFILE_H_
-#define __OBJFILE_H_
-
-#include "../../MainLib/InterceptPluginInterface.h"
-
-#include <string>
-#include <vector>
-#include <deque>
-
-#include "ogle.h"
-
-class ObjFile : public Interface {
-
-  public:
-
-	class Element {
-		public:
-			int vid, nid, tid;
-			Element(int _vid = 0, int _nid = 0, int _tid = 0) 
-					: vid(_vid), nid(_nid), tid(_tid) {}
-	};
-
-
-	class Face : public Interface {
-		public:
-			void addElement(Element v);
-			void shiftElements(int n = 1);
-			void clear();
-
-			deque<Element> elements;
-	};
-
-	typedef Ptr<Face> FacePtr;
-
-
-	ObjFile(string _objFileName);
-	~ObjFile();
-
-
-	void addSet(OGLE::ElementSetPtr set);
-	void printSet(OGLE::ElementSetPtr set);
-	Element generateElement(OGLE::ElementPtr e);
-
-
-	void printVertex(OGLE::VertexPtr v, const char *typeStr, int n = 0);
-	void printFace(FacePtr face, bool flip = 0);
-
-	
-	FILE *f;
-	string objFileName;
-	
-	static void init();
-
-	static int nextVertexID();
-	static int nextNormalID();
-	static int nextTexCoordID();
-	static int nextGroupID();
-
-	static int vertexCount;
-	static int normalCount;
-	static int texCoordCount;
-	static int groupCount;
-
-
-
-
-};
-
-typedef Ptr<ObjFile> ObjFilePtr;
-
-#endif // __OBJFILE_H_
+#ifndef __OBJFILE_H_
+#define __OBJFILE_H_
+
+#include "../../MainLib/InterceptPluginInterface.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include "ogle.h"
+#include "WorkerPool.h"
+#include "OutStream.h"
+#include "MpscQueue.h"
+
+//////////////////////////////////////////////////////////////////////
+// ObjFile -- the capture's output.  Any number of threads may add
+// sets; they go through a lock free queue to one writer thread, which
+// numbers the records and formats them in the order they were added.
+//////////////////////////////////////////////////////////////////////
+
+class ObjFile : public Interface {
+
+  public:
+
+	class Element {
+		public:
+			int vid, nid, tid;
+			Element(int _vid = 0, int _nid = 0, int _tid = 0)
+					: vid(_vid), nid(_nid), tid(_tid) {}
+	};
+
+
+	class Face : public Interface {
+		public:
+			void addElement(Element v);
+			void shiftElements(int n = 1);
+			void clear();
+
+			deque<Element> elements;
+	};
+
+	typedef Ptr<Face> FacePtr;
+
+
+	//////////////////////////////////////////////////////////////////////
+	// ObjFile::Counts -- running totals of the numbered OBJ records
+	//////////////////////////////////////////////////////////////////////
+
+	class Counts {
+		public:
+			int vertex, normal, texCoord, group;
+
+			Counts() : vertex(0), normal(0), texCoord(0), group(0) {}
+
+			void add(const Counts &c) {
+				vertex += c.vertex; normal += c.normal;
+				texCoord += c.texCoord; group += c.group;
+			}
+	};
+
+
+	//////////////////////////////////////////////////////////////////////
+	// ObjFile::Chunk -- the formatted text for a run of consecutive sets.
+	// Record numbers start from 'counts', which the caller seeds with
+	// the totals of everything written before this chunk.
+	//////////////////////////////////////////////////////////////////////
+
+	class Chunk : public WorkerPool::Job {
+		public:
+			Chunk() : first(0), last(0), tokens(0), tokensEnd(0) {}
+
+			void run();
+
+			void printf(const char *fmt, ...);
+
+			int nextVertexID() { return ++counts.vertex; }
+			int nextNormalID() { return ++counts.normal; }
+			int nextTexCoordID() { return ++counts.texCoord; }
+			int nextGroupID() { return ++counts.group; }
+
+			const OGLE::ElementSetPtr *first, *last;
+
+			// or a run of feedback buffer tokens
+			const GLfloat *tokens, *tokensEnd;
+			int vertexFloats, colorOffset, texOffset;
+			bool header;
+
+			Counts counts;
+			string text;
+	};
+
+
+	ObjFile(string _objFileName);
+	~ObjFile();
+
+
+	void addSet(OGLE::ElementSetPtr set);
+	void addFeedback(const GLfloat *data, GLsizei size, int vertexFloats, int colorOffset, int texOffset);
+
+	// Write out everything added so far and close the file.  Sets
+	// added after this are dropped.
+	void close();
+
+	// writer thread only
+	void writeSet(OGLE::ElementSetPtr set);
+	void flush();
+
+	static void printSet(Chunk &out, const OGLE::ElementSet &set);
+	static Element generateElement(Chunk &out, const OGLE::Element &e);
+
+	static void printVertex(Chunk &out, const OGLE::Vertex &v, const char *typeStr, int n = 0, const OGLE::Vertex *color = 0);
+	static void printFace(Chunk &out, Face &face, bool flip = 0);
+
+	static Counts countSet(const OGLE::ElementSet &set);
+
+	static void printFeedback(Chunk &out);
+	static const GLfloat *nextToken(const GLfloat *p, const GLfloat *end, int vertexFloats, int &nPolyVerts);
+
+
+	OutStreamPtr out;
+	string objFileName;
+
+	Counts counts;
+
+	std::vector<OGLE::ElementSetPtr> pending;
+	int pendingElements;
+
+	WorkerPoolPtr pool;
+
+  private:
+
+	static DWORD WINAPI writerMain(LPVOID param);
+	void runWriter();
+	void waitQueued(LONG most);
+
+	MpscQueue<OGLE::ElementSetPtr> queue;
+
+	// elements added but not yet written; adding sets blocks while
+	// there are more than maxQueued, so a slow writer cannot let the
+	// queue grow without bound
+	volatile LONG queuedElements;
+	LONG maxQueued;
+	volatile LONG waiting;
+
+	volatile LONG closed;
+	volatile LONG writerIdle;
+	bool stopping;
+	HANDLE writer;
+
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE wake;
+	CONDITION_VARIABLE room;
+};
+
+typedef Ptr<ObjFile> ObjFilePtr;
+
+#endif // __OBJFILE_H_
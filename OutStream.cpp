@@ -0,0 +1,337 @@
+#include "stdafx.h"
+
+#include "ogle.h"
+
+#include "OutStream.h"
+
+#include "Ptr/Ptr.in"
+
+#include <algorithm>
+
+#ifdef OGLE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef OGLE_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// OutStream
+/////////////////////////////////////////////////////////////////////////////////
+
+OutStream::Codec OutStream::codecFromName(const std::string &name) {
+	if(name == "gzip" || name == "GZIP" || name == "gz") return CODEC_GZIP;
+	if(name == "lz4" || name == "LZ4") return CODEC_LZ4;
+	return CODEC_NONE;
+}
+
+const char *OutStream::codecExtension(Codec codec) {
+	switch(codec) {
+		case CODEC_GZIP: return ".gz";
+		case CODEC_LZ4: return ".lz4";
+	}
+	return "";
+}
+
+const char *OutStream::codecName(Codec codec) {
+	switch(codec) {
+		case CODEC_GZIP: return "gzip";
+		case CODEC_LZ4: return "lz4";
+	}
+	return "none";
+}
+
+OutStream *OutStream::open(std::string fileName, Codec codec) {
+
+#ifndef OGLE_HAVE_ZLIB
+	if(codec == CODEC_GZIP) {
+		fprintf(OGLE::LOG, "OutStream: built without OGLE_HAVE_ZLIB, writing uncompressed\n");
+		codec = CODEC_NONE;
+	}
+#endif
+
+#ifndef OGLE_HAVE_LZ4
+	if(codec == CODEC_LZ4) {
+		fprintf(OGLE::LOG, "OutStream: built without OGLE_HAVE_LZ4, writing uncompressed\n");
+		codec = CODEC_NONE;
+	}
+#endif
+
+	fileName.append(codecExtension(codec));
+
+	FILE *f = fopen(fileName.c_str(), codec == CODEC_NONE ? "w" : "wb");
+	if(!f) {
+		fprintf(OGLE::LOG, "OutStream: unable to open %s\n", fileName.c_str());
+		return 0;
+	}
+
+	if(codec == CODEC_NONE) {
+		return new FileOutStream(f);
+	}
+
+	return new BlockOutStream(f, codec, fileName);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// BlockOutStream
+/////////////////////////////////////////////////////////////////////////////////
+
+BlockOutStream::BlockOutStream(FILE *_f, Codec _codec, std::string _fileName) :
+	f(_f),
+	codec(_codec),
+	fileName(_fileName),
+	curr(0),
+	pool(0),
+	bytesIn(0),
+	bytesOut(0),
+	compressTicks(0),
+	nBlocks(0)
+{
+	int nThreads = OGLE::config.compressionThreads;
+	if(nThreads < 0) {
+		nThreads = WorkerPool::defaultThreadCount();
+	}
+	pool = new WorkerPool(nThreads);
+
+	// enough blocks queued to keep every thread busy while the oldest
+	// is being written, without holding the whole capture in memory
+	maxInFlight = 2 * (nThreads > 0 ? nThreads : 1);
+
+	LARGE_INTEGER t;
+	QueryPerformanceCounter(&t);
+	startTicks = t.QuadPart;
+}
+
+BlockOutStream::~BlockOutStream() {
+	submitBlock();
+	while(!inFlight.empty()) {
+		writeBlock();
+	}
+
+	fclose(f);
+
+	LARGE_INTEGER t, freq;
+	QueryPerformanceCounter(&t);
+	QueryPerformanceFrequency(&freq);
+
+	double wall = (double)(t.QuadPart - startTicks) / freq.QuadPart;
+	double cpu = (double)compressTicks / freq.QuadPart;
+	double mb = bytesIn / (1024.0 * 1024.0);
+
+	fprintf(OGLE::LOG, "OutStream: %s level %d, %d blocks, %.1f MB -> %.1f MB (ratio %.2f)\n",
+			codecName(codec), OGLE::config.compressionLevel, nBlocks,
+			mb, bytesOut / (1024.0 * 1024.0),
+			bytesOut ? (double)bytesIn / bytesOut : 0.0);
+	fprintf(OGLE::LOG, "OutStream: %.1f MB/s per thread, %.1f MB/s over %.2fs wall, %s\n",
+			cpu > 0 ? mb / cpu : 0.0, wall > 0 ? mb / wall : 0.0, wall, fileName.c_str());
+	fflush(OGLE::LOG);
+}
+
+
+void BlockOutStream::write(const void *data, size_t size) {
+	const char *p = (const char *)data;
+	size_t blockSize = OGLE::config.compressionBlockSize;
+
+	while(size > 0) {
+		if(!curr) {
+			curr = new Block(codec, OGLE::config.compressionLevel);
+			curr->in.reserve(blockSize);
+		}
+
+		size_t n = blockSize - curr->in.size();
+		if(n > size) n = size;
+
+		curr->in.insert(curr->in.end(), p, p + n);
+		p += n;
+		size -= n;
+
+		if(curr->in.size() >= blockSize) {
+			submitBlock();
+		}
+	}
+}
+
+void BlockOutStream::submitBlock() {
+	if(!curr) return;
+
+	while(inFlight.size() >= maxInFlight) {
+		writeBlock();
+	}
+
+	bytesIn += curr->in.size();
+	inFlight.push_back(curr);
+	pool->submit(curr);
+	curr = 0;
+}
+
+void BlockOutStream::writeBlock() {
+	Block *block = inFlight.front();
+	inFlight.pop_front();
+
+	pool->wait(block);
+
+	if(block->stored) {
+		fprintf(OGLE::LOG, "OutStream: failed to compress a block of %d bytes, written uncompressed\n", (int)block->inSize);
+	}
+
+	if(block->ok && !block->out.empty()) {
+		fwrite(&block->out[0], 1, block->out.size(), f);
+		bytesOut += block->out.size();
+	}
+	else if(!block->ok) {
+		fprintf(OGLE::LOG, "OutStream: failed to compress a block of %d bytes, dropped\n", (int)block->inSize);
+	}
+
+	compressTicks += block->ticks;
+	nBlocks++;
+
+	delete block;
+}
+
+
+void BlockOutStream::Block::run() {
+	LARGE_INTEGER t0, t1;
+	QueryPerformanceCounter(&t0);
+
+	inSize = in.size();
+	if(in.empty()) {
+		ok = 1;
+		return;
+	}
+
+	switch(codec) {
+
+#ifdef OGLE_HAVE_ZLIB
+		case CODEC_GZIP: {
+			z_stream zs;
+			memset(&zs, 0, sizeof(zs));
+
+			// windowBits 15 + 16 asks zlib for a gzip header and trailer
+			if(deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+				break;
+			}
+
+			out.resize(deflateBound(&zs, in.size()) + 32);
+
+			zs.next_in = (Bytef *)&in[0];
+			zs.avail_in = in.size();
+			zs.next_out = (Bytef *)&out[0];
+			zs.avail_out = out.size();
+
+			ok = deflate(&zs, Z_FINISH) == Z_STREAM_END;
+			out.resize(zs.total_out);
+
+			deflateEnd(&zs);
+			break;
+		}
+#endif
+
+#ifdef OGLE_HAVE_LZ4
+		case CODEC_LZ4: {
+			LZ4F_preferences_t prefs;
+			memset(&prefs, 0, sizeof(prefs));
+			prefs.compressionLevel = level;
+			prefs.frameInfo.contentSize = in.size();
+
+			out.resize(LZ4F_compressFrameBound(in.size(), &prefs));
+
+			size_t n = LZ4F_compressFrame(&out[0], out.size(), &in[0], in.size(), &prefs);
+
+			ok = !LZ4F_isError(n);
+			out.resize(ok ? n : 0);
+			break;
+		}
+#endif
+
+		default:
+			break;
+	}
+
+	if(!ok) {
+		stored = ok = store();
+	}
+
+	// the uncompressed text is no longer needed
+	std::vector<char>().swap(in);
+
+	QueryPerformanceCounter(&t1);
+	ticks = t1.QuadPart - t0.QuadPart;
+}
+
+static void appendLE(std::vector<char> &out, unsigned int v, int nBytes) {
+	for(int i = 0; i < nBytes; i++) {
+		out.push_back((char)(v >> (8 * i)));
+	}
+}
+
+// Neither form needs anything of the codec beyond zlib's crc32, so a
+// block the codec failed on still reads back with the standard tools
+// rather than leaving a gap.  out is reserved at its final size first,
+// which is the one allocation made here; it is not much more than the
+// block itself, and if the codec failed for want of memory it can fail
+// too.
+
+bool BlockOutStream::Block::store() {
+	out.clear();
+
+	switch(codec) {
+
+#ifdef OGLE_HAVE_ZLIB
+		case CODEC_GZIP: {
+			// a gzip member of stored deflate blocks, each at most 64K - 1
+			static const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+			size_t nStored = (in.size() + 0xfffe) / 0xffff;
+			out.reserve(sizeof(header) + 5 * nStored + in.size() + 8);
+			out.insert(out.end(), header, header + sizeof(header));
+
+			size_t pos = 0;
+			while(pos < in.size()) {
+				size_t n = std::min(in.size() - pos, (size_t)0xffff);
+
+				out.push_back(pos + n == in.size() ? 1 : 0);
+				appendLE(out, (unsigned int)n, 2);
+				appendLE(out, (unsigned int)~n, 2);
+				out.insert(out.end(), in.begin() + pos, in.begin() + pos + n);
+				pos += n;
+			}
+
+			appendLE(out, crc32(crc32(0, Z_NULL, 0), (const Bytef *)&in[0], in.size()), 4);
+			appendLE(out, (unsigned int)in.size(), 4);
+			return true;
+		}
+#endif
+
+#ifdef OGLE_HAVE_LZ4
+		case CODEC_LZ4: {
+			// an LZ4 frame of uncompressed 64K blocks.  The header is
+			// always the same: version 1, independent blocks, no
+			// checksums, and the descriptor's own checksum for that.
+			static const char header[7] = { 4, '\x22', '\x4d', '\x18', '\x60', '\x40', '\x82' };
+			size_t nStored = (in.size() + 0xffff) / 0x10000;
+			out.reserve(sizeof(header) + 4 * nStored + in.size() + 4);
+			out.insert(out.end(), header, header + sizeof(header));
+
+			size_t pos = 0;
+			while(pos < in.size()) {
+				size_t n = std::min(in.size() - pos, (size_t)0x10000);
+
+				appendLE(out, 0x80000000 | (unsigned int)n, 4);
+				out.insert(out.end(), in.begin() + pos, in.begin() + pos + n);
+				pos += n;
+			}
+
+			appendLE(out, 0, 4);
+			return true;
+		}
+#endif
+
+		default:
+			break;
+	}
+
+	out.clear();
+	return false;
+}
@@ -0,0 +1,129 @@
+#ifndef __OUTSTREAM_H_
+#define __OUTSTREAM_H_
+
+#include <windows.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include "Ptr/Interface.h"
+#include "Ptr/Ptr.h"
+
+#include "WorkerPool.h"
+
+//////////////////////////////////////////////////////////////////////
+// OutStream -- where the capture output goes.  Either a plain file,
+// or a file written through a block compressor.
+//////////////////////////////////////////////////////////////////////
+
+class OutStream : public Interface {
+
+  public:
+
+	enum Codec {
+		CODEC_NONE,
+		CODEC_GZIP,
+		CODEC_LZ4
+	};
+
+	virtual ~OutStream() {}
+
+	virtual void write(const void *data, size_t size) = 0;
+
+	// Push whatever can be written cheaply out to the file.  Block
+	// compressed streams only ever write whole blocks, so for them
+	// this is a no-op until the stream is destroyed.
+	virtual void flush() = 0;
+
+	// Open fileName for writing with the given codec, appending the
+	// codec's usual extension to the name.  Returns 0 on failure.
+	static OutStream *open(std::string fileName, Codec codec);
+
+	static Codec codecFromName(const std::string &name);
+	static const char *codecExtension(Codec codec);
+	static const char *codecName(Codec codec);
+};
+
+typedef Ptr<OutStream> OutStreamPtr;
+
+
+//////////////////////////////////////////////////////////////////////
+// FileOutStream -- uncompressed output
+//////////////////////////////////////////////////////////////////////
+
+class FileOutStream : public OutStream {
+
+  public:
+	FileOutStream(FILE *_f) : f(_f) {}
+	~FileOutStream() { fclose(f); }
+
+	void write(const void *data, size_t size) { fwrite(data, 1, size, f); }
+	void flush() { fflush(f); }
+
+  private:
+	FILE *f;
+};
+
+
+//////////////////////////////////////////////////////////////////////
+// BlockOutStream -- splits the output into fixed size blocks and
+// compresses each one independently on background threads.  Every
+// block becomes a complete gzip member or LZ4 frame, and a sequence of
+// those is itself a valid .gz or .lz4 stream, so the file can be read
+// with the standard tools.  Blocks are written in the order they were
+// filled.
+//////////////////////////////////////////////////////////////////////
+
+class BlockOutStream : public OutStream {
+
+  public:
+
+	class Block : public WorkerPool::Job {
+		public:
+			Block(Codec _codec, int _level) : codec(_codec), level(_level), inSize(0), ok(0), stored(0), ticks(0) {}
+
+			void run();
+
+			// in as it is, in the codec's own format, for when
+			// compressing it failed
+			bool store();
+
+			Codec codec;
+			int level;
+
+			std::vector<char> in;
+			std::vector<char> out;
+			size_t inSize;
+			bool ok, stored;
+
+			LONGLONG ticks;
+	};
+
+	BlockOutStream(FILE *_f, Codec _codec, std::string _fileName);
+	~BlockOutStream();
+
+	void write(const void *data, size_t size);
+	void flush() {}
+
+  private:
+	void submitBlock();
+	void writeBlock();
+
+	FILE *f;
+	Codec codec;
+	std::string fileName;
+
+	Block *curr;
+	std::deque<Block *> inFlight;
+	int maxInFlight;
+
+	WorkerPoolPtr pool;
+
+	// statistics, reported to the OGLE log when the stream closes
+	LONGLONG bytesIn, bytesOut, compressTicks, startTicks;
+	int nBlocks;
+};
+
+#endif // __OUTSTREAM_H_
@@ -3,8 +3,13 @@
 
 #include "stdio.h"
 
+#include <windows.h>
+
 typedef unsigned long RefCount;
 
+// The counts are interlocked, since objects are handed between the
+// threads of the application and the capture's own writer threads.
+
 class Interface {
   public:
 
@@ -14,12 +19,12 @@ class Interface {
 
     void newRef() const {
         Interface * me = (Interface *) this;
-        ++me->references_;
+        InterlockedIncrement( &me->references_ );
     }
 
     void deleteRef() const {
         Interface * me = (Interface *) this;
-        if ( --me->references_ == 0 ) me->onZeroReferences();
+        if ( InterlockedDecrement( &me->references_ ) == 0 ) me->onZeroReferences();
     }
 
   protected:
@@ -27,7 +32,7 @@ class Interface {
 
   private:
     virtual void onZeroReferences() { delete this; }
-    RefCount references_;
+    volatile LONG references_;
 };
 
     
@@ -0,0 +1,60 @@
+#include "stdafx.h"
+
+#include "RecordingFile.h"
+#include "ObjFile.h"
+
+#include "Ptr/Ptr.in"
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// RecordingFile functions
+//////////////////////////////////////////////////////////////////////////////////
+
+RecordingFile::RecordingFile() :
+	serial(0),
+	active(0)
+{
+	InitializeCriticalSection(&lock);
+}
+
+RecordingFile::~RecordingFile() {
+	file = 0;
+	DeleteCriticalSection(&lock);
+}
+
+
+void RecordingFile::set(Ptr<ObjFile> _file) {
+	EnterCriticalSection(&lock);
+	file = _file;
+	InterlockedExchange(&active, file.rawPtr() != 0);
+	InterlockedIncrement(&serial);
+	LeaveCriticalSection(&lock);
+}
+
+Ptr<ObjFile> RecordingFile::get() {
+	EnterCriticalSection(&lock);
+	Ptr<ObjFile> current = file;
+	LeaveCriticalSection(&lock);
+	return current;
+}
+
+// The count is read again under the lock, so a change made after it
+// was first read is caught up with on the next call rather than lost.
+// The switch itself is made under the share group's lock, which is
+// what the frame end holds while it flushes the contexts still on the
+// old file.
+
+void RecordingFile::catchUp(OGLE *ogle) {
+	if(ogle->fileSerial == serial) return;
+
+	EnterCriticalSection(&lock);
+	Ptr<ObjFile> current = file;
+	LONG seen = serial;
+	LeaveCriticalSection(&lock);
+
+	if(ogle->objFile.rawPtr() != current.rawPtr()) {
+		OGLE::ShareGroup::Lock groupLock(ogle->shared.rawPtr());
+		ogle->startRecording(current);
+	}
+	ogle->fileSerial = seen;
+}
@@ -0,0 +1,52 @@
+#ifndef __RECORDINGFILE_H_
+#define __RECORDINGFILE_H_
+
+#include <windows.h>
+
+#include "ogle.h"
+
+class ObjFile;
+
+//////////////////////////////////////////////////////////////////////
+// RecordingFile -- the file every context writes to while a frame is
+// recorded, handed from the thread that ends the frame to the others.
+//
+// The file is only ever read or replaced under the lock, and a reader
+// takes its own reference before letting go of it, so a file can never
+// be freed between being read and being held.  Each change is also
+// counted; a context keeps the count it last caught up with, so the
+// lock is only taken on the first call after a change.
+//////////////////////////////////////////////////////////////////////
+
+class RecordingFile {
+
+  public:
+
+	RecordingFile();
+	~RecordingFile();
+
+	// the thread that ends the frame: start writing to file, or with
+	// 0 stop
+	void set(Ptr<ObjFile> file);
+	Ptr<ObjFile> get();
+
+	// from any thread, with no lock
+	bool isActive() const { return active != 0; }
+
+	// point ogle at the current file, if it has changed since ogle
+	// last looked
+	void catchUp(OGLE *ogle);
+
+  private:
+
+	CRITICAL_SECTION lock;
+	Ptr<ObjFile> file;
+	volatile LONG serial;
+	volatile LONG active;
+
+	// not copyable
+	RecordingFile(const RecordingFile &);
+	RecordingFile &operator=(const RecordingFile &);
+};
+
+#endif // __RECORDINGFILE_H_
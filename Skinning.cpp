@@ -0,0 +1,203 @@
+#include "stdafx.h"
+
+#include "ogle.h"
+#include "Trace.h"
+
+#include "Ptr/Ptr.in"
+
+#include <xmmintrin.h>
+#include <math.h>
+#include <algorithm>
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 34962
+#endif
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Linear blend skinning
+//////////////////////////////////////////////////////////////////////////////////
+
+// Skinned meshes arrive in bind pose, with the bone indices and weights
+// in the BoneIndexAttrib and BoneWeightAttrib streams and the pose in
+// the program's BonePaletteUniform.  The vertices the draws use are
+// posed here, and the plan pointed at the posed copy, so the transform
+// and output stages never know the difference.  False, with the plan
+// untouched, for anything that is not a skinned draw.
+
+bool OGLE::skinDraws(FetchPlan &plan, GLenum type, const SubDraw *draws, GLsizei n) {
+	TRACE_ZONE("skinning");
+	if(!currProgram || currProgram->palette.empty()) {
+		return false;
+	}
+
+	int bi = OGLE::config.boneIndexAttrib;
+	int bw = OGLE::config.boneWeightAttrib;
+	if(bi < 0 || bw < 0 || bi >= vao->attribs.size() || bw >= vao->attribs.size()) {
+		return false;
+	}
+
+	CArray *ia = vao->attribs[bi].rawPtr();
+	CArray *wa = vao->attribs[bw].rawPtr();
+	if(!ia || !ia->enabled || !wa || !wa->enabled) {
+		return false;
+	}
+
+	SkinJob proto;
+	if(ia->buffer) currentBuffer(GL_ARRAY_BUFFER, ia->buffer);
+	if(wa->buffer) currentBuffer(GL_ARRAY_BUFFER, wa->buffer);
+	if(!resolveStream(proto.bones, ia, ia->buffer) || !resolveStream(proto.weights, wa, wa->buffer)) {
+		return false;
+	}
+
+	// only the vertices the draws reference are posed
+	GLint lo, hi;
+	if(!drawRange(type, draws, n, lo, hi)) {
+		return false;
+	}
+
+	size_t nVerts = hi - lo + 1;
+	skinned.resize(nVerts * 8);
+
+	proto.v = &plan.v;
+	proto.n = plan.n.data ? &plan.n : 0;
+	proto.palette = &currProgram->palette[0];
+	proto.nBones = currProgram->palette.size() / 16;
+
+	// big meshes are split across the pool; a crowd of small ones is
+	// not worth waking it for
+	int nJobs = 1;
+	if(nVerts >= 4096 && OGLE::config.skinningThreads) {
+		if(!skinPool) {
+			int nThreads = OGLE::config.skinningThreads;
+			skinPool = new WorkerPool(nThreads < 0 ? WorkerPool::defaultThreadCount() : nThreads);
+		}
+		nJobs = std::max(skinPool->size() * 4, 1);
+	}
+
+	// rounding the share up can leave the last jobs with nothing to do,
+	// so only as many are made as the shares need
+	GLint per = (GLint)((nVerts + nJobs - 1) / nJobs);
+	nJobs = (int)((nVerts + per - 1) / per);
+
+	std::vector<SkinJob> jobs(nJobs, proto);
+	std::vector<WorkerPool::Job *> queue(nJobs);
+
+	for(int j = 0; j < nJobs; j++) {
+		jobs[j].first = lo + j * per;
+		jobs[j].last = std::min(hi, jobs[j].first + per - 1);
+		jobs[j].out = &skinned[8 * (size_t)(jobs[j].first - lo)];
+		queue[j] = &jobs[j];
+	}
+
+	if(nJobs > 1) {
+		skinPool->runAll(queue);
+	}
+	else {
+		jobs[0].run();
+	}
+
+	for(int j = 0; j < nJobs; j++) {
+		if(!jobs[j].ok) {
+			// some vertex could not be read; leave the draw in bind pose
+			return false;
+		}
+	}
+
+	// the copy starts at vertex lo, so index i is at i - lo
+	const GLsizei stride = 8 * sizeof(GLfloat);
+	const GLbyte *base = (const GLbyte *)&skinned[0] - (size_t)lo * stride;
+	const GLbyte *end = (const GLbyte *)(&skinned[0] + skinned.size());
+
+	plan.v.size = std::max(plan.v.size, 3);
+	plan.v.type = GL_FLOAT;
+	plan.v.stride = stride;
+	plan.v.bytes = plan.v.size * sizeof(GLfloat);
+	plan.v.normalized = false;
+	plan.v.data = base;
+	plan.v.end = end;
+
+	if(plan.n.data) {
+		plan.n.size = 3;
+		plan.n.type = GL_FLOAT;
+		plan.n.stride = stride;
+		plan.n.bytes = 3 * sizeof(GLfloat);
+		plan.n.normalized = false;
+		plan.n.data = base + 4 * sizeof(GLfloat);
+		plan.n.end = end;
+	}
+
+	return true;
+}
+
+
+// Each vertex's matrix is the weighted sum of its bones' palette
+// entries, built a column per register, and then applied like
+// transformPoints does.  Influences with no weight or a bone outside
+// the palette are skipped; a vertex with none left stays as it is.
+
+void OGLE::SkinJob::run() {
+	ok = 1;
+	if(first > last) return;
+
+	GLfloat *o = out;
+
+	for(GLint i = first; i <= last; i++, o += 8) {
+		GLfloat P[4] = { 0, 0, 0, 1 };
+		GLfloat N[4] = { 0, 0, 0, 0 };
+		GLfloat B[4] = { 0, 0, 0, 0 };
+		GLfloat W[4] = { 0, 0, 0, 0 };
+
+		if(!v->read(i, P)) {
+			ok = 0;
+			return;
+		}
+		if(n) n->read(i, N);
+		bones.read(i, B);
+		weights.read(i, W);
+
+		__m128 c0 = _mm_setzero_ps();
+		__m128 c1 = _mm_setzero_ps();
+		__m128 c2 = _mm_setzero_ps();
+		__m128 c3 = _mm_setzero_ps();
+		bool any = false;
+
+		for(int j = 0; j < 4; j++) {
+			int b = (int)B[j];
+			if(W[j] == 0 || b < 0 || b >= nBones) continue;
+
+			const GLfloat *M = palette + 16 * b;
+			__m128 w = _mm_set1_ps(W[j]);
+
+			c0 = _mm_add_ps(c0, _mm_mul_ps(w, _mm_loadu_ps(M)));
+			c1 = _mm_add_ps(c1, _mm_mul_ps(w, _mm_loadu_ps(M + 4)));
+			c2 = _mm_add_ps(c2, _mm_mul_ps(w, _mm_loadu_ps(M + 8)));
+			c3 = _mm_add_ps(c3, _mm_mul_ps(w, _mm_loadu_ps(M + 12)));
+			any = true;
+		}
+
+		if(!any) {
+			memcpy(o, P, sizeof(P));
+			memcpy(o + 4, N, sizeof(N));
+			continue;
+		}
+
+		__m128 p = _mm_mul_ps(c0, _mm_set1_ps(P[0]));
+		p = _mm_add_ps(p, _mm_mul_ps(c1, _mm_set1_ps(P[1])));
+		p = _mm_add_ps(p, _mm_mul_ps(c2, _mm_set1_ps(P[2])));
+		p = _mm_add_ps(p, _mm_mul_ps(c3, _mm_set1_ps(P[3])));
+		_mm_storeu_ps(o, p);
+
+		// blending shortens normals, so they are renormalized
+		__m128 q = _mm_mul_ps(c0, _mm_set1_ps(N[0]));
+		q = _mm_add_ps(q, _mm_mul_ps(c1, _mm_set1_ps(N[1])));
+		q = _mm_add_ps(q, _mm_mul_ps(c2, _mm_set1_ps(N[2])));
+		_mm_storeu_ps(o + 4, q);
+
+		GLfloat len = sqrtf(o[4] * o[4] + o[5] * o[5] + o[6] * o[6]);
+		if(len > 0) {
+			o[4] /= len; o[5] /= len; o[6] /= len;
+		}
+		o[7] = 0;
+	}
+}
@@ -1,28 +1,28 @@
-// stdafx.h : include file for standard system include files,
-//  or project specific include files that are used frequently, but
-//      are changed infrequently
-//
-
-#if !defined(AFX_STDAFX_H__4FC50735_A7BA_4654_8071_67117FEA0C5A__INCLUDED_)
-#define AFX_STDAFX_H__4FC50735_A7BA_4654_8071_67117FEA0C5A__INCLUDED_
-
-#if _MSC_VER > 1000
-#pragma once
-#endif // _MSC_VER > 1000
-
-
-// Insert your headers here
-#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
-
-#include <windows.h>
-
-#ifdef _MSC_VER
-#pragma warning (disable:4786)   // No complaints about debug symbol length
-#endif // _MSC_VER 
-
-
-
-//{{AFX_INSERT_LOCATION}}
-// Microsoft Visual C++ will insert additional declarations immediately before the previous line.
-
-#endif // !defined(AFX_STDAFX_H__4FC50735_A7BA_4654_8071_67117FEA0C5A__INCLUDED_)
+// stdafx.h : include file for standard system include files,
+//  or project specific include files that are used frequently, but
+//      are changed infrequently
+//
+
+#if !defined(AFX_STDAFX_H__4FC50735_A7BA_4654_8071_67117FEA0C5A__INCLUDED_)
+#define AFX_STDAFX_H__4FC50735_A7BA_4654_8071_67117FEA0C5A__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+
+// Insert your headers here
+#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+
+#include <windows.h>
+
+#ifdef _MSC_VER
+#pragma warning (disable:4786)   // No complaints about debug symbol length
+#endif // _MSC_VER 
+
+
+
+//{{AFX_INSERT_LOCATION}}
+// Microsoft Visual C++ will insert additional declarations immediately before the previous line.
+
+#endif // !defined(AFX_STDAFX_H__4FC50735_A7BA_4654_8071_67117FEA0C5A__INCLUDED_)
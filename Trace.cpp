@@ -0,0 +1,158 @@
+#include "stdafx.h"
+
+#include "Trace.h"
+
+#ifdef OGLE_ENABLE_TRACE
+
+#include "ogle.h"
+
+#include "Ptr/Ptr.in"
+
+#include <algorithm>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+// Trace functions
+//////////////////////////////////////////////////////////////////////////////////
+
+volatile bool Trace::active = false;
+
+// Buffers are made the first time a thread closes a zone, and kept for
+// as long as the DLL is loaded.
+
+static struct TraceThreads {
+	TraceThreads() {
+		slot = TlsAlloc();
+		InitializeCriticalSection(&lock);
+		frameStart = 0;
+	}
+
+	DWORD slot;
+	CRITICAL_SECTION lock;
+	LONGLONG frameStart;
+	std::string fileName;
+} traceThreads;
+
+std::vector<Trace::Buffer *> Trace::buffers;
+
+
+Trace::Buffer::Buffer() :
+	thread(GetCurrentThreadId()),
+	nDropped(0)
+{
+	InitializeCriticalSection(&lock);
+}
+
+Trace::Buffer *Trace::threadBuffer() {
+	Buffer *buffer = (Buffer *)TlsGetValue(traceThreads.slot);
+	if(buffer) return buffer;
+
+	buffer = new Buffer();
+
+	EnterCriticalSection(&traceThreads.lock);
+	buffers.push_back(buffer);
+	LeaveCriticalSection(&traceThreads.lock);
+
+	TlsSetValue(traceThreads.slot, buffer);
+	return buffer;
+}
+
+void Trace::add(const char *name, LONGLONG start, LONGLONG end) {
+	Buffer *buffer = threadBuffer();
+
+	EnterCriticalSection(&buffer->lock);
+	if(buffer->events.size() < MAX_EVENTS) {
+		Event e = { name, start, end };
+		buffer->events.push_back(e);
+	}
+	else {
+		buffer->nDropped++;
+	}
+	LeaveCriticalSection(&buffer->lock);
+}
+
+
+void Trace::beginFrame(const std::string &fileName) {
+	EnterCriticalSection(&traceThreads.lock);
+	std::vector<Buffer *> current(buffers);
+	traceThreads.fileName = fileName;
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	traceThreads.frameStart = now.QuadPart;
+	LeaveCriticalSection(&traceThreads.lock);
+
+	for(size_t i = 0; i < current.size(); i++) {
+		Buffer *buffer = current[i];
+
+		EnterCriticalSection(&buffer->lock);
+		buffer->events.clear();
+		buffer->nDropped = 0;
+		LeaveCriticalSection(&buffer->lock);
+	}
+
+	active = true;
+}
+
+// Each thread's zones are taken under its lock and written without it,
+// so a thread still running zones only waits for the swap.
+
+void Trace::endFrame() {
+	if(!active) return;
+	active = false;
+
+	EnterCriticalSection(&traceThreads.lock);
+	std::vector<Buffer *> current(buffers);
+	LONGLONG frameStart = traceThreads.frameStart;
+	std::string fileName = traceThreads.fileName;
+	LeaveCriticalSection(&traceThreads.lock);
+
+	FILE *file = fopen(fileName.c_str(), "w");
+	if(!file) {
+		fprintf(OGLE::LOG, "Trace: unable to open %s\n", fileName.c_str());
+		return;
+	}
+
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	double usPerTick = 1000000.0 / freq.QuadPart;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	size_t nEvents = 0;
+	unsigned int nDropped = 0;
+
+	for(size_t i = 0; i < current.size(); i++) {
+		Buffer *buffer = current[i];
+		std::vector<Event> events;
+
+		EnterCriticalSection(&buffer->lock);
+		events.swap(buffer->events);
+		nDropped += buffer->nDropped;
+		buffer->nDropped = 0;
+		LeaveCriticalSection(&buffer->lock);
+
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+			i ? ",\n" : "", (unsigned int)buffer->thread, (unsigned int)i);
+
+		for(size_t k = 0; k < events.size(); k++) {
+			const Event &e = events[k];
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"ogle\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+				e.name, (e.start - frameStart) * usPerTick, (e.end - e.start) * usPerTick,
+				(unsigned int)buffer->thread);
+		}
+		nEvents += events.size();
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	fprintf(OGLE::LOG, "Trace: %u zones from %u threads to %s",
+		(unsigned int)nEvents, (unsigned int)current.size(), fileName.c_str());
+	if(nDropped) {
+		fprintf(OGLE::LOG, ", %u dropped", nDropped);
+	}
+	fprintf(OGLE::LOG, "\n");
+}
+
+#endif // OGLE_ENABLE_TRACE
@@ -0,0 +1,98 @@
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+//////////////////////////////////////////////////////////////////////
+// Trace -- a timeline of OGLE's own work, for chrome://tracing or
+// Perfetto.
+//
+// TRACE_ZONE("name") times the rest of the enclosing block.  Zones go
+// to a buffer belonging to the thread that ran them, and only while a
+// frame is being recorded; at the end of the frame they are written
+// out as Chrome trace JSON, one file per frame.
+//
+// All of it is compiled in only with OGLE_ENABLE_TRACE in the
+// project's preprocessor definitions; without it the macros are empty.
+//////////////////////////////////////////////////////////////////////
+
+#ifdef OGLE_ENABLE_TRACE
+
+#include <windows.h>
+
+#include <string>
+#include <vector>
+
+class Trace {
+
+  public:
+
+	class Zone {
+		public:
+			Zone(const char *_name) : name(_name) {
+				start.QuadPart = 0;
+				if(active) QueryPerformanceCounter(&start);
+			}
+
+			~Zone() {
+				if(!start.QuadPart) return;
+
+				LARGE_INTEGER end;
+				QueryPerformanceCounter(&end);
+				Trace::add(name, start.QuadPart, end.QuadPart);
+			}
+
+		private:
+			const char *name;
+			LARGE_INTEGER start;
+	};
+
+	// start collecting, dropping anything left from before, for
+	// endFrame to write to fileName
+	static void beginFrame(const std::string &fileName);
+	static void endFrame();
+
+	static void add(const char *name, LONGLONG start, LONGLONG end);
+
+	static volatile bool active;
+
+  private:
+
+	struct Event {
+		const char *name;
+		LONGLONG start, end;
+	};
+
+	// one thread's zones.  The lock is only ever contended while a
+	// frame is written out.
+	class Buffer {
+		public:
+			Buffer();
+
+			std::vector<Event> events;
+			CRITICAL_SECTION lock;
+			DWORD thread;
+			unsigned int nDropped;
+	};
+
+	enum { MAX_EVENTS = 1 << 20 };
+
+	static Buffer *threadBuffer();
+
+	static std::vector<Buffer *> buffers;
+};
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+
+#define TRACE_ZONE(name) Trace::Zone TRACE_JOIN(traceZone, __LINE__)(name)
+#define TRACE_BEGIN_FRAME(fileName) Trace::beginFrame(fileName)
+#define TRACE_END_FRAME() Trace::endFrame()
+
+#else
+
+#define TRACE_ZONE(name)
+#define TRACE_BEGIN_FRAME(fileName)
+#define TRACE_END_FRAME()
+
+#endif // OGLE_ENABLE_TRACE
+
+#endif // __TRACE_H_
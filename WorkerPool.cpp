@@ -0,0 +1,128 @@
+#include "stdafx.h"
+
+#include "WorkerPool.h"
+
+#include "Ptr/Ptr.in"
+
+
+WorkerPool::WorkerPool(int nThreads) : stopping(0) {
+	InitializeCriticalSection(&lock);
+	InitializeConditionVariable(&jobReady);
+	InitializeConditionVariable(&jobDone);
+
+	for(int i = 0; i < nThreads; i++) {
+		HANDLE h = CreateThread(NULL, 0, threadMain, this, 0, NULL);
+		if(h) {
+			threads.push_back(h);
+		}
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	EnterCriticalSection(&lock);
+	stopping = 1;
+	WakeAllConditionVariable(&jobReady);
+	LeaveCriticalSection(&lock);
+
+	for(int i = 0; i < threads.size(); i++) {
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+	}
+
+	DeleteCriticalSection(&lock);
+}
+
+int WorkerPool::defaultThreadCount() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+
+	// leave one core for the application's render thread
+	return info.dwNumberOfProcessors > 1 ? info.dwNumberOfProcessors - 1 : 0;
+}
+
+
+void WorkerPool::submit(Job *job) {
+	job->done = 0;
+
+	EnterCriticalSection(&lock);
+	queue.push_back(job);
+	WakeConditionVariable(&jobReady);
+	LeaveCriticalSection(&lock);
+}
+
+void WorkerPool::wait(Job *job) {
+	while(!job->done) {
+		// help out rather than sleep while there is queued work
+		Job *next = popJob();
+		if(next) {
+			runJob(next);
+			continue;
+		}
+
+		EnterCriticalSection(&lock);
+		if(!job->done) {
+			SleepConditionVariableCS(&jobDone, &lock, INFINITE);
+		}
+		LeaveCriticalSection(&lock);
+	}
+}
+
+void WorkerPool::runAll(std::vector<Job *> &jobs) {
+	int i;
+
+	for(i = 0; i < jobs.size(); i++) {
+		submit(jobs[i]);
+	}
+
+	for(i = 0; i < jobs.size(); i++) {
+		wait(jobs[i]);
+	}
+}
+
+
+WorkerPool::Job *WorkerPool::popJob() {
+	Job *job = 0;
+
+	EnterCriticalSection(&lock);
+	if(!queue.empty()) {
+		job = queue.front();
+		queue.pop_front();
+	}
+	LeaveCriticalSection(&lock);
+
+	return job;
+}
+
+void WorkerPool::runJob(Job *job) {
+	job->run();
+
+	EnterCriticalSection(&lock);
+	job->done = 1;
+	WakeAllConditionVariable(&jobDone);
+	LeaveCriticalSection(&lock);
+}
+
+DWORD WINAPI WorkerPool::threadMain(LPVOID param) {
+	WorkerPool *pool = (WorkerPool *)param;
+
+	for(;;) {
+		Job *job = 0;
+
+		EnterCriticalSection(&pool->lock);
+		while(pool->queue.empty() && !pool->stopping) {
+			SleepConditionVariableCS(&pool->jobReady, &pool->lock, INFINITE);
+		}
+		if(!pool->queue.empty()) {
+			job = pool->queue.front();
+			pool->queue.pop_front();
+		}
+		LeaveCriticalSection(&pool->lock);
+
+		if(!job) {
+			// stopping, and nothing left to do
+			return 0;
+		}
+
+		pool->runJob(job);
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef __WORKERPOOL_H_
+#define __WORKERPOOL_H_
+
+#include <windows.h>
+
+#include <vector>
+#include <deque>
+
+#include "Ptr/Interface.h"
+#include "Ptr/Ptr.h"
+
+//////////////////////////////////////////////////////////////////////
+// WorkerPool -- a small fixed set of threads that run Jobs.
+//
+// Jobs are owned by the caller and must stay alive until they are
+// done.  A thread that waits on a job helps by running queued jobs
+// itself, so a pool of size 0 still works (everything runs inline).
+//////////////////////////////////////////////////////////////////////
+
+class WorkerPool : public Interface {
+
+  public:
+
+	class Job {
+		public:
+			Job() : done(0) {}
+			virtual ~Job() {}
+
+			virtual void run() = 0;
+
+			volatile LONG done;
+	};
+
+
+	WorkerPool(int nThreads);
+	~WorkerPool();
+
+	void submit(Job *job);
+	void wait(Job *job);
+	void runAll(std::vector<Job *> &jobs);
+
+	int size() const { return (int)threads.size(); }
+
+	static int defaultThreadCount();
+
+  private:
+
+	static DWORD WINAPI threadMain(LPVOID param);
+
+	Job *popJob();
+	void runJob(Job *job);
+
+	std::vector<HANDLE> threads;
+	std::deque<Job *> queue;
+
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE jobReady;
+	CONDITION_VARIABLE jobDone;
+	bool stopping;
+};
+
+typedef Ptr<WorkerPool> WorkerPoolPtr;
+
+#endif // __WORKERPOOL_H_
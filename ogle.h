@@ -1,403 +1,1179 @@
-#ifndef __OGLE_H_
-#define __OGLE_H_
-
-#include <gl/gl.h>
-
-#include "../../MainLib/InterceptPluginInterface.h"
-
-#undef min
-#undef max
-
-#include "mtl/mtl.h"
-#include "mtl/matrix.h"
-
-#include <vector>
-#include <deque>
-#include <map>
-#include <string>
-
-
-#define OGLE_BIND_BUFFERS_ALL_FRAMES 1
-#define OGLE_CAPTURE_BUFFERS_ALL_FRAMES 0
-
-#define OGLE_N_BUFFERS (4096*2)
-
-#include "Ptr/Interface.h"
-#include "Ptr/Ptr.h"
-
-class ObjFile;
-
-class OGLE : public Interface {
-
-public:
-
-	// Classes for 4x4 Matrices and 4x1 Vectors, 
-	// the typical mathematical components of OpenGL calculations
-
-	typedef mtl::matrix < float >::type Transform;
-    typedef mtl::dense1D < float > Vector;
-
-	//////////////////////////////////////////////////////////////////////
-	// OGLE::Vertex -- Class for OpenGL Vertexinate
-	//////////////////////////////////////////////////////////////////////
-
-	class Vertex : public Interface {
-		public:
-			GLfloat x,y,z,w;
-			GLbyte size;
-
-			inline Vertex();
-			inline Vertex(Vector v);
-			inline Vertex(const GLfloat *v, GLint n);
-			inline Vertex(GLfloat _x, GLfloat _y, GLfloat _z = 0, GLfloat _w = 1);
-
-			inline void init(GLfloat _x = 0, GLfloat _y = 0, GLfloat _z = 0, GLfloat _w = 1);
-			inline void fromVector(Vector v);
-
-			inline Vector toVector();
-	};
-	typedef Ptr<Vertex> VertexPtr;
-
-	//////////////////////////////////////////////////////////////////////
-	// OGLE::Element -- Class for an OpenGL 'Element' which can have a 
-	// Vertex (location), as well as a Normal and a Texture coordinate
-	//////////////////////////////////////////////////////////////////////
-
-	class Element : public Interface {
-		public:	
-			Element() { v = 0; t = 0; n = 0; }
-
-			Element(VertexPtr _v, VertexPtr _t = 0, VertexPtr _n = 0) {
-				v = _v; t = _t; n = _n;
-			}
-
-			VertexPtr v,t,n;
-	};
-	typedef Ptr<Element> ElementPtr;
-
-	typedef std::vector<ElementPtr> ElementVec;
-	typedef std::vector<VertexPtr> VertexVec;
-
-
-	//////////////////////////////////////////////////////////////////////
-	// OGLE::ElementSet -- Class for a set of OpenGL vertices
-	//////////////////////////////////////////////////////////////////////	
-
-	class ElementSet : public Interface {
-		public:
-			ElementSet(GLenum _mode, Transform _transform, Transform _texCoordTransform);
-			ElementSet(GLenum _mode);
-
-  			// add a Element with just a location Vertex
-			void addElement(const GLfloat V[], GLsizei dim);
-			void addElement(VertexPtr V);
-			void addElement(ElementPtr E);
-
-			bool hasTransform;
-			Transform transform;	
-			Transform texCoordTransform;	
-			//vector<VertexPtr> vertices;
-
-			vector<ElementPtr> elements;
-
-			GLenum mode;
-	};
-	typedef Ptr<ElementSet> ElementSetPtr;
-
-
-	//////////////////////////////////////////////////////////////////////
-	// OGLE::Blob -- Class for polymorphic storage of small primitive types
-	//////////////////////////////////////////////////////////////////////	
-
-	class Blob : public Interface {
-		private:
-			char d[16];
-
-		public:
-			Blob(const GLint v) { *((GLint *)d) = v; }
-			const GLint toInt() { return *((GLint *)d); } 
-			const GLuint toUInt() { return *((GLuint *)d); } 
-			const GLsizei toSizeI() { return *((GLsizei *)d); } 
-
-			Blob(const GLboolean v) { *((GLboolean *)d) = v; }
-			const GLboolean toBool() { return *((GLboolean *)d); } 
-
-			Blob(const GLfloat v) { *((GLfloat *)d) = v; }
-			const GLfloat toFloat() { return *((GLfloat *)d); } 
-			
-			Blob(const GLenum v) { *((GLenum *)d) = v; }
-			const GLenum toEnum() { return *((GLenum *)d); } 
-			
-			Blob(const GLvoid *v) {*((const GLvoid **)d) = v;}
-			const GLvoid * toVoidP() { return *((const GLvoid **)d);}			
-	};
-			
-	typedef Ptr<Blob> BlobPtr;
-
-
-	//////////////////////////////////////////////////////////////////////
-	// OGLE::Buffer -- Class for a buffer
-	//////////////////////////////////////////////////////////////////////	
-
-	class Buffer : public Interface {
-		public:
-			GLvoid *ptr;
-			GLsizei size;
-
-			GLvoid *map;
-			GLenum mapAccess;
-
-			inline Buffer(const GLvoid *_ptr, GLsizei _size);
-			inline ~Buffer();
-	};
-				
-	typedef Ptr<Buffer> BufferPtr;
-
-
-	class CArray : public Interface {
-
-	  public:
-		GLboolean	enabled;
-		GLint		size;
-		GLenum		type;
-		GLsizei		stride;
-		const GLbyte*	data;
-
-		inline CArray();
-	};
-
-	typedef Ptr<CArray> CArrayPtr;
-
-
-	struct ltstr
-	{
-	  bool operator()(const char* s1, const char* s2) const
-	  { return strcmp(s1, s2) < 0; }
-	};
-
-
-	//////////////////////////////////////////////////////////////////////
-	// OGLE::Config -- Class for all OGLE config options
-	//////////////////////////////////////////////////////////////////////	
-
-	struct Config {
-		public: 
-			float scale;
-			bool logFunctions;
-			bool captureNormals;
-			bool captureTexCoords;
-			bool flipPolyStrips;
-			map<const char*, bool, ltstr>polyTypesEnabled;			
-
-			static char *polyTypes[];
-			static int nPolyTypes;
-
-			inline Config();
-	};
-
-
-	////////////////////////////////////////////////////////////////////////
-	// OGLE -- the class for actually doing the OpenGLExtraction
-	////////////////////////////////////////////////////////////////////////
-
-
-	OGLE(InterceptPluginCallbacks *_callBacks, const GLCoreDriver *_GLV);
-
-		
-	void startRecording(string _objFileName);
-	void stopRecording();
-
-	void addSet(ElementSetPtr set);
-	void newSet(GLenum mode);
-
-	void glBegin (GLenum mode);
-	void glEnd ();
-
-	void glVertexfv(GLfloat *V, GLsizei n);
-	void glNormalfv(GLfloat *V, GLsizei n);
-	void glTexCoordfv(GLfloat *V, GLsizei n);
-
-	void glArrayElement (GLint i);
-	void glDrawElements (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices);
-	void glDrawArrays (GLenum mode, GLint first, GLsizei count);
-	void glEnableClientState (GLenum array);
-	void glDisableClientState (GLenum array);
-	void glVertexPointer (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
-	void glNormalPointer (GLenum type, GLsizei stride, const GLvoid *pointer);
-
-	void glInterleavedArrays(GLenum format, GLsizei stride, const GLvoid *pointer);
-
-
-	void glClientActiveTexture(GLenum texture);
-	void glTexCoordPointer (GLint	size, GLenum type, GLsizei stride, const GLvoid *pointer);
-	
-
-	void glDrawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const GLvoid *indices);
-	void glLockArraysEXT(GLint first, GLsizei count);
-	void glUnlockArraysEXT();
-	void glBindBuffer(GLenum target, GLuint buffer);
-	void glBufferData(GLenum target, GLsizei size, const GLvoid *data, GLenum usage);
-	void glBufferSubData(GLenum target, GLint offset, GLsizei size, const GLvoid *data);
-	void glMapBuffer(GLenum target, GLenum access);
-	void glMapBufferPost(GLvoid *retValue);
-	void glUnmapBuffer(GLenum target);
-
-	void initFunctions();
-	Transform getCurrTransform(GLenum type = GL_MODELVIEW_MATRIX);
-
-	GLint derefClientArray(CArray *arr, GLfloat *v, GLint i);
-
-	GLuint getBufferIndex(GLenum target);
-	const GLbyte *OGLE::getBufferedArray(const GLbyte *array);
-	const GLvoid *getBufferedIndices(const GLvoid *indices);
-	void checkBuffers();
-
-	bool isElementLocked(int index);
-
-
-
-	InterceptPluginCallbacks *callBacks;
-    const GLCoreDriver       *GLV;                  //The core OpenGL driver
-	std::map<const char*, BlobPtr, ltstr> glState;
-
-	CArray vArray;
-	CArray nArray;
-	CArrayPtr tArray;
-	CArrayPtr tArrayActive;
-	
-	std::vector<CArrayPtr> tArrays;
-	GLint activeClientTex;
-
-	std::vector<BufferPtr> buffers;
-
-	bool extensionVBOSupported;
-	void    (GLAPIENTRY *iglGetBufferSubData) (GLenum, GLint, GLsizei, GLvoid *);
-
-    Ptr<ElementSet> currSet;
-    VertexPtr currTexCoord, currNormal;
-	std::vector<ElementSetPtr> sets;
-
-
-	string objFileName;
-
-	Ptr<ObjFile> objFile;
-
-
-
-	//////////////////////////////////////////////////////////////////////////////
-	// Static methods and variables for the OGLE class
-
-	static void init();
-
-	static GLfloat derefVertexArray(const GLbyte *array, GLint dim, GLenum type, GLsizei stride, GLint vindex, GLint index);
-	static GLint derefIndexArray(GLenum type, const GLvoid *indices, int i);
-
-	static VertexPtr doTransform(VertexPtr vp, Transform T);
-	static bool isIdentityTransform(Transform T);
-	static GLsizei glTypeSize(GLenum type);
-
-	static FILE *LOG;
-	static Config config;
-};
-
-typedef Ptr<OGLE> OGLEPtr;
-
-
-
-
-
-
-OGLE::CArray::CArray() {
-	enabled = false;
-	size = 4;
-	type = GL_FLOAT;
-	stride = 0;
-	data = NULL;
-}
-
-
-/////////////////////////////////////////////////////////////////////////////////
-//
-// OGLE::Vertex Short/obvious Methods
-//
-/////////////////////////////////////////////////////////////////////////////////
-
-
-
-
-OGLE::Vertex::Vertex() {
-	init();
-}
-
-OGLE::Vertex::Vertex(GLfloat _x, GLfloat _y, GLfloat _z, GLfloat _w) {
-	init(x,y,z,w);
-}
-
-
-void OGLE::Vertex::init(GLfloat _x, GLfloat _y, GLfloat _z, GLfloat _w) {
-			x = _x; y = _y; z = _z; w = _w;
-			size = 4;
-}
-
-OGLE::Vertex::Vertex(Vector v) {
-	init();
-	this->fromVector(v);
-}
-
-OGLE::Vertex::Vertex(const GLfloat *v, GLint n) {
-	  init();
-	  Vector V(n);
-	  for(int i = 0; i < n; i++) {
-		  V[i] = (float)v[i];
-	  }
-	  this->fromVector(V);
-	  size = n;
-}
-
-void OGLE::Vertex::fromVector(Vector v) {
-	switch (v.size()) {
-	case 4: w = v[3];
-	case 3: z = v[2];
-	case 2: y = v[1];
-	case 1: x = v[0];				
-	}
-	size = v.size();
-}
-
-
-OGLE::Vector OGLE::Vertex::toVector() {
-	Vector v(4);
-	v[0] = x; v[1] = y; v[2] = z; v[3] = w;
-	return v;
-}
-
-OGLE::Buffer::Buffer(const GLvoid *_ptr, GLsizei _size) {
-	size = _size;
-	ptr = malloc(size);
-
-	map = 0;
-	mapAccess = 0;
-
-	if(_ptr) {
-		memcpy(ptr, _ptr, size);
-	}
-}
-
-OGLE::Buffer::~Buffer() {
-	if(ptr) free(ptr);
-}
-
-
-
-OGLE::Config::Config() : scale(1), logFunctions(0), 
-						 captureNormals(0), captureTexCoords(0), 
-						 flipPolyStrips(1) {
-	for(int i = 0; i < OGLE::Config::nPolyTypes; i++) {
-		const char *type = OGLE::Config::polyTypes[i];
-		polyTypesEnabled[type] = 1;
-	}						
-}
-
-
-#endif // __OGLE_H_
-
+#ifndef __OGLE_H_
+#define __OGLE_H_
+
+#include <gl/gl.h>
+
+#include "../../MainLib/InterceptPluginInterface.h"
+
+#undef min
+#undef max
+
+#include "mtl/mtl.h"
+#include "mtl/matrix.h"
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+
+
+#define OGLE_BIND_BUFFERS_ALL_FRAMES 1
+#define OGLE_CAPTURE_BUFFERS_ALL_FRAMES 0
+
+#include "Ptr/Interface.h"
+#include "Ptr/Ptr.h"
+
+#include "BufferPool.h"
+#include "WorkerPool.h"
+
+#ifndef GL_VERSION_1_5
+typedef ptrdiff_t GLintptr;
+typedef ptrdiff_t GLsizeiptr;
+#endif
+
+class ObjFile;
+
+class OGLE : public Interface {
+
+public:
+
+	// Classes for 4x4 Matrices and 4x1 Vectors, 
+	// the typical mathematical components of OpenGL calculations
+
+	typedef mtl::matrix < float >::type Transform;
+    typedef mtl::dense1D < float > Vector;
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::Vertex -- Class for OpenGL Vertexinate
+	//////////////////////////////////////////////////////////////////////
+
+	class Vertex : public Interface {
+		public:
+			GLfloat x,y,z,w;
+			GLbyte size;
+
+			inline Vertex();
+			inline Vertex(Vector v);
+			inline Vertex(const GLfloat *v, GLint n);
+			inline Vertex(GLfloat _x, GLfloat _y, GLfloat _z = 0, GLfloat _w = 1);
+
+			inline void init(GLfloat _x = 0, GLfloat _y = 0, GLfloat _z = 0, GLfloat _w = 1);
+			inline void fromVector(Vector v);
+
+			inline Vector toVector();
+	};
+	typedef Ptr<Vertex> VertexPtr;
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::Element -- Class for an OpenGL 'Element' which can have a 
+	// Vertex (location), as well as a Normal and a Texture coordinate
+	//////////////////////////////////////////////////////////////////////
+
+	class Element : public Interface {
+		public:	
+			Element() { v = 0; t = 0; n = 0; c = 0; }
+
+			Element(VertexPtr _v, VertexPtr _t = 0, VertexPtr _n = 0, VertexPtr _c = 0) {
+				v = _v; t = _t; n = _n; c = _c;
+			}
+
+			// c is the colour, r g b a in x y z w
+			VertexPtr v,t,n,c;
+	};
+	typedef Ptr<Element> ElementPtr;
+
+	typedef std::vector<ElementPtr> ElementVec;
+	typedef std::vector<VertexPtr> VertexVec;
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::ElementSet -- Class for a set of OpenGL vertices
+	//////////////////////////////////////////////////////////////////////	
+
+	class ElementSet : public Interface {
+		public:
+			ElementSet(GLenum _mode, Transform _transform, Transform _texCoordTransform, bool _deferred = false);
+			ElementSet(GLenum _mode);
+
+  			// add a Element with just a location Vertex
+			void addElement(const GLfloat V[], GLsizei dim);
+			void addElement(VertexPtr V);
+			void addElement(ElementPtr E);
+
+			// add an Element that has already been through this set's
+			// transform and the configured scale, e.g. from a LockCache
+			void addTransformedElement(ElementPtr E) { elements.push_back(E); }
+
+			// a deferred set keeps its elements as they came until place()
+			// is called, so the transform can be done on another thread
+			void place();
+			void placeElement(Element &E);
+
+			bool hasTransform;
+			bool deferred;
+			bool coalesce;		// may go out as part of a bigger set; see OGLE::addSet
+			Transform transform;	
+			Transform texCoordTransform;	
+			//vector<VertexPtr> vertices;
+
+			vector<ElementPtr> elements;
+
+			GLenum mode;
+	};
+	typedef Ptr<ElementSet> ElementSetPtr;
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::Blob -- Class for polymorphic storage of small primitive types
+	//////////////////////////////////////////////////////////////////////	
+
+	class Blob : public Interface {
+		private:
+			char d[16];
+
+		public:
+			Blob(const GLint v) { *((GLint *)d) = v; }
+			const GLint toInt() { return *((GLint *)d); } 
+			const GLuint toUInt() { return *((GLuint *)d); } 
+			const GLsizei toSizeI() { return *((GLsizei *)d); } 
+
+			Blob(const GLboolean v) { *((GLboolean *)d) = v; }
+			const GLboolean toBool() { return *((GLboolean *)d); } 
+
+			Blob(const GLfloat v) { *((GLfloat *)d) = v; }
+			const GLfloat toFloat() { return *((GLfloat *)d); } 
+			
+			Blob(const GLenum v) { *((GLenum *)d) = v; }
+			const GLenum toEnum() { return *((GLenum *)d); } 
+			
+			Blob(const GLvoid *v) {*((const GLvoid **)d) = v;}
+			const GLvoid * toVoidP() { return *((const GLvoid **)d);}			
+	};
+			
+	typedef Ptr<Blob> BlobPtr;
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::Buffer -- Class for a buffer
+	//////////////////////////////////////////////////////////////////////	
+
+	struct Range {
+		GLintptr offset;
+		GLsizeiptr length;
+	};
+
+	class Buffer : public Interface {
+		public:
+			GLuint name;
+			GLvoid *ptr;
+			GLsizei size;
+			GLenum usage;
+
+			// bytes actually held by ptr, from the BufferPool
+			size_t capacity;
+
+			// the mapped range, if any; mapAccess holds GL_MAP_*_BIT flags
+			GLvoid *map;
+			GLbitfield mapAccess;
+			GLintptr mapOffset;
+			GLsizeiptr mapLength;
+
+			// whether the shadow was current when the map was made, so
+			// copying back what is written through it keeps it current
+			bool mapCurrent;
+
+			// written ranges of the mapping not yet copied to the shadow
+			std::vector<Range> dirty;
+
+			// bumped on every change to the contents we observe; the
+			// shadow in ptr is current when fetchedGeneration matches
+			unsigned int generation;
+			unsigned int fetchedGeneration;
+
+			// bound where shaders or transform feedback can write it, so
+			// any draw or dispatch may have changed it without our seeing
+			bool gpuWritable;
+
+			// position in the owning BufferStore's LRU list
+			std::list<Buffer *>::iterator lruPos;
+			bool inLru;
+
+			inline Buffer(const GLvoid *_ptr, GLsizei _size, GLuint _name = 0, GLenum _usage = 0, bool shadow = true);
+			inline ~Buffer();
+
+			void addDirty(GLintptr offset, GLsizeiptr length);
+			bool dirtyCovers(GLintptr offset, GLsizeiptr length) const;
+			void copyDirty();
+
+			inline void respecify(const GLvoid *_ptr, GLsizei _size, GLenum _usage, bool shadow);
+			inline bool allocate();
+			inline void deallocate();
+
+			inline bool isClean(bool canReadBack) const;
+			inline bool isCurrent() const;
+	};
+				
+	typedef Ptr<Buffer> BufferPtr;
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::BufferStore -- shadow copies of the application's buffer
+	// objects, indexed by GL buffer name.  Keeps the total size of the
+	// shadows under a budget by dropping the least recently used ones
+	// that can be read back from GL again when next drawn.
+	//////////////////////////////////////////////////////////////////////
+
+	class BufferStore : public Interface {
+		public:
+			BufferStore();
+			~BufferStore();
+
+			BufferPtr find(GLuint name);
+			BufferPtr create(GLuint name, const GLvoid *data, GLsizei size, GLenum usage, bool shadow = true);
+			void remove(GLuint name);
+
+			void modified(Buffer *buff) { buff->generation = ++generations; }
+
+			// (re)allocate an evicted shadow and mark it recently used
+			bool restore(Buffer *buff);
+			void touch(Buffer *buff);
+
+			void enforceBudget(bool canReadBack, GLuint keep1 = 0, GLuint keep2 = 0);
+
+			size_t budget;
+			size_t bytes;
+			int nEvicted;
+
+			// changes whenever a name is given a new Buffer or loses one,
+			// so holders of BufferPtrs can tell theirs may be stale
+			unsigned int epoch;
+
+			unsigned int generations;
+
+		private:
+			void unlink(Buffer *buff);
+			void release(Buffer *buff);
+
+			std::unordered_map<GLuint, BufferPtr> buffers;
+
+			// most recently used at the front
+			std::list<Buffer *> lru;
+	};
+
+	typedef Ptr<BufferStore> BufferStorePtr;
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::FetchPlan -- where a draw's vertices, normals and texture
+	// coordinates come from, resolved once per draw instead of once per
+	// element and component.
+	//////////////////////////////////////////////////////////////////////
+
+	struct FetchPlan {
+		struct Stream {
+			const GLbyte *data;
+			// one past the end of the buffer shadow, 0 for client memory
+			const GLbyte *end;
+			const Buffer *buffer;
+			GLint size;
+			GLenum type;
+			GLsizei stride;
+			// size of one element's components
+			GLsizei bytes;
+			// integer types map to [0,1] or [-1,1]
+			bool normalized;
+
+			inline bool read(GLint i, GLfloat *v) const;
+		};
+
+		// data is 0 for a stream that is not fetched
+		Stream v, n, t, c;
+	};
+
+	// One draw of a batch.  A plain draw is a batch of one.
+	struct SubDraw {
+		GLsizei count;
+		GLint first;			// array draws
+		const GLvoid *indices;	// element draws, already resolved to memory
+		GLint baseVertex;
+		GLuint start, end;		// glDrawRangeElements bounds
+	};
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::LockCache -- the elements of a glLockArraysEXT range, fetched
+	// and transformed once and then shared by every draw that uses the
+	// same transforms, until the arrays are unlocked or respecified.
+	//////////////////////////////////////////////////////////////////////
+
+	class LockCache : public Interface {
+		public:
+			LockCache(GLint _first, GLsizei _count);
+
+			bool covers(GLint i) const { return i >= first && i < first + count; }
+			bool matches(const ElementSet &set, GLuint buffer, unsigned int generation) const;
+
+			GLint first;
+			GLsizei count;
+
+			// the key the cached elements were built for
+			bool built;
+			Transform transform;
+			Transform texCoordTransform;
+			GLuint buffer;
+			unsigned int generation;
+
+			// indexed by array index - first; 0 where nothing could be fetched
+			ElementVec elements;
+
+			int nBuilt, nHits;
+	};
+
+	typedef Ptr<LockCache> LockCachePtr;
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::DisplayList -- the geometry compiled into a display list, kept
+	// untransformed in flat arrays.  Each glCallList turns it into sets
+	// under the modelview current at the call.
+	//////////////////////////////////////////////////////////////////////
+
+	class DisplayList : public Interface {
+		public:
+			struct Prim {
+				GLenum mode;
+				GLuint first;
+				GLuint count;
+			};
+
+			enum { HAS_NORMAL = 1, HAS_TEXCOORD = 2, HAS_COLOR = 4 };
+
+			DisplayList(GLenum _mode) : mode(_mode) {}
+
+			void addSet(const ElementSet &set);
+			void addPrims(const DisplayList &src, size_t firstPrim, size_t nPrims);
+			void addCall(GLuint list) { calls.push_back(list); }
+			void compact();
+
+			size_t bytes() const;
+
+			// GL_COMPILE or GL_COMPILE_AND_EXECUTE
+			GLenum mode;
+
+			std::vector<Prim> prims;
+
+			// four floats per element for each of these, with the
+			// normal, texcoord and colour only meaningful where flags
+			// say so
+			std::vector<GLfloat> v, n, t, c;
+			std::vector<GLubyte> flags;
+
+			// lists called while this one was being compiled
+			std::vector<GLuint> calls;
+	};
+
+	typedef Ptr<DisplayList> DisplayListPtr;
+
+
+	class CArray : public Interface {
+
+	  public:
+		GLboolean	enabled;
+		GLint		size;
+		GLenum		type;
+		GLsizei		stride;
+		const GLbyte*	data;
+		GLboolean	normalized;
+
+		// generic attributes only: the array buffer bound when the
+		// pointer was set, and the glVertexAttribDivisor
+		GLuint		buffer;
+		GLuint		divisor;
+
+		inline CArray();
+	};
+
+	typedef Ptr<CArray> CArrayPtr;
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::VertexArray -- the state of one vertex array object: its
+	// generic attribute arrays and element array buffer, plus the fetch
+	// plan for the attributes mapped to position, normal, texcoord and
+	// colour.
+	//////////////////////////////////////////////////////////////////////
+
+	class VertexArray : public Interface {
+		public:
+			VertexArray() : attribs(16), elementBuffer(0), planValid(0), planEpoch(0) {}
+
+			std::vector<CArrayPtr> attribs;
+			GLuint elementBuffer;
+
+			// the formats are worked out when the state changes; each
+			// draw only fills in where sources[i] + offsets[i] now is
+			bool planValid;
+			unsigned int planEpoch;
+			FetchPlan plan;
+			BufferPtr sources[4];
+			const GLbyte *offsets[4];
+	};
+
+	typedef Ptr<VertexArray> VertexArrayPtr;
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::Program -- the matrix uniforms the config names in one GLSL
+	// program: where they are and what the application last set them
+	// to, so shader draws get their transform without a readback.
+	//////////////////////////////////////////////////////////////////////
+
+	class Program : public Interface {
+		public:
+			enum { MODEL, VIEW, MODELVIEW, N_MATRICES };
+
+			Program() { reset(); }
+
+			// linking throws away locations and values alike
+			inline void reset();
+
+			GLint locations[N_MATRICES];
+			bool set[N_MATRICES];
+			GLfloat matrices[N_MATRICES][16];
+
+			// the bone palette of skinned draws, a mat4 array
+			GLint paletteLocation;
+			std::vector<GLfloat> palette;
+	};
+
+	typedef Ptr<Program> ProgramPtr;
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::ShareGroup -- the objects contexts linked by wglShareLists
+	// have in common: buffers, display lists and programs.  Each context
+	// starts in a group of its own; the bindings, client arrays and
+	// vertex array objects always stay with the context.
+	//
+	// The contexts of a group may be current on different threads, so
+	// calls on them are handled with the group's lock held.
+	//////////////////////////////////////////////////////////////////////
+
+	class ShareGroup : public Interface {
+		public:
+			ShareGroup() : buffers(new BufferStore()) { InitializeCriticalSection(&lock); }
+			~ShareGroup() { DeleteCriticalSection(&lock); }
+
+			class Lock {
+				public:
+					Lock(ShareGroup *_group) : group(_group) { EnterCriticalSection(&group->lock); }
+					~Lock() { LeaveCriticalSection(&group->lock); }
+
+				private:
+					Ptr<ShareGroup> group;
+			};
+
+			CRITICAL_SECTION lock;
+
+			BufferStorePtr buffers;
+			std::unordered_map<GLuint, DisplayListPtr> displayLists;
+			std::unordered_map<GLuint, ProgramPtr> programs;
+	};
+
+	typedef Ptr<ShareGroup> ShareGroupPtr;
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::SkinJob -- linear blend skinning of the vertices first to
+	// last, from bind pose into the pose of the bone palette.  out gets
+	// eight floats per vertex, the position and then the normal.
+	//////////////////////////////////////////////////////////////////////
+
+	class SkinJob : public WorkerPool::Job {
+		public:
+			void run();
+
+			const FetchPlan::Stream *v, *n;
+			FetchPlan::Stream bones, weights;
+			const GLfloat *palette;
+			int nBones;
+			GLint first, last;
+			GLfloat *out;
+			bool ok;
+	};
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::FlightRecorder -- the draws of the last few frames, kept in
+	// memory so a frame can be written out after it has been seen.
+	//
+	// Each frame has a fixed size arena: the geometry of its draws,
+	// untransformed, in the flat arrays of a DisplayList, and the
+	// matrices each run of draws was made under.  Called display lists
+	// and instanced meshes are copied in like any other draw.  The
+	// transforms are only applied if the frame is written.  A draw that
+	// does not fit in what is left of the arena is dropped and counted.
+	//////////////////////////////////////////////////////////////////////
+
+	class FlightRecorder : public Interface {
+		public:
+			struct Draw {
+				// prims of the frame's geometry
+				size_t firstPrim, nPrims;
+				GLfloat M[16], TM[16];
+			};
+
+			class Frame {
+				public:
+					Frame() : number(0), nDropped(0), ticks(0) {}
+
+					size_t bytes() const { return geometry->bytes() + draws.size() * sizeof(Draw); }
+
+					unsigned int number;
+					DisplayListPtr geometry;
+					std::vector<Draw> draws;
+					int nDropped;
+
+					// time spent capturing the frame
+					volatile LONGLONG ticks;
+			};
+
+			FlightRecorder(int nFrames, size_t _arenaBytes);
+			~FlightRecorder();
+
+			void beginFrame(unsigned int number);
+			void addSet(const ElementSet &set, const GLfloat *M, const GLfloat *TM);
+			void addList(const DisplayList &list, size_t firstPrim, size_t nPrims,
+					const GLfloat *M, const GLfloat *TM);
+			void addTicks(LONGLONG t) { InterlockedExchangeAdd64(&frames[curr].ticks, t); }
+
+			// the frames held, oldest first; the last is the one being
+			// captured
+			int size() const { return nHeld; }
+			const Frame &frame(int i) const { return frames[(curr + 1 - nHeld + i + frames.size()) % frames.size()]; }
+
+			// held while a draw is added, and by whoever writes the frames
+			CRITICAL_SECTION lock;
+
+		private:
+			void addDraw(Frame &f, size_t prim, size_t nPrims, const GLfloat *M, const GLfloat *TM);
+
+			std::vector<Frame> frames;
+			int curr, nHeld;
+			size_t arenaBytes;
+	};
+
+	typedef Ptr<FlightRecorder> FlightRecorderPtr;
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::Governor -- keeps the time capture adds to a frame within a
+	// budget.
+	//
+	// The time the plugin spends in a recorded frame is added up, and at
+	// the end of the frame compared with the budget.  Over it, capture
+	// goes up a level and sheds more work; under half of it for a few
+	// frames running, it comes back down one.  Each level keeps what the
+	// one before it sheds.  A frame that is not recorded puts it back to
+	// the start, so each recording starts from everything.
+	//////////////////////////////////////////////////////////////////////
+
+	class Governor : public Interface {
+		public:
+			enum Level {
+				FULL,			// everything the config asks for
+				NO_ATTRIBS,		// no normals or texcoords
+				DEFERRED,		// transforms left to the writer thread
+				SAMPLED,		// one draw in 2 kept, then 4, 8 and 16
+				MAX_LEVEL = SAMPLED + 3
+			};
+
+			Governor(float budgetMs);
+
+			int level() const { return currLevel; }
+			bool shedAttribs() const { return currLevel >= NO_ATTRIBS; }
+			bool deferTransforms() const { return currLevel >= DEFERRED; }
+
+			// whether the next draw is to be captured
+			bool sampleDraw();
+
+			void addTicks(LONGLONG t) { InterlockedExchangeAdd64(&ticks, t); }
+
+			// weigh the frame's time, if it was recorded, and start the next
+			void endFrame(unsigned int number, bool recorded);
+
+		private:
+			LONGLONG budget;
+			double ticksPerMs;
+			volatile LONG currLevel;
+			volatile LONGLONG ticks;
+			volatile LONG nDraws, nSkipped;
+			int nUnder;
+	};
+
+	typedef Ptr<Governor> GovernorPtr;
+
+
+	struct ltstr
+	{
+	  bool operator()(const char* s1, const char* s2) const
+	  { return strcmp(s1, s2) < 0; }
+	};
+
+
+	//////////////////////////////////////////////////////////////////////
+	// OGLE::Config -- Class for all OGLE config options
+	//////////////////////////////////////////////////////////////////////	
+
+	struct Config {
+		public: 
+			float scale;
+			bool logFunctions;
+			bool logFunctionsBinary;
+			bool captureNormals;
+			bool captureTexCoords;
+			bool captureColors;
+			bool flipPolyStrips;
+			int encoderThreads;
+			int encoderBatchSize;
+			int compression;
+			int compressionLevel;
+			int compressionThreads;
+			int compressionBlockSize;
+			size_t bufferBudget;
+			size_t bufferPoolSize;
+			int instanceTransformAttrib;
+			int positionAttrib;
+			int normalAttrib;
+			int texCoordAttrib;
+			int colorAttrib;
+			string matrixUniforms[Program::N_MATRICES];
+			int matrixBlockBinding;
+			int matrixBlockOffsets[Program::N_MATRICES];
+			int boneIndexAttrib;
+			int boneWeightAttrib;
+			string bonePaletteUniform;
+			int skinningThreads;
+			bool feedbackCapture;
+			size_t feedbackBufferSize;
+			int flightFrames;
+			size_t flightArenaSize;
+			float captureBudget;
+			bool latencyHistograms;
+			int coalesceDrawElements;
+			int coalesceSetElements;
+			bool skipDuplicateDraws;
+			map<const char*, bool, ltstr>polyTypesEnabled;			
+
+			static char *polyTypes[];
+			static int nPolyTypes;
+
+			inline Config();
+	};
+
+
+	////////////////////////////////////////////////////////////////////////
+	// OGLE -- the class for actually doing the OpenGLExtraction
+	////////////////////////////////////////////////////////////////////////
+
+
+	OGLE(InterceptPluginCallbacks *_callBacks, const GLCoreDriver *_GLV);
+
+		
+	void startRecording(string _objFileName);
+	void startRecording(Ptr<ObjFile> file);
+	void stopRecording();
+	void shareLists(OGLE *src);
+	bool isRecording() { return objFile || flight; }
+
+	void addSet(ElementSetPtr set);
+	void newSet(GLenum mode);
+
+	// send on the small draws held back to go out together
+	void flushCoalesced();
+
+	void glBegin (GLenum mode);
+	void glEnd ();
+
+	void glVertexfv(GLfloat *V, GLsizei n);
+	void glNormalfv(GLfloat *V, GLsizei n);
+	void glTexCoordfv(GLfloat *V, GLsizei n);
+	void glColorfv(GLfloat *V, GLsizei n);
+
+	void glArrayElement (GLint i);
+	void glDrawElements (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices);
+	void glDrawArrays (GLenum mode, GLint first, GLsizei count);
+	void glEnableClientState (GLenum array);
+	void glDisableClientState (GLenum array);
+	void glVertexPointer (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
+	void glNormalPointer (GLenum type, GLsizei stride, const GLvoid *pointer);
+	void glColorPointer (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
+
+	void glInterleavedArrays(GLenum format, GLsizei stride, const GLvoid *pointer);
+
+
+	void glClientActiveTexture(GLenum texture);
+	void glTexCoordPointer (GLint	size, GLenum type, GLsizei stride, const GLvoid *pointer);
+	
+
+	void glDrawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const GLvoid *indices);
+	void glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLint basevertex);
+	void glDrawRangeElementsBaseVertex(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const GLvoid *indices, GLint basevertex);
+	void glMultiDrawArrays(GLenum mode, const GLint *first, const GLsizei *count, GLsizei drawcount);
+	void glMultiDrawElements(GLenum mode, const GLsizei *count, GLenum type, const GLvoid *const *indices, GLsizei drawcount);
+	void glMultiDrawElementsBaseVertex(GLenum mode, const GLsizei *count, GLenum type, const GLvoid *const *indices, GLsizei drawcount, const GLint *basevertex);
+	void glDrawArraysIndirect(GLenum mode, const GLvoid *indirect);
+	void glDrawElementsIndirect(GLenum mode, GLenum type, const GLvoid *indirect);
+	void glMultiDrawArraysIndirect(GLenum mode, const GLvoid *indirect, GLsizei drawcount, GLsizei stride);
+	void glMultiDrawElementsIndirect(GLenum mode, GLenum type, const GLvoid *indirect, GLsizei drawcount, GLsizei stride);
+	void drawBatch(GLenum mode, GLenum type, const SubDraw *draws, GLsizei n);
+	void fetchDraw(const FetchPlan &plan, GLenum type, const SubDraw &d, bool raw);
+
+	void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer);
+	void glEnableVertexAttribArray(GLuint index);
+	void glDisableVertexAttribArray(GLuint index);
+	void glVertexAttribDivisor(GLuint index, GLuint divisor);
+	CArray *getAttrib(GLuint index);
+	void glBindVertexArray(GLuint array);
+	void glDeleteVertexArrays(GLsizei n, const GLuint *arrays);
+
+	void glDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount);
+	void glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei instancecount);
+	bool hasInstanceTransform();
+	bool skinDraws(FetchPlan &plan, GLenum type, const SubDraw *draws, GLsizei n);
+	bool convertColors(FetchPlan &plan, GLenum type, const SubDraw *draws, GLsizei n);
+	void drawInstanced(GLenum mode, GLenum type, const SubDraw &d, GLsizei instances, GLuint baseInstance);
+	void glLockArraysEXT(GLint first, GLsizei count);
+	void glUnlockArraysEXT();
+	void glBindBuffer(GLenum target, GLuint buffer);
+	void glBufferData(GLenum target, GLsizei size, const GLvoid *data, GLenum usage);
+	void glBufferSubData(GLenum target, GLint offset, GLsizei size, const GLvoid *data);
+	void glMapBuffer(GLenum target, GLenum access);
+	void glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+	void glMapBufferPost(GLvoid *retValue);
+	void glFlushMappedBufferRange(GLenum target, GLintptr offset, GLsizeiptr length);
+	void glUnmapBuffer(GLenum target);
+	void glBufferStorage(GLenum target, GLsizeiptr size, const GLvoid *data, GLbitfield flags);
+	void glCopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size);
+	void glCopyNamedBufferSubData(GLuint readBuffer, GLuint writeBuffer, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size);
+	void glClearBufferData(GLenum target, GLenum internalformat, GLenum format, GLenum type, const GLvoid *data);
+	void glClearBufferSubData(GLenum target, GLenum internalformat, GLintptr offset, GLsizeiptr size, GLenum format, GLenum type, const GLvoid *data);
+	void glTexBuffer(GLenum target, GLenum internalformat, GLuint buffer);
+	void gpuWrites(GLuint buffer);
+	void syncMappedBuffer(GLenum target, Buffer *buff);
+	void glDeleteBuffers(GLsizei n, const GLuint *names);
+
+	void glNewList(GLuint list, GLenum mode);
+	void glEndList();
+	void glCallList(GLuint list);
+	void glCallLists(GLsizei n, GLenum type, const GLvoid *lists);
+	void glListBase(GLuint base);
+	void glDeleteLists(GLuint list, GLsizei range);
+	bool isCompilingList() { return compilingList; }
+	void emitList(GLuint list, const GLfloat *M, const GLfloat *TM, int depth = 0);
+	void emitGeometry(const DisplayList &dl, const GLfloat *M, const GLfloat *TM,
+		size_t firstPrim = 0, size_t nPrims = (size_t)-1);
+	void writeFlightFrame(const FlightRecorder::Frame &frame, string fileName);
+
+	void glUseProgram(GLuint program);
+	void glLinkProgram(GLuint program);
+	void glDeleteProgram(GLuint program);
+	void glGetUniformLocation(GLuint program, const char *name);
+	void glGetUniformLocationPost(GLint location);
+	void glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
+	void glProgramUniformMatrix4fv(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
+	void glBindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	void glBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	Program *getProgram(GLuint program);
+	bool getShaderModelView(GLfloat *M);
+
+	void beginFeedback();
+	bool endFeedback();
+
+	void initFunctions();
+	bool functionsInitialized() { return functionsInit; }
+	bool canReadBack() { return extensionVBOSupported && iglGetBufferSubData; }
+	Transform getCurrTransform(GLenum type = GL_MODELVIEW_MATRIX);
+	void getCurrMatrix(GLenum type, GLfloat *mat);
+	void addCurrElement(ElementPtr E);
+
+	void resolveFetchPlan(FetchPlan &plan);
+	void resolveAttribPlan(FetchPlan &plan);
+	bool resolveStream(FetchPlan::Stream &s, const CArray *arr, GLuint buffIndex);
+	static bool streamFormat(FetchPlan::Stream &s, const CArray *arr);
+	static bool bindStream(FetchPlan::Stream &s, const GLbyte *pointer, Buffer *buff);
+
+	GLuint getBufferIndex(GLenum target);
+	const GLbyte *OGLE::getBufferedArray(const GLbyte *array);
+	const GLvoid *getBufferedIndices(const GLvoid *indices, GLsizei count, GLenum type);
+	const GLbyte *getIndirect(const GLvoid *indirect, GLsizeiptr size);
+	void checkBuffers();
+	Buffer *currentBuffer(GLenum target);
+	Buffer *currentBuffer(GLenum target, GLuint name);
+	void readBack(GLenum target, Buffer *buff);
+
+	bool isElementLocked(int index);
+	ElementPtr fetchElement(GLint i);
+	ElementPtr fetchElement(const FetchPlan &plan, GLint i);
+	void buildLockCache();
+	void invalidateLockCache();
+
+
+
+	InterceptPluginCallbacks *callBacks;
+    const GLCoreDriver       *GLV;                  //The core OpenGL driver
+	std::map<const char*, BlobPtr, ltstr> glState;
+
+	CArray vArray;
+	CArray nArray;
+	CArray cArray;
+	CArrayPtr tArray;
+	CArrayPtr tArrayActive;
+	
+	std::vector<CArrayPtr> tArrays;
+
+	// vertex array objects; 0 is the default one
+	std::unordered_map<GLuint, VertexArrayPtr> vertexArrays;
+	VertexArrayPtr vao;
+	GLint activeClientTex;
+
+	ShareGroupPtr shared;
+
+	bool functionsInit;
+	bool extensionVBOSupported;
+	void    (GLAPIENTRY *iglGetBufferSubData) (GLenum, GLint, GLsizei, GLvoid *);
+	void    (GLAPIENTRY *iglBindBuffer) (GLenum, GLuint);
+
+	DisplayListPtr compilingList;
+	GLuint compilingListName;
+	GLuint listBase;
+
+	LockCachePtr lockCache;
+	bool lockCacheChecked;
+
+	// shadowed uniform state of the current GLSL program; 0 is fixed function
+	ProgramPtr currProgram;
+	GLuint pendingUniformProgram;
+	int pendingUniform;
+	GLuint matrixBlockBuffer;
+	GLintptr matrixBlockOffset;
+
+	// the frame's geometry in feedback capture mode
+	std::vector<GLfloat> feedback;
+
+	// in flight recorder mode, where the draws go instead of a file, and
+	// the matrices of the current set
+	FlightRecorderPtr flight;
+	GLfloat flightM[16], flightTM[16];
+
+	// small draws with the same mode and matrices, held back to go out
+	// as one set, and the matrices of the held set and of the last one
+	// made that may join it
+	ElementSetPtr coalesced;
+	GLfloat coalescedM[16], coalescedTM[16];
+	GLfloat setM[16], setTM[16];
+	bool canCoalesce(GLenum mode);
+	bool matchesCoalesced(GLenum mode, bool deferred);
+
+	// what the buffer draws captured this frame were drawn from, to
+	// know a later pass drawing the same again; and how many were
+	bool batchSignature(std::string &sig, GLenum mode, GLenum type, const FetchPlan &plan, const GLbyte *&indexBase);
+	std::unordered_set<std::string> drawSignatures;
+	int nDuplicates;
+	void endDuplicateFrame();
+
+	// instanced draws captured as one instance this frame, for want of
+	// an instance transform, and how many instances they had
+	int nCollapsedDraws, nCollapsedInstances;
+	void collapsedInstances(GLsizei instances);
+	void endInstanceFrame();
+
+	// what the capture budget, if there is one, lets through
+	GovernorPtr governor;
+	bool keepAttribs() { return !governor || compilingList || !governor->shedAttribs(); }
+	bool sampleDraw() { return !governor || compilingList || governor->sampleDraw(); }
+
+	// posed copies of the vertices of the last skinned draw
+	std::vector<GLfloat> skinned;
+
+	// unsigned byte colours of the last draw, as floats
+	std::vector<GLfloat> colors;
+	WorkerPoolPtr skinPool;
+
+    Ptr<ElementSet> currSet;
+    VertexPtr currTexCoord, currNormal, currColor;
+	std::vector<ElementSetPtr> sets;
+
+
+	string objFileName;
+
+	Ptr<ObjFile> objFile;
+
+	// how many times the plugin's recording file had changed when this
+	// context last caught up with it
+	LONG fileSerial;
+
+
+	//////////////////////////////////////////////////////////////////////////////
+	// Static methods and variables for the OGLE class
+
+	static void init();
+
+	static GLint derefIndexArray(GLenum type, const GLvoid *indices, int i);
+	static bool drawRange(GLenum type, const SubDraw *draws, GLsizei n, GLint &lo, GLint &hi);
+	static GLsizei indexTypeSize(GLenum type);
+
+	static VertexPtr doTransform(VertexPtr vp, Transform T);
+	static bool isIdentityTransform(Transform T);
+	static Transform toTransform(const GLfloat *mat);
+	static void transformPoint(const GLfloat *M, const GLfloat *in, GLfloat *out);
+	static void transformPoints(const GLfloat *M, const GLfloat *in, GLfloat *out, size_t n);
+	static void multMatrix(const GLfloat *A, const GLfloat *B, GLfloat *out);
+	static bool invertMatrix(const GLfloat *m, GLfloat *out);
+	static void copyMatrices(GLfloat *out, const GLfloat *value, GLsizei count, bool transpose);
+	static GLsizei glTypeSize(GLenum type);
+
+	static FILE *LOG;
+	static Config config;
+};
+
+typedef Ptr<OGLE> OGLEPtr;
+
+
+
+
+
+
+bool OGLE::FetchPlan::Stream::read(GLint i, GLfloat *v) const {
+	const GLbyte *p = data + (size_t)i * stride;
+
+	if(i < 0 || (end && p + bytes > end)) {
+		return false;
+	}
+
+	for(int j = 0; j < size; j++) {
+		switch(type) {
+			case GL_BYTE: v[j] = ((const GLbyte *)p)[j]; break;
+			case GL_UNSIGNED_BYTE: v[j] = ((const GLubyte *)p)[j]; break;
+			case GL_SHORT: v[j] = ((const GLshort *)p)[j]; break;
+			case GL_UNSIGNED_SHORT: v[j] = ((const GLushort *)p)[j]; break;
+			case GL_INT: v[j] = (GLfloat)((const GLint *)p)[j]; break;
+			case GL_UNSIGNED_INT: v[j] = (GLfloat)((const GLuint *)p)[j]; break;
+			case GL_FLOAT: v[j] = ((const GLfloat *)p)[j]; break;
+			case GL_DOUBLE: v[j] = (GLfloat)((const GLdouble *)p)[j]; break;
+		}
+	}
+
+	if(normalized && type != GL_FLOAT && type != GL_DOUBLE) {
+		GLfloat scale;
+		switch(type) {
+			case GL_BYTE: scale = 127.0f; break;
+			case GL_UNSIGNED_BYTE: scale = 255.0f; break;
+			case GL_SHORT: scale = 32767.0f; break;
+			case GL_UNSIGNED_SHORT: scale = 65535.0f; break;
+			case GL_INT: scale = 2147483647.0f; break;
+			default: scale = 4294967295.0f; break;
+		}
+		for(int j = 0; j < size; j++) {
+			v[j] /= scale;
+			if(v[j] < -1.0f) v[j] = -1.0f;
+		}
+	}
+	return true;
+}
+
+
+OGLE::CArray::CArray() {
+	enabled = false;
+	size = 4;
+	type = GL_FLOAT;
+	stride = 0;
+	data = NULL;
+	normalized = false;
+	buffer = 0;
+	divisor = 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// OGLE::Vertex Short/obvious Methods
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+
+
+
+OGLE::Vertex::Vertex() {
+	init();
+}
+
+OGLE::Vertex::Vertex(GLfloat _x, GLfloat _y, GLfloat _z, GLfloat _w) {
+	init(x,y,z,w);
+}
+
+
+void OGLE::Vertex::init(GLfloat _x, GLfloat _y, GLfloat _z, GLfloat _w) {
+			x = _x; y = _y; z = _z; w = _w;
+			size = 4;
+}
+
+OGLE::Vertex::Vertex(Vector v) {
+	init();
+	this->fromVector(v);
+}
+
+OGLE::Vertex::Vertex(const GLfloat *v, GLint n) {
+	  init();
+	  Vector V(n);
+	  for(int i = 0; i < n; i++) {
+		  V[i] = (float)v[i];
+	  }
+	  this->fromVector(V);
+	  size = n;
+}
+
+void OGLE::Vertex::fromVector(Vector v) {
+	switch (v.size()) {
+	case 4: w = v[3];
+	case 3: z = v[2];
+	case 2: y = v[1];
+	case 1: x = v[0];				
+	}
+	size = v.size();
+}
+
+
+OGLE::Vector OGLE::Vertex::toVector() {
+	Vector v(4);
+	v[0] = x; v[1] = y; v[2] = z; v[3] = w;
+	return v;
+}
+
+OGLE::Buffer::Buffer(const GLvoid *_ptr, GLsizei _size, GLuint _name, GLenum _usage, bool shadow) {
+	name = _name;
+	ptr = 0;
+	capacity = 0;
+
+	map = 0;
+	mapAccess = 0;
+	mapOffset = 0;
+	mapLength = 0;
+	mapCurrent = 0;
+	inLru = 0;
+	gpuWritable = 0;
+
+	generation = 0;
+	fetchedGeneration = (GLuint)-1;
+
+	respecify(_ptr, _size, _usage, shadow);
+}
+
+OGLE::Buffer::~Buffer() {
+	deallocate();
+}
+
+// glBufferData on an existing buffer.  The shadow memory is kept when
+// it is big enough, so orphaning a streaming buffer every frame with
+// glBufferData(target, size, NULL, usage) costs nothing but a reset.
+void OGLE::Buffer::respecify(const GLvoid *_ptr, GLsizei _size, GLenum _usage, bool shadow) {
+	size = _size;
+	usage = _usage;
+	fetchedGeneration = generation - 1;
+
+	if(!shadow || size > capacity) {
+		deallocate();
+	}
+
+	if(shadow && allocate() && _ptr) {
+		memcpy(ptr, _ptr, size);
+		fetchedGeneration = generation;
+	}
+}
+
+bool OGLE::Buffer::allocate() {
+	if(!ptr) {
+		ptr = BufferPool::alloc(size, capacity);
+	}
+	return ptr != 0;
+}
+
+void OGLE::Buffer::deallocate() {
+	BufferPool::release(ptr, capacity);
+	ptr = 0;
+	capacity = 0;
+}
+
+// A shadow is clean when dropping it loses nothing: GL still has the
+// contents and nothing is mapped that would have to be copied back.
+bool OGLE::Buffer::isClean(bool canReadBack) const {
+	return canReadBack && !map;
+}
+
+// Whether the shadow still matches GL.  The *_COPY and *_READ usages
+// mean the GPU writes the buffer (transform feedback and the like),
+// which we never see, so those are always fetched again, as are
+// buffers that have been bound where the GPU can write them.
+bool OGLE::Buffer::isCurrent() const {
+	if(!ptr || fetchedGeneration != generation || gpuWritable) return false;
+
+	switch(usage) {
+		case 0x88E2: // GL_STREAM_READ
+		case 0x88E3: // GL_STREAM_COPY
+		case 0x88E5: // GL_STATIC_READ
+		case 0x88E6: // GL_STATIC_COPY
+		case 0x88E9: // GL_DYNAMIC_READ
+		case 0x88EA: // GL_DYNAMIC_COPY
+			return false;
+	}
+	return true;
+}
+
+
+
+OGLE::Config::Config() : scale(1), logFunctions(0), logFunctionsBinary(0),
+						 captureNormals(0), captureTexCoords(0), captureColors(0),
+						 flipPolyStrips(1),
+						 encoderThreads(0), encoderBatchSize(1 << 16),
+						 compression(0), compressionLevel(-1),
+						 compressionThreads(-1), compressionBlockSize(1 << 20),
+						 bufferBudget(512 << 20), bufferPoolSize(64 << 20),
+						 instanceTransformAttrib(-1),
+						 positionAttrib(0), normalAttrib(-1), texCoordAttrib(-1), colorAttrib(-1),
+						 matrixBlockBinding(-1),
+						 boneIndexAttrib(-1), boneWeightAttrib(-1),
+						 skinningThreads(-1),
+						 feedbackCapture(0), feedbackBufferSize(16 << 20),
+						 flightFrames(0), flightArenaSize(16 << 20),
+						 captureBudget(0), latencyHistograms(0),
+						 coalesceDrawElements(0), coalesceSetElements(4096),
+						 skipDuplicateDraws(0) {
+	for(int k = 0; k < Program::N_MATRICES; k++) {
+		matrixBlockOffsets[k] = -1;
+	}
+
+	for(int i = 0; i < OGLE::Config::nPolyTypes; i++) {
+		const char *type = OGLE::Config::polyTypes[i];
+		polyTypesEnabled[type] = 1;
+	}						
+}
+
+void OGLE::Program::reset() {
+	for(int k = 0; k < N_MATRICES; k++) {
+		// a number names a layout(location = n) uniform directly
+		const string &name = OGLE::config.matrixUniforms[k];
+		locations[k] = (!name.empty() && isdigit((unsigned char)name[0])) ? atoi(name.c_str()) : -1;
+		set[k] = 0;
+	}
+
+	const string &name = OGLE::config.bonePaletteUniform;
+	paletteLocation = (!name.empty() && isdigit((unsigned char)name[0])) ? atoi(name.c_str()) : -1;
+	palette.clear();
+}
+
+
+#endif // __OGLE_H_
+
@@ -0,0 +1,243 @@
+//////////////////////////////////////////////////////////////////////
+// CallLogDump -- turns the binary function call log that OGLE writes
+// with LogFunctionsBinary (ogle.calls) into text, one call per line,
+// in the order the calls were made.
+//
+//   CallLogDump ogle.calls [out.txt]
+//
+// It needs nothing from GLIntercept or Windows; build it on its own,
+// e.g. "cl /EHsc CallLogDump.cpp" from this folder.
+//////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "../CallLogFormat.h"
+
+using namespace std;
+
+
+struct Function {
+	string name;
+	string args;
+	char ret;
+};
+
+struct Record {
+	const CallLogRecord *header;
+	const unsigned char *payload;
+	size_t order;
+};
+
+static bool earlier(const Record &a, const Record &b) {
+	if(a.header->time != b.header->time) return a.header->time < b.header->time;
+	return a.order < b.order;
+}
+
+
+// The enums worth naming; anything else is printed in hex.
+
+static const struct {
+	unsigned int value;
+	const char *name;
+} enumNames[] = {
+	{ 0x0000, "GL_POINTS" },
+	{ 0x0001, "GL_LINES" },
+	{ 0x0002, "GL_LINE_LOOP" },
+	{ 0x0003, "GL_LINE_STRIP" },
+	{ 0x0004, "GL_TRIANGLES" },
+	{ 0x0005, "GL_TRIANGLE_STRIP" },
+	{ 0x0006, "GL_TRIANGLE_FAN" },
+	{ 0x0007, "GL_QUADS" },
+	{ 0x0008, "GL_QUAD_STRIP" },
+	{ 0x0009, "GL_POLYGON" },
+	{ 0x1300, "GL_COMPILE" },
+	{ 0x1301, "GL_COMPILE_AND_EXECUTE" },
+	{ 0x1400, "GL_BYTE" },
+	{ 0x1401, "GL_UNSIGNED_BYTE" },
+	{ 0x1402, "GL_SHORT" },
+	{ 0x1403, "GL_UNSIGNED_SHORT" },
+	{ 0x1404, "GL_INT" },
+	{ 0x1405, "GL_UNSIGNED_INT" },
+	{ 0x1406, "GL_FLOAT" },
+	{ 0x140A, "GL_DOUBLE" },
+	{ 0x8074, "GL_VERTEX_ARRAY" },
+	{ 0x8075, "GL_NORMAL_ARRAY" },
+	{ 0x8076, "GL_COLOR_ARRAY" },
+	{ 0x8078, "GL_TEXTURE_COORD_ARRAY" },
+	{ 0x8892, "GL_ARRAY_BUFFER" },
+	{ 0x8893, "GL_ELEMENT_ARRAY_BUFFER" },
+	{ 0x88B8, "GL_READ_ONLY" },
+	{ 0x88B9, "GL_WRITE_ONLY" },
+	{ 0x88BA, "GL_READ_WRITE" },
+	{ 0x88E0, "GL_STREAM_DRAW" },
+	{ 0x88E4, "GL_STATIC_DRAW" },
+	{ 0x88E8, "GL_DYNAMIC_DRAW" },
+	{ 0x8A11, "GL_UNIFORM_BUFFER" },
+	{ 0x8F3F, "GL_DRAW_INDIRECT_BUFFER" },
+};
+
+static void printEnum(string &out, unsigned int v) {
+	char buff[32];
+
+	for(int i = 0; i < sizeof(enumNames) / sizeof(enumNames[0]); i++) {
+		if(enumNames[i].value == v) {
+			out.append(enumNames[i].name);
+			return;
+		}
+	}
+	sprintf(buff, "0x%04x", v);
+	out.append(buff);
+}
+
+// Append the value of the given code at p to out, and return its size,
+// or 0 if it runs past end.
+
+static size_t printValue(string &out, char code, const unsigned char *p, const unsigned char *end) {
+	char buff[64];
+	size_t size = 0;
+
+	switch(code) {
+		case 'e': case 'u': case 'i': case 'f': size = 4; break;
+		case 'd': case 'p': case 'z': size = 8; break;
+		case 'b': case 'B': size = 1; break;
+		default: return 0;
+	}
+	if(p + size > end) return 0;
+
+	switch(code) {
+		case 'e': { unsigned int v; memcpy(&v, p, 4); printEnum(out, v); return size; }
+		case 'u': { unsigned int v; memcpy(&v, p, 4); sprintf(buff, "%u", v); break; }
+		case 'i': { int v; memcpy(&v, p, 4); sprintf(buff, "%d", v); break; }
+		case 'f': { float v; memcpy(&v, p, 4); sprintf(buff, "%g", v); break; }
+		case 'd': { double v; memcpy(&v, p, 8); sprintf(buff, "%g", v); break; }
+		case 'b': sprintf(buff, "%s", *p ? "true" : "false"); break;
+		case 'B': sprintf(buff, "%u", *p); break;
+		case 'p': { unsigned long long v; memcpy(&v, p, 8); sprintf(buff, "0x%08llx", v); break; }
+		case 'z': { long long v; memcpy(&v, p, 8); sprintf(buff, "%lld", v); break; }
+	}
+	out.append(buff);
+	return size;
+}
+
+
+int main(int argc, char **argv) {
+	if(argc < 2) {
+		fprintf(stderr, "usage: CallLogDump ogle.calls [out.txt]\n");
+		return 1;
+	}
+
+	FILE *in = fopen(argv[1], "rb");
+	if(!in) {
+		fprintf(stderr, "CallLogDump: unable to open %s\n", argv[1]);
+		return 1;
+	}
+
+	vector<unsigned char> data;
+	unsigned char chunk[1 << 16];
+	size_t n;
+	while((n = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+		data.insert(data.end(), chunk, chunk + n);
+	}
+	fclose(in);
+
+	CallLogHeader header;
+	if(data.size() < sizeof(header)) {
+		fprintf(stderr, "CallLogDump: %s is too short\n", argv[1]);
+		return 1;
+	}
+	memcpy(&header, &data[0], sizeof(header));
+	if(memcmp(header.magic, CALL_LOG_MAGIC, sizeof(header.magic)) || header.version != CALL_LOG_VERSION) {
+		fprintf(stderr, "CallLogDump: %s is not a version %d call log\n", argv[1], CALL_LOG_VERSION);
+		return 1;
+	}
+
+	FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+	if(!out) {
+		fprintf(stderr, "CallLogDump: unable to open %s\n", argv[2]);
+		return 1;
+	}
+
+	// the names first, since a thread's calls can come before the
+	// record naming them
+	map<unsigned int, Function> functions;
+	vector<Record> records;
+
+	const unsigned char *p = &data[0] + sizeof(header);
+	const unsigned char *end = &data[0] + data.size();
+
+	while(p + sizeof(CallLogRecord) <= end) {
+		const CallLogRecord *r = (const CallLogRecord *)p;
+		if(r->size < sizeof(CallLogRecord) || p + r->size > end) {
+			fprintf(stderr, "CallLogDump: truncated record at byte %u\n", (unsigned int)(p - &data[0]));
+			break;
+		}
+
+		const unsigned char *payload = p + sizeof(CallLogRecord);
+
+		if(r->type == CALL_NAME) {
+			Function &f = functions[r->funcIndex];
+			const char *s = (const char *)payload;
+			f.name = s; s += f.name.size() + 1;
+			f.args = s; s += f.args.size() + 1;
+			f.ret = *s;
+		}
+		else {
+			Record rec = { r, payload, records.size() };
+			records.push_back(rec);
+		}
+		p += r->size;
+	}
+
+	stable_sort(records.begin(), records.end(), earlier);
+
+	double msPerTick = 1000.0 / header.ticksPerSecond;
+	long long start = records.empty() ? 0 : records[0].header->time;
+
+	for(size_t i = 0; i < records.size(); i++) {
+		const CallLogRecord *r = records[i].header;
+		const unsigned char *v = records[i].payload;
+		const unsigned char *vEnd = (const unsigned char *)r + r->size;
+
+		fprintf(out, "%12.3f ms  t%-3u ", (r->time - start) * msPerTick, r->thread);
+
+		if(r->type == CALL_DROPPED) {
+			fprintf(out, "%u records dropped, the thread's ring was full\n", r->funcIndex);
+			continue;
+		}
+
+		map<unsigned int, Function>::const_iterator it = functions.find(r->funcIndex);
+		if(it == functions.end()) {
+			fprintf(out, "function %u, never named\n", r->funcIndex);
+			continue;
+		}
+		const Function &f = it->second;
+
+		string text;
+		if(r->type == CALL_PRE) {
+			text = f.name + "(";
+			for(size_t k = 0; k < f.args.size(); k++) {
+				if(k) text.append(",");
+				size_t size = printValue(text, f.args[k], v, vEnd);
+				if(!size) break;
+				v += size;
+			}
+			text.append(")");
+			fprintf(out, "PRE FUNCTION (%u): %s\n", r->funcIndex, text.c_str());
+		}
+		else if(r->type == CALL_POST) {
+			printValue(text, f.ret, v, vEnd);
+			fprintf(out, "\t%s (%u) returned: %s\n", f.name.c_str(), r->funcIndex, text.c_str());
+		}
+	}
+
+	if(out != stdout) {
+		fclose(out);
+	}
+	return 0;
+}
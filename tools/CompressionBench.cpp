@@ -0,0 +1,157 @@
+//////////////////////////////////////////////////////////////////////
+// CompressionBench -- throughput against ratio of the output codecs,
+// on a real capture.
+//
+//   CompressionBench capture.obj [threads]
+//
+// The capture is read into memory and written through OutStream once
+// for each codec, level and block size below, in the pieces ObjFile
+// writes it in, the way the plugin would have written it with those
+// settings.  For each it prints the MB/s of .obj text taken in, over
+// the wall clock, and the ratio of the text to what reached the disk.
+// threads is CompressionThreads, -1 (the default) for one per core
+// less one.
+//
+// It has to be built with the plugin's sources other than
+// OGLEPlugin.cpp, against the same GLIntercept headers, with
+// OGLE_HAVE_ZLIB and OGLE_HAVE_LZ4 defined and zlib and LZ4 linked, in
+// Release.  The compressed files are written next to the capture and
+// deleted again.  Each stream's own summary, with the MB/s per
+// compressing thread, goes to ogle.log.
+//////////////////////////////////////////////////////////////////////
+
+#include "../StdAfx.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "../ogle.h"
+#include "../OutStream.h"
+
+#include "../Ptr/Ptr.in"
+
+using namespace std;
+
+
+// what ObjFile hands OutStream at a time, near enough: one batch of
+// formatted sets
+static const size_t pieceSize = 64 * 1024;
+
+static long long fileSize(const string &fileName) {
+	FILE *f = fopen(fileName.c_str(), "rb");
+	if(!f) return -1;
+
+	fseek(f, 0, SEEK_END);
+	long long size = ftell(f);
+	fclose(f);
+	return size;
+}
+
+
+// Write data through a stream with the given settings; the time taken
+// includes closing it, which waits for the last blocks.
+
+static void run(const vector<char> &data, const string &capture, OutStream::Codec codec, int level, int blockKb) {
+	OGLE::config.compressionLevel = level;
+	OGLE::config.compressionBlockSize = blockKb * 1024;
+
+	string fileName = capture + ".bench";
+
+	LARGE_INTEGER freq, start, end;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&start);
+
+	OutStreamPtr out = OutStream::open(fileName, codec);
+	if(!out) {
+		printf("  unable to write %s\n", fileName.c_str());
+		return;
+	}
+
+	for(size_t p = 0; p < data.size(); p += pieceSize) {
+		out->write(&data[p], min(pieceSize, data.size() - p));
+	}
+	out->flush();
+	out = 0;
+
+	QueryPerformanceCounter(&end);
+
+	fileName.append(OutStream::codecExtension(codec));
+	long long size = fileSize(fileName);
+	remove(fileName.c_str());
+
+	double secs = (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+	double mb = data.size() / (1024.0 * 1024.0);
+
+	char levelText[16], blockText[16];
+	if(level < 0) sprintf(levelText, "default");
+	else sprintf(levelText, "%d", level);
+	if(codec == OutStream::CODEC_NONE) sprintf(blockText, "-");
+	else sprintf(blockText, "%d KB", blockKb);
+
+	printf("  %-5s %-8s %8s  %9.1f MB/s  %7.2f\n",
+		OutStream::codecName(codec), levelText, blockText,
+		secs > 0 ? mb / secs : 0.0, size > 0 ? (double)data.size() / size : 0.0);
+	fflush(stdout);
+}
+
+
+int main(int argc, char **argv) {
+	if(argc < 2) {
+		printf("usage: CompressionBench capture.obj [threads]\n");
+		return 1;
+	}
+
+	string capture = argv[1];
+	OGLE::config.compressionThreads = argc > 2 ? atoi(argv[2]) : -1;
+
+	FILE *f = fopen(capture.c_str(), "rb");
+	if(!f) {
+		printf("unable to read %s\n", capture.c_str());
+		return 1;
+	}
+
+	vector<char> data;
+	char buf[pieceSize];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+		data.insert(data.end(), buf, buf + n);
+	}
+	fclose(f);
+
+	int nThreads = OGLE::config.compressionThreads;
+	if(nThreads < 0) {
+		nThreads = WorkerPool::defaultThreadCount();
+	}
+
+	printf("%s: %.1f MB, %d compression threads\n", capture.c_str(), data.size() / (1024.0 * 1024.0), nThreads);
+	printf("  codec level       block         wall     ratio\n");
+
+	static const struct {
+		OutStream::Codec codec;
+		int level;
+	} codecs[] = {
+		{ OutStream::CODEC_NONE, -1 },
+		{ OutStream::CODEC_LZ4, 0 },
+		{ OutStream::CODEC_LZ4, 9 },
+		{ OutStream::CODEC_GZIP, 1 },
+		{ OutStream::CODEC_GZIP, 6 },
+		{ OutStream::CODEC_GZIP, 9 },
+	};
+
+	static const int blockKbs[] = { 256, 1024, 4096 };
+
+	for(int i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+		if(codecs[i].codec == OutStream::CODEC_NONE) {
+			run(data, capture, codecs[i].codec, codecs[i].level, 0);
+			continue;
+		}
+		for(int k = 0; k < sizeof(blockKbs) / sizeof(blockKbs[0]); k++) {
+			run(data, capture, codecs[i].codec, codecs[i].level, blockKbs[k]);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,127 @@
+//////////////////////////////////////////////////////////////////////
+// IdleOverhead -- what OGLE costs each GL call while it is loaded but
+// not recording, the state an application spends nearly all its time
+// in.
+//
+//   IdleOverhead [millions of calls]
+//
+// It makes an OGLEPlugin the way GLIntercept does and calls its
+// GLFunctionPre and GLFunctionPost through the plugin interface, as
+// GLIntercept would around each GL call, for a few kinds of function,
+// and prints the time per call pair.  No GL context is needed; the
+// GL calls themselves are not made.
+//
+// The plugin reads config.ini from the current folder as it would from
+// its own, so run it next to the config to be measured, or where there
+// is none for the defaults.
+//
+// It has to be built with the plugin's sources, against the same
+// GLIntercept headers, e.g. as a console project alongside them, in
+// Release.  The callbacks below answer only what the plugin asks for
+// at start up.
+//////////////////////////////////////////////////////////////////////
+
+#include "../StdAfx.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "../OGLEPlugin.h"
+
+using namespace std;
+
+
+static void logError(const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+}
+
+static void GLAPIENTRY identity(GLenum pname, GLfloat *m) {
+	for(int i = 0; i < 16; i++) {
+		m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+	}
+}
+
+static GLCoreDriver driver;
+
+class IdleCallbacks : public InterceptPluginCallbacks {
+	public:
+		virtual bool RegisterGLFunction(const char *functionName) { return true; }
+		virtual void SetContextFunctionCalls(bool enable) {}
+		virtual const char *GetConfigString() { return ""; }
+		virtual LOGERRPROC GetLogErrorFunction() { return logError; }
+		virtual float GetGLVersion() { return 2.1f; }
+		virtual bool IsGLExtensionSupported(const char *extension) { return false; }
+		virtual void *GetGLFunction(const char *functionName) { return 0; }
+		virtual bool GetLoggerMode() { return false; }
+		virtual uint GetFrameNumber() { return 0; }
+		virtual void GetGLArgString(uint funcIndex, const FunctionArgs &args, uint strLength, char *retString) { *retString = 0; }
+		virtual void GetGLReturnString(uint funcIndex, const FunctionRetValue &retVal, uint strLength, char *retString) { *retString = 0; }
+		virtual const GLCoreDriver *GetCoreGLFunctions() { return &driver; }
+		virtual void DestroyPlugin() {}
+};
+
+
+// Calls of one function as GLIntercept reports them: Pre with the
+// arguments, Post with the return value.  The idle path reads neither,
+// so every argument is 0.  The first call settles the function's flags
+// and is not timed.
+
+static double nsPerCall(InterceptPluginInterface *plugin, uint funcIndex, const char *funcName, int n, ...) {
+	va_list list;
+	va_start(list, n);
+	FunctionArgs args(list);
+	FunctionRetValue retVal(0);
+
+	plugin->GLFunctionPre(0, funcName, funcIndex, args);
+	plugin->GLFunctionPost(0, funcName, funcIndex, retVal);
+
+	LARGE_INTEGER freq, start, end;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&start);
+
+	for(int i = 0; i < n; i++) {
+		plugin->GLFunctionPre(0, funcName, funcIndex, args);
+		plugin->GLFunctionPost(0, funcName, funcIndex, retVal);
+	}
+
+	QueryPerformanceCounter(&end);
+	va_end(list);
+
+	return (end.QuadPart - start.QuadPart) * 1.0e9 / freq.QuadPart / n;
+}
+
+
+int main(int argc, char **argv) {
+	int n = (argc > 1 ? atoi(argv[1]) : 20) * 1000000;
+	if(n <= 0) n = 1000000;
+
+	driver.glGetFloatv = identity;
+
+	IdleCallbacks callbacks;
+	InterceptPluginInterface *plugin = new OGLEPlugin(&callbacks);
+
+	static const struct {
+		uint funcIndex;
+		const char *funcName;
+		const char *kind;
+	} functions[] = {
+		{ 10, "glVertex3f", "immediate mode vertex" },
+		{ 11, "glColor4ub", "immediate mode colour" },
+		{ 12, "glDrawElements", "draw" },
+		{ 13, "glVertexAttribPointer", "attribute array, always followed" },
+		{ 14, "glBindBuffer", "buffer binding, always followed" },
+	};
+
+	printf("%d calls each, idle\n", n);
+	for(int i = 0; i < sizeof(functions) / sizeof(functions[0]); i++) {
+		double ns = nsPerCall(plugin, functions[i].funcIndex, functions[i].funcName, n, 0, 0, 0, 0, 0, 0);
+		printf("  %-24s %7.2f ns  (%s)\n", functions[i].funcName, ns, functions[i].kind);
+	}
+
+	plugin->Destroy();
+	return 0;
+}
@@ -0,0 +1,219 @@
+//////////////////////////////////////////////////////////////////////
+// RecordingStress -- hammers the hand-off of the recording file between
+// the thread that ends the frame and the threads drawing in other
+// contexts, the way OGLEPlugin does it.
+//
+//   RecordingStress [threads] [frames] [ms per frame]
+//
+// Each drawing thread has a context of its own and, like every call
+// through the plugin, catches up with the recording file before it
+// draws.  The frame thread starts a file, lets the others draw into it
+// for a while, flushes what they hold back, stops and closes it, and
+// lets go of its own reference straight away, so a thread still
+// holding the file is the only thing keeping it alive.  Each frame's
+// .obj is then read back and every face checked against the vertices
+// written before it.
+//
+// It runs the plugin's own code for this, so it has to be built with
+// the plugin's sources other than OGLEPlugin.cpp, against the same
+// GLIntercept headers, e.g. as a console project alongside them.  Run
+// it under Application Verifier or a debug heap to catch a file freed
+// while still in use.
+//////////////////////////////////////////////////////////////////////
+
+#include "../StdAfx.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "../ogle.h"
+#include "../ObjFile.h"
+#include "../RecordingFile.h"
+
+#include "../Ptr/Ptr.in"
+
+using namespace std;
+
+
+// the only thing OGLE asks the driver for while drawing client arrays
+
+static void GLAPIENTRY identity(GLenum pname, GLfloat *m) {
+	for(int i = 0; i < 16; i++) {
+		m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+	}
+}
+
+static GLCoreDriver driver;
+
+static RecordingFile recording;
+
+static CRITICAL_SECTION contextsLock;
+static vector<OGLEPtr> contexts;
+
+static volatile LONG stopping = 0;
+static volatile LONG nDraws = 0;
+
+
+// One drawing thread.  Its vertices are offset by its number, so a
+// face put together from two threads' draws shows up as a bad one.
+
+static DWORD WINAPI drawThread(LPVOID arg) {
+	int thread = (int)(size_t)arg;
+
+	OGLEPtr ogle = new OGLE(0, &driver);
+
+	EnterCriticalSection(&contextsLock);
+	contexts.push_back(ogle);
+	LeaveCriticalSection(&contextsLock);
+
+	GLfloat vertices[3 * 30];
+	for(int i = 0; i < 3 * 30; i++) {
+		vertices[i] = (GLfloat)(thread * 1000 + i);
+	}
+
+	while(!stopping) {
+		if(!recording.isActive()) {
+			// the idle early-out
+			continue;
+		}
+
+		recording.catchUp(ogle.rawPtr());
+		{
+			OGLE::ShareGroup::Lock lock(ogle->shared.rawPtr());
+			ogle->glVertexPointer(3, GL_FLOAT, 0, vertices);
+			ogle->glDrawArrays(GL_TRIANGLES, 0, 30);
+		}
+		InterlockedIncrement(&nDraws);
+
+		// give the frame thread a look in at the lock
+		Sleep(0);
+	}
+
+	// as the plugin does for a context whose thread has gone
+	recording.catchUp(ogle.rawPtr());
+	return 0;
+}
+
+
+// What OGLEPlugin::flushCoalesced does at the end of a frame.
+
+static void flushCoalesced() {
+	EnterCriticalSection(&contextsLock);
+	vector<OGLEPtr> current(contexts);
+	LeaveCriticalSection(&contextsLock);
+
+	Ptr<ObjFile> file = recording.get();
+
+	for(size_t i = 0; i < current.size(); i++) {
+		OGLE::ShareGroup::Lock lock(current[i]->shared.rawPtr());
+		if(current[i]->objFile.rawPtr() == file.rawPtr()) {
+			current[i]->flushCoalesced();
+		}
+	}
+}
+
+
+// Every face must refer to vertices already written, and all three of
+// its corners must come from the same thread's draw.
+
+static bool checkFile(const char *fileName, int *nFaces) {
+	FILE *file = fopen(fileName, "r");
+	if(!file) {
+		printf("%s: missing\n", fileName);
+		return false;
+	}
+
+	vector<float> xs;
+	char line[512];
+	bool ok = true;
+	*nFaces = 0;
+
+	while(fgets(line, sizeof(line), file)) {
+		if(line[0] == 'v' && line[1] == ' ') {
+			float x, y, z;
+			sscanf(line + 2, "%f %f %f", &x, &y, &z);
+			xs.push_back(x);
+		}
+		else if(line[0] == 'f' && line[1] == ' ') {
+			int thread = -1;
+			char *p = line + 2;
+
+			for(int k = 0; k < 3; k++) {
+				long v = strtol(p, &p, 10);
+				while(*p && *p != ' ') p++;
+
+				if(v < 1 || v > (long)xs.size() ||
+					(k && (int)xs[v - 1] / 1000 != thread)) {
+					if(ok) printf("%s: bad face: %s", fileName, line);
+					ok = false;
+					break;
+				}
+				thread = (int)xs[v - 1] / 1000;
+			}
+			(*nFaces)++;
+		}
+	}
+
+	fclose(file);
+	return ok;
+}
+
+
+int main(int argc, char **argv) {
+	int nThreads = argc > 1 ? atoi(argv[1]) : 8;
+	int nFrames = argc > 2 ? atoi(argv[2]) : 200;
+	int frameMs = argc > 3 ? atoi(argv[3]) : 2;
+
+	driver.glGetFloatv = identity;
+	OGLE::config.polyTypesEnabled["TRIANGLES"] = 1;
+	OGLE::config.coalesceDrawElements = 64;
+
+	InitializeCriticalSection(&contextsLock);
+
+	vector<HANDLE> threads;
+	for(int i = 0; i < nThreads; i++) {
+		threads.push_back(CreateThread(0, 0, drawThread, (LPVOID)(size_t)i, 0, 0));
+	}
+
+	char fileName[64];
+	for(int frame = 0; frame < nFrames; frame++) {
+		sprintf(fileName, "stress.%d.obj", frame);
+
+		recording.set(new ObjFile(fileName));
+		Sleep(frameMs);
+
+		flushCoalesced();
+
+		Ptr<ObjFile> closedFile = recording.get();
+		recording.set(0);
+		closedFile->close();
+		closedFile = 0;
+
+		// and straight on with the next, without waiting for the others
+		// to notice this one has closed
+	}
+
+	InterlockedExchange(&stopping, 1);
+	for(size_t i = 0; i < threads.size(); i++) {
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+	}
+	contexts.clear();
+
+	int nBad = 0;
+	long nFaces = 0;
+	for(int frame = 0; frame < nFrames; frame++) {
+		sprintf(fileName, "stress.%d.obj", frame);
+
+		int n;
+		if(!checkFile(fileName, &n)) nBad++;
+		nFaces += n;
+	}
+
+	printf("%d threads, %d frames: %ld draws, %ld faces, %d bad files\n",
+		nThreads, nFrames, (long)nDraws, nFaces, nBad);
+
+	return nBad ? 1 : 0;
+}